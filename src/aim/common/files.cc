@@ -1,5 +1,12 @@
 #include "files.h"
 
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include <google/protobuf/json/json.h>
 #include <google/protobuf/util/json_util.h>
 #include <nlohmann/json.h>
@@ -10,6 +17,22 @@
 #include "aim/common/log.h"
 
 namespace aim {
+namespace {
+
+// Protobuf's own pretty printing, which indents by one space.
+bool PrintJson(const google::protobuf::Message& message, std::string* json) {
+  google::protobuf::json::PrintOptions opts;
+  opts.add_whitespace = true;
+  opts.unquote_int64_if_possible = true;
+  auto status = google::protobuf::util::MessageToJsonString(message, json, opts);
+  if (!status.ok()) {
+    Logger::get()->error("Unable to serialize message to json: {}", status.message());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
 
 std::optional<std::string> ReadFileContentAsString(const std::filesystem::path& path) {
   if (!std::filesystem::exists(path)) {
@@ -36,13 +59,75 @@ bool WriteStringToFile(const std::filesystem::path& path, const std::string& con
   return true;
 }
 
+#ifdef _WIN32
+
+bool ReplaceFileDurably(const std::filesystem::path& path, const std::string& content) {
+  std::filesystem::path temp_path = path;
+  temp_path += ".tmp";
+  HANDLE file = CreateFileW(temp_path.c_str(),
+                            GENERIC_WRITE,
+                            0,
+                            NULL,
+                            CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    Logger::get()->warn("Unable to write {}", temp_path.string());
+    return false;
+  }
+  DWORD written = 0;
+  bool ok = WriteFile(file, content.data(), (DWORD)content.size(), &written, NULL) &&
+            written == content.size() && FlushFileBuffers(file);
+  CloseHandle(file);
+  ok = ok && MoveFileExW(temp_path.c_str(),
+                         path.c_str(),
+                         MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+  if (!ok) {
+    Logger::get()->warn("Unable to replace {}", path.string());
+    DeleteFileW(temp_path.c_str());
+  }
+  return ok;
+}
+
+#else
+
+bool ReplaceFileDurably(const std::filesystem::path& path, const std::string& content) {
+  std::filesystem::path temp_path = path;
+  temp_path += ".tmp";
+  int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    Logger::get()->warn("Unable to write {}", temp_path.string());
+    return false;
+  }
+  bool ok = true;
+  size_t offset = 0;
+  while (ok && offset < content.size()) {
+    ssize_t written = write(fd, content.data() + offset, content.size() - offset);
+    ok = written > 0;
+    offset += ok ? written : 0;
+  }
+  ok = ok && fsync(fd) == 0;
+  ok = close(fd) == 0 && ok;
+  ok = ok && rename(temp_path.c_str(), path.c_str()) == 0;
+  if (!ok) {
+    Logger::get()->warn("Unable to replace {}", path.string());
+    unlink(temp_path.c_str());
+    return false;
+  }
+  // Make the rename itself durable.
+  int dir_fd = open(path.parent_path().empty() ? "." : path.parent_path().c_str(), O_RDONLY);
+  if (dir_fd >= 0) {
+    fsync(dir_fd);
+    close(dir_fd);
+  }
+  return true;
+}
+
+#endif
+
 std::string MessageToJson(const google::protobuf::Message& message, int indent) {
   std::string json_string;
-  google::protobuf::json::PrintOptions opts;
-  opts.add_whitespace = true;
-  opts.unquote_int64_if_possible = true;
-  auto status = google::protobuf::util::MessageToJsonString(message, &json_string, opts);
-  if (!status.ok()) {
+  if (!PrintJson(message, &json_string)) {
     return "";
   }
   nlohmann::json json_data = nlohmann::json::parse(json_string);
@@ -53,12 +138,7 @@ std::string MessageToJson(const google::protobuf::Message& message, int indent)
 bool WriteJsonMessageToFile(const std::filesystem::path& path,
                             const google::protobuf::Message& message) {
   std::string json_string;
-  google::protobuf::json::PrintOptions opts;
-  opts.add_whitespace = true;
-  opts.unquote_int64_if_possible = true;
-  auto status = google::protobuf::util::MessageToJsonString(message, &json_string, opts);
-  if (!status.ok()) {
-    Logger::get()->error("Unable to serialize message to json: {}", status.message());
+  if (!PrintJson(message, &json_string)) {
     return false;
   }
   int indent = 2;
@@ -68,6 +148,18 @@ bool WriteJsonMessageToFile(const std::filesystem::path& path,
   return WriteStringToFile(path, formatted_json);
 }
 
+bool WriteJsonMessageToFileDurably(const std::filesystem::path& path,
+                                   const google::protobuf::Message& message) {
+  std::string json_string;
+  if (!PrintJson(message, &json_string)) {
+    return false;
+  }
+  if (!json_string.ends_with('\n')) {
+    json_string += '\n';
+  }
+  return ReplaceFileDurably(path, json_string);
+}
+
 bool ReadJsonMessageFromFile(const std::filesystem::path& path,
                              google::protobuf::Message* message) {
   auto maybe_content = ReadFileContentAsString(path);
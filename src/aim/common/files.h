@@ -12,9 +12,17 @@ std::optional<std::string> ReadFileContentAsString(const std::filesystem::path&
 
 bool WriteStringToFile(const std::filesystem::path& path, const std::string& content);
 
+// Writes content to a temp file next to path, flushes it to the disk and renames it over path. A
+// crash at any point leaves either the old or the new file, never a truncated one.
+bool ReplaceFileDurably(const std::filesystem::path& path, const std::string& content);
+
 std::string MessageToJson(const google::protobuf::Message& message, int indent = 2);
 bool WriteJsonMessageToFile(const std::filesystem::path& path,
                             const google::protobuf::Message& message);
+// Writes the message with ReplaceFileDurably. The json is written as protobuf pretty prints it,
+// without the reformatting pass, since this is meant for files written often like settings.
+bool WriteJsonMessageToFileDurably(const std::filesystem::path& path,
+                                   const google::protobuf::Message& message);
 
 bool ReadJsonMessageFromFile(const std::filesystem::path& path, google::protobuf::Message* message);
 
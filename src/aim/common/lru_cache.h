@@ -0,0 +1,69 @@
+#pragma once
+
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+#include "aim/common/simple_types.h"
+
+namespace aim {
+
+// Map which holds at most max_size values, dropping the least recently used one to make room.
+template <typename Key, typename Value>
+class LruCache {
+ public:
+  explicit LruCache(size_t max_size) : max_size_(max_size) {}
+  AIM_NO_COPY(LruCache);
+
+  // Returns null if the key is not cached. Otherwise marks it as the most recently used.
+  const Value* Get(const Key& key) {
+    auto it = map_.find(key);
+    if (it == map_.end()) {
+      return nullptr;
+    }
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return &it->second->second;
+  }
+
+  void Put(const Key& key, Value value) {
+    auto it = map_.find(key);
+    if (it != map_.end()) {
+      it->second->second = std::move(value);
+      entries_.splice(entries_.begin(), entries_, it->second);
+      return;
+    }
+    entries_.emplace_front(key, std::move(value));
+    map_.emplace(key, entries_.begin());
+    if (entries_.size() > max_size_) {
+      map_.erase(entries_.back().first);
+      entries_.pop_back();
+    }
+  }
+
+  void Erase(const Key& key) {
+    auto it = map_.find(key);
+    if (it != map_.end()) {
+      entries_.erase(it->second);
+      map_.erase(it);
+    }
+  }
+
+  void Clear() {
+    map_.clear();
+    entries_.clear();
+  }
+
+  size_t size() const {
+    return entries_.size();
+  }
+
+ private:
+  using EntryList = std::list<std::pair<Key, Value>>;
+
+  size_t max_size_;
+  // Most recently used first.
+  EntryList entries_;
+  std::unordered_map<Key, typename EntryList::iterator> map_;
+};
+
+}  // namespace aim
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <string_view>
+
+#include "aim/common/simple_types.h"
+
+namespace aim {
+
+// Read only view of a whole file mapped into memory. The contents stay valid for the lifetime of
+// this object.
+class MappedFile {
+ public:
+  // Returns null if the file can not be opened or mapped.
+  static std::unique_ptr<MappedFile> Open(const std::filesystem::path& path);
+
+  ~MappedFile();
+  AIM_NO_COPY(MappedFile);
+
+  std::string_view data() const {
+    return std::string_view(data_, size_);
+  }
+
+ private:
+  MappedFile() {}
+
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  void* mapping_ = nullptr;
+#endif
+};
+
+}  // namespace aim
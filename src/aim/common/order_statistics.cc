@@ -0,0 +1,162 @@
+#include "order_statistics.h"
+
+namespace aim {
+
+void OrderStatisticsTree::Reserve(size_t num_values) {
+  nodes_.reserve(num_values);
+}
+
+void OrderStatisticsTree::Clear() {
+  nodes_.clear();
+  free_nodes_.clear();
+  root_ = -1;
+}
+
+i32 OrderStatisticsTree::NewNode(double value) {
+  // xorshift32. Priorities only need to be well spread, not unpredictable.
+  random_state_ ^= random_state_ << 13;
+  random_state_ ^= random_state_ >> 17;
+  random_state_ ^= random_state_ << 5;
+
+  Node node;
+  node.value = value;
+  node.priority = random_state_;
+  node.count = 1;
+  node.size = 1;
+  if (free_nodes_.size() > 0) {
+    i32 index = free_nodes_.back();
+    free_nodes_.pop_back();
+    nodes_[index] = node;
+    return index;
+  }
+  nodes_.push_back(node);
+  return nodes_.size() - 1;
+}
+
+void OrderStatisticsTree::UpdateSize(i32 node) {
+  Node& n = nodes_[node];
+  n.size = n.count + GetSize(n.left) + GetSize(n.right);
+}
+
+void OrderStatisticsTree::Split(i32 node, double value, bool inclusive, i32* left, i32* right) {
+  if (node < 0) {
+    *left = -1;
+    *right = -1;
+    return;
+  }
+  Node& n = nodes_[node];
+  bool goes_left = inclusive ? n.value <= value : n.value < value;
+  if (goes_left) {
+    Split(n.right, value, inclusive, &nodes_[node].right, right);
+    *left = node;
+  } else {
+    Split(n.left, value, inclusive, left, &nodes_[node].left);
+    *right = node;
+  }
+  UpdateSize(node);
+}
+
+i32 OrderStatisticsTree::Merge(i32 left, i32 right) {
+  if (left < 0) {
+    return right;
+  }
+  if (right < 0) {
+    return left;
+  }
+  if (nodes_[left].priority > nodes_[right].priority) {
+    nodes_[left].right = Merge(nodes_[left].right, right);
+    UpdateSize(left);
+    return left;
+  }
+  nodes_[right].left = Merge(left, nodes_[right].left);
+  UpdateSize(right);
+  return right;
+}
+
+i32 OrderStatisticsTree::Find(double value) const {
+  i32 node = root_;
+  while (node >= 0) {
+    const Node& n = nodes_[node];
+    if (value == n.value) {
+      return node;
+    }
+    node = value < n.value ? n.left : n.right;
+  }
+  return -1;
+}
+
+void OrderStatisticsTree::AddToCount(double value, i64 delta) {
+  i32 node = root_;
+  while (node >= 0) {
+    Node& n = nodes_[node];
+    n.size += delta;
+    if (value == n.value) {
+      n.count += delta;
+      return;
+    }
+    node = value < n.value ? n.left : n.right;
+  }
+}
+
+void OrderStatisticsTree::Insert(double value) {
+  if (Find(value) >= 0) {
+    AddToCount(value, 1);
+    return;
+  }
+  i32 left;
+  i32 right;
+  Split(root_, value, /*inclusive=*/false, &left, &right);
+  root_ = Merge(Merge(left, NewNode(value)), right);
+}
+
+bool OrderStatisticsTree::Erase(double value) {
+  i32 node = Find(value);
+  if (node < 0) {
+    return false;
+  }
+  if (nodes_[node].count > 1) {
+    AddToCount(value, -1);
+    return true;
+  }
+  i32 left;
+  i32 rest;
+  i32 middle;
+  i32 right;
+  Split(root_, value, /*inclusive=*/false, &left, &rest);
+  Split(rest, value, /*inclusive=*/true, &middle, &right);
+  free_nodes_.push_back(middle);
+  root_ = Merge(left, right);
+  return true;
+}
+
+i64 OrderStatisticsTree::CountGreater(double value) const {
+  i64 count = 0;
+  i32 node = root_;
+  while (node >= 0) {
+    const Node& n = nodes_[node];
+    if (value < n.value) {
+      count += n.count + GetSize(n.right);
+      node = n.left;
+    } else {
+      node = n.right;
+    }
+  }
+  return count;
+}
+
+i64 OrderStatisticsTree::CountLess(double value) const {
+  i64 count = 0;
+  i32 node = root_;
+  while (node >= 0) {
+    const Node& n = nodes_[node];
+    if (n.value < value) {
+      count += n.count + GetSize(n.left);
+      node = n.right;
+    } else {
+      node = n.left;
+    }
+  }
+  return count;
+}
+
+}  // namespace aim
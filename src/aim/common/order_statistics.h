@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+
+#include "aim/common/simple_types.h"
+
+namespace aim {
+
+// Multiset of values which answers how many values are above or below a given value in O(log n).
+// Implemented as a treap whose nodes track their subtree size. Equal values share a node. Nodes
+// live in one vector so building a large tree does not allocate per value.
+class OrderStatisticsTree {
+ public:
+  OrderStatisticsTree() {}
+
+  void Reserve(size_t num_values);
+  void Clear();
+
+  void Insert(double value);
+  // Removes one copy of value. Returns false if it was not present.
+  bool Erase(double value);
+
+  i64 size() const {
+    return GetSize(root_);
+  }
+
+  i64 CountGreater(double value) const;
+  i64 CountLess(double value) const;
+
+ private:
+  struct Node {
+    double value = 0;
+    u32 priority = 0;
+    i32 left = -1;
+    i32 right = -1;
+    i64 count = 0;
+    i64 size = 0;
+  };
+
+  i64 GetSize(i32 node) const {
+    return node < 0 ? 0 : nodes_[node].size;
+  }
+
+  i32 NewNode(double value);
+  void UpdateSize(i32 node);
+  // Splits into values < value (or <= value when inclusive) and the rest.
+  void Split(i32 node, double value, bool inclusive, i32* left, i32* right);
+  i32 Merge(i32 left, i32 right);
+  i32 Find(double value) const;
+  void AddToCount(double value, i64 delta);
+
+  std::vector<Node> nodes_;
+  std::vector<i32> free_nodes_;
+  i32 root_ = -1;
+  u32 random_state_ = 0x9e3779b9;
+};
+
+}  // namespace aim
@@ -0,0 +1,45 @@
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace aim {
+
+int ParallelFor(int num_items, const std::function<void(int)>& fn, int num_threads) {
+  if (num_items <= 0) {
+    return 0;
+  }
+  if (num_threads <= 0) {
+    num_threads = std::max<int>(1, std::thread::hardware_concurrency());
+  }
+  num_threads = std::min(num_threads, num_items);
+
+  std::atomic<int> next_index = 0;
+  auto worker = [&]() {
+    while (true) {
+      int i = next_index.fetch_add(1);
+      if (i >= num_items) {
+        return;
+      }
+      fn(i);
+    }
+  };
+  if (num_threads == 1) {
+    worker();
+    return 1;
+  }
+
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back(worker);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  return num_threads;
+}
+
+}  // namespace aim
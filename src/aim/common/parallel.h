@@ -0,0 +1,13 @@
+#pragma once
+
+#include <functional>
+
+namespace aim {
+
+// Calls fn(i) for every i in [0, num_items) on up to num_threads threads, or one per core when
+// num_threads is 0, and returns once all calls finish. Each thread claims the next unclaimed index,
+// so fn should write its result to slot i and the caller merges the slots in index order to get
+// the same result as a serial loop. Returns the number of threads used.
+int ParallelFor(int num_items, const std::function<void(int)>& fn, int num_threads = 0);
+
+}  // namespace aim
@@ -4,42 +4,44 @@
 #include <absl/strings/str_split.h>
 #include <absl/strings/string_view.h>
 
+#include <algorithm>
+
 namespace aim {
 namespace {
 
-std::vector<std::string_view> SplitCamelCase(const std::string_view& full_word) {
-  if (full_word.length() < 3) {
-    return {};
-  }
-
-  std::vector<int> word_starts;
-  word_starts.push_back(0);
-  for (size_t i = 1; i < full_word.length() - 1; ++i) {
-    if (std::islower(full_word[i]) && std::isupper(full_word[i + 1])) {
-      // Is lower and the next letter is upper.
-      word_starts.push_back(i + 1);
+// Calls fn(begin, end) for each token of the input: every space separated word, plus the rest of
+// the word from each camel case boundary.
+template <typename Fn>
+void ForEachSearchToken(std::string_view input, Fn&& fn) {
+  size_t word_start = 0;
+  while (word_start <= input.size()) {
+    size_t word_end = input.find(' ', word_start);
+    if (word_end == std::string_view::npos) {
+      word_end = input.size();
     }
+    if (word_end > word_start) {
+      fn(word_start, word_end);
+      for (size_t i = word_start + 1; i + 1 < word_end; ++i) {
+        if (absl::ascii_islower(input[i]) && absl::ascii_isupper(input[i + 1])) {
+          // Is lower and the next letter is upper.
+          fn(i + 1, word_end);
+        }
+      }
+    }
+    word_start = word_end + 1;
   }
-
-  if (word_starts.size() <= 1) {
-    return {};
-  }
-  std::vector<std::string_view> words;
-  for (int i = 0; i < word_starts.size() - 1; ++i) {
-    words.push_back(full_word.substr(word_starts[i], word_starts[i + 1]));
-  }
-  words.push_back(full_word.substr(word_starts.back()));
-  return words;
 }
 
-bool InputMatchesSearchWord(const std::vector<std::string>& input_word_parts,
-                            const std::string& search_word) {
-  for (const std::string& value : input_word_parts) {
-    if (absl::StartsWith(value, search_word)) {
-      return true;
+bool StartsWithIgnoringCase(std::string_view value, std::string_view lower_prefix) {
+  if (value.size() < lower_prefix.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < lower_prefix.size(); ++i) {
+    if (absl::ascii_tolower(value[i]) != lower_prefix[i]) {
+      return false;
     }
   }
-  return false;
+  return true;
 }
 
 }  // namespace
@@ -62,22 +64,141 @@ bool StringMatchesSearch(const std::string& input,
   if (search_words.size() == 0) {
     return empty_matches;
   }
-
-  std::vector<absl::string_view> base_input_words = absl::StrSplit(input, ' ');
-  std::vector<std::string> input_words;
-  for (auto& word : base_input_words) {
-    input_words.push_back(absl::AsciiStrToLower(word));
-    for (auto& camel_case_part : SplitCamelCase(word)) {
-      input_words.push_back(absl::AsciiStrToLower(camel_case_part));
+  std::string_view input_view = input;
+  for (const std::string& word : search_words) {
+    bool found = false;
+    ForEachSearchToken(input_view, [&](size_t begin, size_t end) {
+      found = found || StartsWithIgnoringCase(input_view.substr(begin, end - begin), word);
+    });
+    if (!found) {
+      return false;
     }
   }
+  return true;
+}
+
+void SearchIndex::Build(const std::vector<std::string>& names) {
+  text_.clear();
+  name_tokens_.clear();
+  name_token_starts_.clear();
+  name_token_starts_.reserve(names.size() + 1);
+  for (int i = 0; i < names.size(); ++i) {
+    name_token_starts_.push_back(name_tokens_.size());
+    u32 offset = text_.size();
+    ForEachSearchToken(names[i], [&](size_t begin, size_t end) {
+      name_tokens_.push_back({offset + (u32)begin, offset + (u32)end, i});
+    });
+    text_ += names[i];
+  }
+  name_token_starts_.push_back(name_tokens_.size());
+  absl::AsciiStrToLower(&text_);
 
-  for (auto& part : search_words) {
-    if (!InputMatchesSearchWord(input_words, part)) {
+  sorted_tokens_ = name_tokens_;
+  std::sort(sorted_tokens_.begin(), sorted_tokens_.end(), [&](const Token& lhs, const Token& rhs) {
+    return GetText(lhs) < GetText(rhs);
+  });
+
+  has_last_search_ = false;
+  last_search_words_.clear();
+  results_.clear();
+  matches_.assign(names.size(), false);
+  word_counts_.assign(names.size(), 0);
+}
+
+bool SearchIndex::NameMatches(int name, const std::vector<std::string>& search_words) const {
+  u32 tokens_end = name_token_starts_[name + 1];
+  for (const std::string& word : search_words) {
+    bool found = false;
+    for (u32 i = name_token_starts_[name]; i < tokens_end && !found; ++i) {
+      found = GetText(name_tokens_[i]).starts_with(word);
+    }
+    if (!found) {
       return false;
     }
   }
   return true;
 }
 
+const std::vector<int>& SearchIndex::Search(const std::vector<std::string>& search_words) {
+  if (has_last_search_ && search_words == last_search_words_) {
+    return results_;
+  }
+
+  // Every name matching the new query also matched the last one if each old word is a prefix of
+  // the new word in the same place.
+  bool narrows_last_search = has_last_search_ && last_search_words_.size() > 0 &&
+                             last_search_words_.size() <= search_words.size();
+  for (int i = 0; narrows_last_search && i < last_search_words_.size(); ++i) {
+    narrows_last_search = search_words[i].starts_with(last_search_words_[i]);
+  }
+
+  // Each search word matches a contiguous range of the sorted tokens.
+  std::vector<std::pair<int, int>> ranges;
+  int num_range_tokens = 0;
+  for (const std::string& word : search_words) {
+    std::string_view prefix = word;
+    auto begin = std::lower_bound(sorted_tokens_.begin(),
+                                  sorted_tokens_.end(),
+                                  prefix,
+                                  [&](const Token& token, std::string_view value) {
+                                    return GetText(token) < value;
+                                  });
+    auto end = std::partition_point(begin, sorted_tokens_.end(), [&](const Token& token) {
+      return GetText(token).starts_with(prefix);
+    });
+    ranges.push_back({begin - sorted_tokens_.begin(), end - sorted_tokens_.begin()});
+    num_range_tokens += end - begin;
+  }
+  std::sort(ranges.begin(), ranges.end(), [](const auto& lhs, const auto& rhs) {
+    return lhs.second - lhs.first < rhs.second - rhs.first;
+  });
+
+  std::vector<int> last_results = std::move(results_);
+  results_.clear();
+  for (int name : last_results) {
+    matches_[name] = false;
+  }
+
+  if (search_words.size() == 0) {
+    std::fill(matches_.begin(), matches_.end(), true);
+  } else if (narrows_last_search &&
+             last_results.size() * search_words.size() * name_tokens_.size() <
+                 num_range_tokens * matches_.size()) {
+    // Checking a name scans all of its tokens for every word, so this only pays off when the last
+    // results are much smaller than the token ranges.
+    for (int name : last_results) {
+      matches_[name] = NameMatches(name, search_words);
+    }
+  } else {
+    // Count the words each name has matched so far, starting from the smallest range. Only names
+    // which matched every earlier word are counted, so the last count marks the matches.
+    const auto& [first_begin, first_end] = ranges[0];
+    for (int i = first_begin; i < first_end; ++i) {
+      word_counts_[sorted_tokens_[i].name] = 1;
+    }
+    for (int word = 1; word < ranges.size(); ++word) {
+      for (int i = ranges[word].first; i < ranges[word].second; ++i) {
+        int name = sorted_tokens_[i].name;
+        if (word_counts_[name] == word) {
+          word_counts_[name] = word + 1;
+        }
+      }
+    }
+    for (int i = first_begin; i < first_end; ++i) {
+      int name = sorted_tokens_[i].name;
+      matches_[name] = matches_[name] || word_counts_[name] == ranges.size();
+      word_counts_[name] = 0;
+    }
+  }
+  for (int i = 0; i < matches_.size(); ++i) {
+    if (matches_[i]) {
+      results_.push_back(i);
+    }
+  }
+
+  has_last_search_ = true;
+  last_search_words_ = search_words;
+  return results_;
+}
+
 }  // namespace aim
@@ -1,14 +1,73 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "aim/common/simple_types.h"
+
 namespace aim {
 
 std::vector<std::string> GetSearchWords(const std::string& text);
 
+// A search word matches when it is a prefix of any word of the input, or of any camel case part of
+// a word onwards, so "hunt" and "bot" both match "HuntBot". Matching ignores case and search words
+// are expected in lower case as returned by GetSearchWords.
 bool StringMatchesSearch(const std::string& input,
                          const std::vector<std::string>& search_words,
                          bool empty_matches = true);
 
+// Prebuilt index giving the same matches as StringMatchesSearch over a fixed list of names, for
+// lists that are searched every frame. The lower case tokens of every name are kept in one sorted
+// list so each search word maps to a contiguous range of tokens found by binary search.
+class SearchIndex {
+ public:
+  SearchIndex() {}
+  AIM_NO_COPY(SearchIndex);
+
+  // Replaces the indexed names. Names are referred to by their position in this list.
+  void Build(const std::vector<std::string>& names);
+
+  // Returns the positions of the names matching every search word, in increasing order. No search
+  // words matches everything. Repeating the last query is free and a query which only extends the
+  // last one narrows its results instead of starting over.
+  const std::vector<int>& Search(const std::vector<std::string>& search_words);
+
+  // Whether the name at this position matched the last search.
+  bool IsMatch(int index) const {
+    return index >= 0 && index < matches_.size() && matches_[index];
+  }
+
+  int size() const {
+    return name_token_starts_.size() > 0 ? name_token_starts_.size() - 1 : 0;
+  }
+
+ private:
+  struct Token {
+    u32 begin = 0;
+    u32 end = 0;
+    int name = 0;
+  };
+
+  std::string_view GetText(const Token& token) const {
+    return std::string_view(text_).substr(token.begin, token.end - token.begin);
+  }
+
+  bool NameMatches(int name, const std::vector<std::string>& search_words) const;
+
+  // The lower case names back to back. Tokens are views into this.
+  std::string text_;
+  std::vector<Token> sorted_tokens_;
+  // Tokens grouped by name. Those of name i start at name_token_starts_[i].
+  std::vector<Token> name_tokens_;
+  std::vector<u32> name_token_starts_;
+
+  bool has_last_search_ = false;
+  std::vector<std::string> last_search_words_;
+  std::vector<int> results_;
+  std::vector<char> matches_;
+  // Scratch space for Search, all zero between calls.
+  std::vector<int> word_counts_;
+};
+
 }  // namespace aim
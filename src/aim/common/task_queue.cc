@@ -0,0 +1,53 @@
+#include "task_queue.h"
+
+#include <utility>
+
+namespace aim {
+
+TaskQueue::TaskQueue() : thread_([this] { Run(); }) {}
+
+TaskQueue::~TaskQueue() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  task_cv_.notify_one();
+  thread_.join();
+}
+
+void TaskQueue::Submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  task_cv_.notify_one();
+}
+
+void TaskQueue::WaitForIdle() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_cv_.wait(lock, [this] { return tasks_.empty() && !is_running_task_; });
+}
+
+void TaskQueue::Run() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      task_cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+      is_running_task_ = true;
+    }
+    task();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      is_running_task_ = false;
+    }
+    idle_cv_.notify_all();
+  }
+}
+
+}  // namespace aim
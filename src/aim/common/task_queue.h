@@ -0,0 +1,39 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "aim/common/simple_types.h"
+
+namespace aim {
+
+// Runs tasks one at a time on a single background thread, in the order they were submitted. The
+// background writers are built on this so the caller never waits on disk.
+class TaskQueue {
+ public:
+  TaskQueue();
+  // Finishes all submitted tasks before returning.
+  ~TaskQueue();
+  AIM_NO_COPY(TaskQueue);
+
+  void Submit(std::function<void()> task);
+
+  // Blocks until every task submitted so far has finished.
+  void WaitForIdle();
+
+ private:
+  void Run();
+
+  std::mutex mutex_;
+  std::condition_variable task_cv_;
+  std::condition_variable idle_cv_;
+  std::deque<std::function<void()>> tasks_;
+  bool is_running_task_ = false;
+  bool stopping_ = false;
+  std::thread thread_;
+};
+
+}  // namespace aim
@@ -77,6 +77,9 @@ Application::~Application() {
     scenario_manager_->ClearCurrentScenario();
   }
 
+  if (database_) {
+    database_->LogQueryTimes(10);
+  }
   if (logger_) {
     logger_->flush();
   }
@@ -143,11 +146,22 @@ int Application::Initialize() {
   }
   InitializeAimForgeFolder(file_system_.get());
 
-  settings_db_ = std::make_unique<SettingsDb>(file_system_->GetUserDataPath("settings.db"));
+  database_ = std::make_unique<Database>();
+  bool database_ok = database_->Attach({
+      {"stats", file_system_->GetUserDataPath("stats.db"), GetStatsMigrations()},
+      {"history", file_system_->GetUserDataPath("history.db"), GetHistoryMigrations()},
+      {"settings", file_system_->GetUserDataPath("settings.db"), GetSettingsMigrations()},
+      {"replays", file_system_->GetUserDataPath("replays.db"), GetReplayMigrations()},
+  });
+  if (!database_ok) {
+    logger_->error("Unable to open all databases");
+  }
+  settings_db_ = std::make_unique<SettingsDb>(database_.get());
 
-  stats_manager_ = std::make_unique<StatsManager>(file_system_.get());
+  stats_manager_ = std::make_unique<StatsManager>(file_system_.get(), database_.get());
+  replay_manager_ = std::make_unique<ReplayManager>(file_system_.get(), database_.get());
   playlist_manager_ = std::make_unique<PlaylistManager>(file_system_.get());
-  history_manager_ = std::make_unique<HistoryManager>(file_system_.get(), playlist_manager_.get());
+  history_manager_ = std::make_unique<HistoryManager>(database_.get(), playlist_manager_.get());
   settings_manager_ =
       std::make_unique<SettingsManager>(file_system_->GetUserDataPath("settings.json"),
                                         file_system_->GetUserDataPath("resources/themes"),
@@ -160,17 +174,23 @@ int Application::Initialize() {
     return -1;
   }
 
-  // Prime aggregate stats cache for all recent scenarios.
-  for (const std::string& scenario_id : history_manager_->recent_scenario_ids()) {
-    stats_manager_->GetAggregateStats(scenario_id);
-  }
+  // Load aggregate stats for recent scenarios in the background so startup does not wait on them.
+  stats_manager_->PrefetchAggregateStats(history_manager_->recent_scenario_ids());
 
   playlist_manager_->LoadPlaylistsFromDisk();
 
-  scenario_manager_ = std::make_unique<ScenarioManager>(
-      file_system_.get(), playlist_manager_.get(), stats_manager_.get());
+  scenario_manager_ = std::make_unique<ScenarioManager>(file_system_.get(),
+                                                        database_.get(),
+                                                        playlist_manager_.get(),
+                                                        stats_manager_.get(),
+                                                        replay_manager_.get(),
+                                                        history_manager_.get(),
+                                                        settings_db_.get());
   scenario_manager_->LoadScenariosFromDisk();
 
+  file_watcher_ = std::make_unique<FileWatcher>();
+  WatchResourceDirs();
+
   if (Mix_Init(MIX_INIT_OGG) == 0) {
     logger_->error("SDL_mixer OGG init failed: {}", SDL_GetError());
     return -1;
@@ -424,12 +444,50 @@ void Application::PushScreen(std::shared_ptr<Screen> screen) {
   screen_stack_.push_back(std::move(screen));
 }
 
+void Application::WatchResourceDirs() {
+  std::vector<std::filesystem::path> dirs;
+  for (const BundleInfo& bundle : file_system_->GetBundles()) {
+    if (bundle.packed) {
+      continue;
+    }
+    dirs.push_back(bundle.path / "scenarios");
+    dirs.push_back(bundle.path / "playlists");
+  }
+  dirs.push_back(settings_manager_->theme_dir());
+  file_watcher_->Watch(dirs);
+}
+
+void Application::ReloadResourcesFromDisk() {
+  scenario_manager_->LoadScenariosFromDisk();
+  playlist_manager_->LoadPlaylistsFromDisk();
+  WatchResourceDirs();
+}
+
+void Application::UpdateFromFileChanges() {
+  FileChanges changes = file_watcher_->PollChanges();
+  if (changes.overflowed) {
+    Logger::get()->warn("Missed some file changes, reloading everything");
+    ReloadResourcesFromDisk();
+    settings_manager_->InvalidateThemeCache();
+    return;
+  }
+  scenario_manager_->UpdateScenariosFromDisk(changes.paths);
+  playlist_manager_->UpdatePlaylistsFromDisk(changes.paths);
+  for (const std::filesystem::path& path : changes.paths) {
+    if (path.parent_path() == settings_manager_->theme_dir()) {
+      settings_manager_->InvalidateThemeCache();
+      break;
+    }
+  }
+}
+
 void Application::RunMainLoop() {
   bool running = true;
   while (running) {
     if (screen_stack_.size() == 0) {
       return;
     }
+    UpdateFromFileChanges();
     std::shared_ptr<Screen> current_screen = screen_stack_.back();
     for (int i = 0; i < screen_stack_.size() - 1; ++i) {
       screen_stack_[i]->EnsureDetached();
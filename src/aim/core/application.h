@@ -18,13 +18,16 @@
 #include "aim/common/util.h"
 #include "aim/core/application_state.h"
 #include "aim/core/file_system.h"
+#include "aim/core/file_watcher.h"
 #include "aim/core/font_manager.h"
 #include "aim/core/history_manager.h"
 #include "aim/core/playlist_manager.h"
+#include "aim/core/replay_manager.h"
 #include "aim/core/scenario_manager.h"
 #include "aim/core/screen.h"
 #include "aim/core/settings_manager.h"
 #include "aim/core/stats_manager.h"
+#include "aim/database/database.h"
 #include "aim/database/settings_db.h"
 #include "aim/database/stats_db.h"
 #include "aim/graphics/renderer.h"
@@ -121,6 +124,10 @@ class Application {
     return *history_manager_;
   }
 
+  ReplayManager& replay_manager() {
+    return *replay_manager_;
+  }
+
   spdlog::logger* logger() {
     return logger_.get();
   };
@@ -136,6 +143,15 @@ class Application {
   void EnableVsync();
   void DisableVsync();
 
+  // Reloads every scenario and playlist and starts watching any new bundles. Individual file
+  // changes are picked up automatically each frame.
+  void ReloadResourcesFromDisk();
+
+  // Stops picking up changed resource files, e.g. while a scenario is running.
+  void SetFileWatchingPaused(bool paused) {
+    file_watcher_->SetPaused(paused);
+  }
+
   Application(const Application&) = delete;
   Application(Application&&) = default;
   Application& operator=(Application other) = delete;
@@ -146,6 +162,9 @@ class Application {
 
   int Initialize();
 
+  void WatchResourceDirs();
+  void UpdateFromFileChanges();
+
   SDL_Window* sdl_window_ = nullptr;
   SDL_Surface* icon_ = nullptr;
   SDL_GPUDevice* gpu_device_ = nullptr;
@@ -157,16 +176,20 @@ class Application {
 
   Random rand_;
 
+  // Declared before everything which uses it so it is destroyed last.
+  std::unique_ptr<Database> database_;
   std::unique_ptr<SoundManager> sound_manager_;
   std::unique_ptr<StatsManager> stats_manager_;
   std::unique_ptr<SettingsManager> settings_manager_;
   std::unique_ptr<SettingsDb> settings_db_;
   std::unique_ptr<HistoryManager> history_manager_;
+  std::unique_ptr<ReplayManager> replay_manager_;
   std::unique_ptr<Renderer> renderer_;
   std::unique_ptr<FileSystem> file_system_;
   std::unique_ptr<ScenarioManager> scenario_manager_;
   std::unique_ptr<PlaylistManager> playlist_manager_;
   std::unique_ptr<FontManager> font_manager_;
+  std::unique_ptr<FileWatcher> file_watcher_;
   std::shared_ptr<spdlog::logger> logger_;
   std::unique_ptr<AimAbslLogSink> absl_log_sink_;
   u64 component_id_counter_ = 1;
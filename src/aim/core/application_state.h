@@ -26,6 +26,9 @@ class ApplicationState {
 
   std::optional<ScenarioRunOption> scenario_run_option;
 
+  // Runs with replays also save every raw mouse event. Off by default since each trace is large.
+  bool record_input_traces = false;
+
   std::optional<RunPerformanceStats> GetPerformanceStats(const std::string& scenario_id,
                                                          i64 run_id);
   void AddPerformanceStats(const std::string& scenario_id,
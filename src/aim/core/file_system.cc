@@ -7,6 +7,7 @@
 #include <vector>
 
 #include "aim/common/util.h"
+#include "aim/core/packed_bundle.h"
 
 namespace aim {
 namespace {
@@ -32,7 +33,9 @@ std::filesystem::path FileSystem::GetBasePath(const std::filesystem::path& file_
 std::vector<std::string> FileSystem::GetBundleNames() {
   std::vector<std::string> names;
   for (auto& b : GetBundles()) {
-    names.push_back(b.name);
+    if (!b.packed) {
+      names.push_back(b.name);
+    }
   }
   return names;
 }
@@ -43,7 +46,12 @@ std::vector<BundleInfo> FileSystem::GetBundles() {
   if (!std::filesystem::exists(bundles_dir) || !std::filesystem::is_directory(bundles_dir)) {
     return {};
   }
+  std::vector<std::filesystem::path> packed_paths;
   for (const auto& entry : std::filesystem::directory_iterator(bundles_dir)) {
+    if (std::filesystem::is_regular_file(entry) &&
+        entry.path().extension() == kPackedBundleExtension) {
+      packed_paths.push_back(entry.path());
+    }
     if (!std::filesystem::is_directory(entry)) {
       continue;
     }
@@ -52,12 +60,46 @@ std::vector<BundleInfo> FileSystem::GetBundles() {
     bundle.name = entry.path().filename().string();
     bundles.push_back(bundle);
   }
+  for (const std::filesystem::path& path : packed_paths) {
+    std::string name = path.stem().string();
+    bool has_dir = std::any_of(bundles.begin(), bundles.end(), [&](const BundleInfo& bundle) {
+      return bundle.name == name;
+    });
+    if (has_dir) {
+      continue;
+    }
+    BundleInfo bundle;
+    bundle.packed = GetPackedBundle(path);
+    if (!bundle.packed) {
+      continue;
+    }
+    bundle.path = path;
+    bundle.name = std::move(name);
+    bundles.push_back(bundle);
+  }
   std::sort(bundles.begin(), bundles.end(), [](const BundleInfo& lhs, const BundleInfo& rhs) {
     return lhs.name < rhs.name;
   });
   return bundles;
 }
 
+std::shared_ptr<const PackedBundle> FileSystem::GetPackedBundle(const std::filesystem::path& path) {
+  std::error_code ec;
+  u64 file_size = std::filesystem::file_size(path, ec);
+  i64 modify_time = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+  auto it = packed_bundles_.find(path.string());
+  if (it != packed_bundles_.end() && it->second.file_size == file_size &&
+      it->second.modify_time == modify_time) {
+    return it->second.bundle;
+  }
+  OpenedPackedBundle opened;
+  opened.file_size = file_size;
+  opened.modify_time = modify_time;
+  opened.bundle = PackedBundle::Open(path);
+  packed_bundles_[path.string()] = opened;
+  return opened.bundle;
+}
+
 std::optional<BundleInfo> FileSystem::GetBundle(const std::string& bundle_name) {
   for (auto& bundle : GetBundles()) {
     if (bundle.name == bundle_name) {
@@ -1,15 +1,23 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
 #include <optional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "aim/common/simple_types.h"
+
 namespace aim {
 
+class PackedBundle;
+
 struct BundleInfo {
   std::string name;
   std::filesystem::path path;
+  // Set when the bundle is packed into the single file at path. Packed bundles are read only.
+  std::shared_ptr<const PackedBundle> packed;
 };
 
 class FileSystem {
@@ -19,13 +27,28 @@ class FileSystem {
   std::filesystem::path GetUserDataPath(const std::filesystem::path& file_name);
   std::filesystem::path GetBasePath(const std::filesystem::path& file_name);
 
+  // Lists the bundle dirs and packed bundle files in the bundles dir. A dir takes precedence over a
+  // packed bundle with the same name, so a bundle can be edited after unpacking it in place.
   std::vector<BundleInfo> GetBundles();
+  // Names of the bundles which can be written to.
   std::vector<std::string> GetBundleNames();
   std::optional<BundleInfo> GetBundle(const std::string& bundle_name);
 
  private:
+  struct OpenedPackedBundle {
+    u64 file_size = 0;
+    i64 modify_time = 0;
+    // Null if the file is not a valid packed bundle.
+    std::shared_ptr<const PackedBundle> bundle;
+  };
+
+  // Maps each packed bundle once and keeps it mapped until the file changes.
+  std::shared_ptr<const PackedBundle> GetPackedBundle(const std::filesystem::path& path);
+
   std::filesystem::path pref_dir_;
   std::filesystem::path base_dir_;
+  // Keyed by path.
+  std::unordered_map<std::string, OpenedPackedBundle> packed_bundles_;
 };
 
 }  // namespace aim
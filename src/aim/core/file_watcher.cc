@@ -0,0 +1,236 @@
+#include "file_watcher.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include "aim/common/log.h"
+
+namespace aim {
+namespace {
+
+constexpr std::chrono::milliseconds kPollInterval(1000);
+
+void SortAndDedupe(std::vector<std::filesystem::path>* paths) {
+  std::sort(paths->begin(), paths->end());
+  paths->erase(std::unique(paths->begin(), paths->end()), paths->end());
+}
+
+}  // namespace
+
+FileWatcher::FileWatcher() {
+#ifdef __linux__
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd_ < 0) {
+    Logger::get()->warn("inotify is unavailable, falling back to polling for file changes");
+  }
+#endif
+  if (!is_using_inotify()) {
+    scan_thread_ = std::thread([this] { RunScanLoop(); });
+  }
+}
+
+FileWatcher::~FileWatcher() {
+  if (scan_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(scan_mutex_);
+      stopping_ = true;
+    }
+    scan_cv_.notify_one();
+    scan_thread_.join();
+  }
+#ifdef __linux__
+  if (inotify_fd_ >= 0) {
+    close(inotify_fd_);
+  }
+#endif
+}
+
+void FileWatcher::Watch(const std::vector<std::filesystem::path>& dirs) {
+  if (is_using_inotify()) {
+#ifdef __linux__
+    for (auto& [watch, dir] : watch_dirs_) {
+      inotify_rm_watch(inotify_fd_, watch);
+    }
+#endif
+    watch_dirs_.clear();
+    for (const std::filesystem::path& dir : dirs) {
+      AddInotifyWatches(dir, nullptr);
+    }
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(scan_mutex_);
+    scan_dirs_ = dirs;
+    scanned_changes_ = {};
+    needs_baseline_ = true;
+  }
+  scan_cv_.notify_one();
+}
+
+FileChanges FileWatcher::PollChanges() {
+  FileChanges changes;
+  if (paused_) {
+    return changes;
+  }
+  if (is_using_inotify()) {
+    ReadInotifyEvents(&changes);
+  } else {
+    std::lock_guard<std::mutex> lock(scan_mutex_);
+    changes = std::exchange(scanned_changes_, {});
+  }
+  SortAndDedupe(&changes.paths);
+  return changes;
+}
+
+void FileWatcher::SetPaused(bool paused) {
+  {
+    std::lock_guard<std::mutex> lock(scan_mutex_);
+    paused_ = paused;
+  }
+  scan_cv_.notify_one();
+}
+
+void FileWatcher::AddInotifyWatches(const std::filesystem::path& dir, FileChanges* changes) {
+#ifdef __linux__
+  std::error_code ec;
+  if (!std::filesystem::is_directory(dir, ec)) {
+    return;
+  }
+  u32 mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+  int watch = inotify_add_watch(inotify_fd_, dir.string().c_str(), mask);
+  if (watch < 0) {
+    Logger::get()->warn("Unable to watch {} for changes", dir.string());
+    return;
+  }
+  watch_dirs_[watch] = dir;
+  // Iterated with error codes since entries can disappear while being listed.
+  std::filesystem::directory_iterator it(dir, ec);
+  for (; !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+    if (it->is_directory(ec)) {
+      AddInotifyWatches(it->path(), changes);
+    } else if (changes != nullptr) {
+      // Files written to a new directory before its watch was added produce no events.
+      changes->paths.push_back(it->path());
+    }
+    ec.clear();
+  }
+#endif
+}
+
+void FileWatcher::ReadInotifyEvents(FileChanges* changes) {
+#ifdef __linux__
+  alignas(inotify_event) char buffer[16 * 1024];
+  while (true) {
+    ssize_t length = read(inotify_fd_, buffer, sizeof(buffer));
+    if (length <= 0) {
+      return;
+    }
+    for (char* p = buffer; p < buffer + length;) {
+      auto* event = reinterpret_cast<inotify_event*>(p);
+      p += sizeof(inotify_event) + event->len;
+      if ((event->mask & IN_Q_OVERFLOW) != 0) {
+        changes->overflowed = true;
+        continue;
+      }
+      if ((event->mask & IN_IGNORED) != 0) {
+        watch_dirs_.erase(event->wd);
+        continue;
+      }
+      auto it = watch_dirs_.find(event->wd);
+      if (it == watch_dirs_.end() || event->len == 0) {
+        continue;
+      }
+      std::filesystem::path path = it->second / event->name;
+      if ((event->mask & IN_ISDIR) != 0) {
+        if ((event->mask & (IN_CREATE | IN_MOVED_TO)) != 0) {
+          AddInotifyWatches(path, changes);
+        }
+        continue;
+      }
+      changes->paths.push_back(std::move(path));
+    }
+  }
+#endif
+}
+
+void FileWatcher::RunScanLoop() {
+  Snapshot snapshot;
+  std::unique_lock<std::mutex> lock(scan_mutex_);
+  while (true) {
+    scan_cv_.wait_for(lock, kPollInterval, [this] { return stopping_ || needs_baseline_; });
+    scan_cv_.wait(lock, [this] { return stopping_ || needs_baseline_ || !paused_; });
+    if (stopping_) {
+      return;
+    }
+    bool is_baseline = std::exchange(needs_baseline_, false);
+    std::vector<std::filesystem::path> dirs = scan_dirs_;
+    lock.unlock();
+    Snapshot new_snapshot = TakeSnapshot(dirs);
+    FileChanges changes;
+    if (!is_baseline) {
+      CompareSnapshots(snapshot, new_snapshot, &changes);
+    }
+    snapshot = std::move(new_snapshot);
+    lock.lock();
+    // Changes to the old directories are dropped if Watch was called during the scan.
+    if (!needs_baseline_) {
+      scanned_changes_.paths.insert(
+          scanned_changes_.paths.end(), changes.paths.begin(), changes.paths.end());
+    }
+  }
+}
+
+FileWatcher::Snapshot FileWatcher::TakeSnapshot(const std::vector<std::filesystem::path>& dirs) {
+  Snapshot snapshot;
+  for (const std::filesystem::path& dir : dirs) {
+    std::error_code ec;
+    if (!std::filesystem::is_directory(dir, ec)) {
+      continue;
+    }
+    // Iterated with error codes since files can disappear or be locked while being listed.
+    std::filesystem::recursive_directory_iterator it(
+        dir, std::filesystem::directory_options::skip_permission_denied, ec);
+    for (; !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+      if (!it->is_regular_file(ec)) {
+        ec.clear();
+        continue;
+      }
+      FileStamp stamp;
+      stamp.file_size = it->file_size(ec);
+      stamp.modify_time = it->last_write_time(ec).time_since_epoch().count();
+      if (!ec) {
+        snapshot[it->path().string()] = stamp;
+      }
+      ec.clear();
+    }
+    if (ec) {
+      Logger::get()->warn("Unable to scan {} for changes: {}", dir.string(), ec.message());
+    }
+  }
+  return snapshot;
+}
+
+void FileWatcher::CompareSnapshots(const Snapshot& old_snapshot,
+                                   const Snapshot& new_snapshot,
+                                   FileChanges* changes) {
+  for (const auto& [path, stamp] : new_snapshot) {
+    auto it = old_snapshot.find(path);
+    if (it == old_snapshot.end() || it->second.file_size != stamp.file_size ||
+        it->second.modify_time != stamp.modify_time) {
+      changes->paths.push_back(path);
+    }
+  }
+  for (const auto& [path, stamp] : old_snapshot) {
+    if (!new_snapshot.contains(path)) {
+      changes->paths.push_back(path);
+    }
+  }
+}
+
+}  // namespace aim
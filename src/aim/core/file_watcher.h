@@ -0,0 +1,82 @@
+#pragma once
+
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "aim/common/simple_types.h"
+
+namespace aim {
+
+struct FileChanges {
+  // Files which were created, modified, deleted or renamed. Sorted with no duplicates.
+  std::vector<std::filesystem::path> paths;
+  // Some changes were lost, so every watched file should be treated as changed.
+  bool overflowed = false;
+
+  bool empty() const {
+    return paths.size() == 0 && !overflowed;
+  }
+};
+
+// Reports which files changed under a set of directories, including their subdirectories. Uses
+// inotify on Linux. Elsewhere, or if inotify is unavailable, a background thread rescans the
+// directories and compares files by size and modification time. Must be used from a single thread.
+class FileWatcher {
+ public:
+  FileWatcher();
+  ~FileWatcher();
+  AIM_NO_COPY(FileWatcher);
+
+  // Replaces the watched directories. Directories which do not exist are skipped.
+  void Watch(const std::vector<std::filesystem::path>& dirs);
+
+  // Never blocks. Returns the changes since the previous call, or nothing while paused.
+  FileChanges PollChanges();
+
+  // Stops looking for changes, e.g. while a scenario is running. Changes made in the meantime are
+  // reported once resumed.
+  void SetPaused(bool paused);
+
+  bool is_using_inotify() const {
+    return inotify_fd_ >= 0;
+  }
+
+ private:
+  struct FileStamp {
+    u64 file_size = 0;
+    i64 modify_time = 0;
+  };
+  using Snapshot = std::unordered_map<std::string, FileStamp>;
+
+  void AddInotifyWatches(const std::filesystem::path& dir, FileChanges* changes);
+  void ReadInotifyEvents(FileChanges* changes);
+  void RunScanLoop();
+  static Snapshot TakeSnapshot(const std::vector<std::filesystem::path>& dirs);
+  static void CompareSnapshots(const Snapshot& old_snapshot,
+                               const Snapshot& new_snapshot,
+                               FileChanges* changes);
+
+  int inotify_fd_ = -1;
+  std::unordered_map<int, std::filesystem::path> watch_dirs_;
+
+  // Only written from the calling thread, always under scan_mutex_.
+  bool paused_ = false;
+
+  // State shared with the scan thread.
+  std::mutex scan_mutex_;
+  std::condition_variable scan_cv_;
+  std::vector<std::filesystem::path> scan_dirs_;
+  FileChanges scanned_changes_;
+  // The next scan only records a new baseline since the watched directories changed.
+  bool needs_baseline_ = false;
+  bool stopping_ = false;
+  // Only started when rescanning.
+  std::thread scan_thread_;
+};
+
+}  // namespace aim
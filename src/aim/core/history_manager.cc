@@ -1,5 +1,6 @@
 #include "history_manager.h"
 
+#include <algorithm>
 #include <memory>
 
 #include "aim/core/playlist_manager.h"
@@ -9,22 +10,44 @@ namespace {
 
 const int kCachedRecentNamesSize = 240;
 
+// Moves id to the front, matching the order the db would return after the view is recorded.
+void MoveToFront(const std::string& id, std::vector<std::string>* names) {
+  auto it = std::find(names->begin(), names->end(), id);
+  if (it != names->end()) {
+    std::rotate(names->begin(), it, it + 1);
+    return;
+  }
+  names->insert(names->begin(), id);
+  if (names->size() > kCachedRecentNamesSize) {
+    names->pop_back();
+  }
+}
+
 }  // namespace
 
-HistoryManager::HistoryManager(FileSystem* fs, PlaylistManager* playlist_manager)
-    : history_db_(std::make_unique<HistoryDb>(fs->GetUserDataPath("history.db"))),
+HistoryManager::HistoryManager(Database* database, PlaylistManager* playlist_manager)
+    : history_db_(std::make_unique<HistoryDb>(database)),
       playlist_manager_(playlist_manager) {}
 
 void HistoryManager::UpdateRecentView(RecentViewType t, const std::string& id) {
-  if (t == RecentViewType::SCENARIO) {
-    scenarios_need_reload_ = true;
+  // Viewing a scenario happens on every run, so the cached lists are updated in place instead of
+  // being reloaded.
+  if (t == RecentViewType::SCENARIO && !scenarios_need_reload_) {
+    MoveToFront(id, &recent_scenario_ids_);
   }
-  if (t == RecentViewType::PLAYLIST) {
-    playlists_need_reload_ = true;
+  if (t == RecentViewType::PLAYLIST && !playlists_need_reload_ &&
+      playlist_manager_->GetPlaylist(id)) {
+    MoveToFront(id, &recent_playlists_);
   }
   return history_db_->UpdateRecentView(t, id);
 }
 
+bool HistoryManager::RenameScenario(const std::string& old_scenario_id,
+                                    const std::string& new_scenario_id) {
+  scenarios_need_reload_ = true;
+  return history_db_->RenameRecentView(RecentViewType::SCENARIO, old_scenario_id, new_scenario_id);
+}
+
 std::vector<RecentView> HistoryManager::GetRecentViews(RecentViewType t, int limit) {
   return history_db_->GetRecentViews(t, limit);
 }
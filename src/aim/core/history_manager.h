@@ -7,6 +7,7 @@
 
 #include "aim/common/simple_types.h"
 #include "aim/core/file_system.h"
+#include "aim/database/database.h"
 #include "aim/database/history_db.h"
 
 namespace aim {
@@ -15,10 +16,11 @@ class PlaylistManager;
 
 class HistoryManager {
  public:
-  HistoryManager(FileSystem* fs, PlaylistManager* playlist_manager);
+  HistoryManager(Database* database, PlaylistManager* playlist_manager);
   AIM_NO_COPY(HistoryManager);
 
   void UpdateRecentView(RecentViewType t, const std::string& id);
+  bool RenameScenario(const std::string& old_scenario_id, const std::string& new_scenario_id);
   std::vector<RecentView> GetRecentViews(RecentViewType t, int limit);
 
   std::vector<std::string> GetRecentUniqueNames(RecentViewType t, int limit);
@@ -0,0 +1,144 @@
+#include "input_trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "aim/common/log.h"
+
+namespace aim {
+namespace {
+
+constexpr u32 kTraceFileMagic = 0x544d4941;  // "AIMT"
+constexpr u32 kTraceFileVersion = 2;
+
+// Leaves room for bursts above the nominal polling rate.
+constexpr float kReserveHeadroom = 1.25f;
+// About 5 minutes at 8kHz, or ~70MB. Longer runs keep the start of the trace.
+constexpr double kMaxReservedEvents = 3'000'000;
+
+// Trace file layout, little endian with no padding:
+//
+//   header, 32 bytes:  u32 magic, u32 version, u64 start_timestamp_ns, u64 num_events,
+//                      u64 num_dropped
+//   num_events times, 18 bytes each:  u64 timestamp_ns, f32 xrel, f32 yrel, u8 type, u8 button
+//
+// Fields are copied one at a time so the in memory padding of InputTraceEvent never reaches disk.
+constexpr size_t kTraceHeaderSize = 32;
+constexpr size_t kTraceEventSize = 18;
+
+template <typename T>
+void AppendField(const T& value, std::string* out) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+T ReadField(const char** data) {
+  T value;
+  std::memcpy(&value, *data, sizeof(value));
+  *data += sizeof(value);
+  return value;
+}
+
+}  // namespace
+
+void InputTrace::Reserve(float duration_seconds, int polling_rate_hz) {
+  double num_events = std::min(
+      std::ceil((double)duration_seconds * polling_rate_hz * kReserveHeadroom), kMaxReservedEvents);
+  events_.clear();
+  events_.reserve(num_events > 0 ? (size_t)num_events : 0);
+  num_dropped_ = 0;
+}
+
+void InputTrace::AddMotion(u64 timestamp_ns, float xrel, float yrel) {
+  InputTraceEvent event;
+  event.timestamp_ns = timestamp_ns;
+  event.xrel = xrel;
+  event.yrel = yrel;
+  event.type = InputTraceEventType::MOTION;
+  Add(event);
+}
+
+void InputTrace::AddButton(u64 timestamp_ns, u8 button, bool is_down) {
+  InputTraceEvent event;
+  event.timestamp_ns = timestamp_ns;
+  event.button = button;
+  event.type = is_down ? InputTraceEventType::BUTTON_DOWN : InputTraceEventType::BUTTON_UP;
+  Add(event);
+}
+
+void InputTrace::Add(const InputTraceEvent& event) {
+  if (events_.size() >= events_.capacity()) {
+    ++num_dropped_;
+    return;
+  }
+  events_.push_back(event);
+}
+
+bool InputTrace::WriteToFile(const std::filesystem::path& path) const {
+  std::ofstream outfile(path, std::ios::binary | std::ios::trunc);
+  if (!outfile.is_open()) {
+    Logger::get()->warn("Unable to write input trace {}", path.string());
+    return false;
+  }
+  std::string data;
+  data.reserve(kTraceHeaderSize + events_.size() * kTraceEventSize);
+  AppendField(kTraceFileMagic, &data);
+  AppendField(kTraceFileVersion, &data);
+  AppendField(start_timestamp_ns_, &data);
+  AppendField((u64)events_.size(), &data);
+  AppendField(num_dropped_, &data);
+  for (const InputTraceEvent& event : events_) {
+    AppendField(event.timestamp_ns, &data);
+    AppendField(event.xrel, &data);
+    AppendField(event.yrel, &data);
+    AppendField((u8)event.type, &data);
+    AppendField(event.button, &data);
+  }
+  outfile.write(data.data(), data.size());
+  outfile.close();
+  return !outfile.fail();
+}
+
+std::unique_ptr<InputTrace> InputTrace::ReadFromFile(const std::filesystem::path& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return {};
+  }
+  std::string data(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{});
+  if (data.size() < kTraceHeaderSize) {
+    Logger::get()->warn("Invalid input trace {}", path.string());
+    return {};
+  }
+  const char* read = data.data();
+  u32 magic = ReadField<u32>(&read);
+  u32 version = ReadField<u32>(&read);
+  if (magic != kTraceFileMagic || version != kTraceFileVersion) {
+    Logger::get()->warn("Invalid input trace {}", path.string());
+    return {};
+  }
+  auto trace = std::make_unique<InputTrace>();
+  trace->start_timestamp_ns_ = ReadField<u64>(&read);
+  u64 num_events = ReadField<u64>(&read);
+  trace->num_dropped_ = ReadField<u64>(&read);
+  if ((data.size() - kTraceHeaderSize) / kTraceEventSize != num_events ||
+      (data.size() - kTraceHeaderSize) % kTraceEventSize != 0) {
+    Logger::get()->warn("Truncated input trace {}", path.string());
+    return {};
+  }
+
+  trace->events_.resize(num_events);
+  for (InputTraceEvent& event : trace->events_) {
+    event.timestamp_ns = ReadField<u64>(&read);
+    event.xrel = ReadField<float>(&read);
+    event.yrel = ReadField<float>(&read);
+    event.type = (InputTraceEventType)ReadField<u8>(&read);
+    event.button = ReadField<u8>(&read);
+  }
+  return trace;
+}
+
+}  // namespace aim
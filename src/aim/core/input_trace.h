@@ -0,0 +1,70 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+#include "aim/common/simple_types.h"
+
+namespace aim {
+
+enum class InputTraceEventType : u8 {
+  MOTION = 0,
+  BUTTON_DOWN = 1,
+  BUTTON_UP = 2,
+};
+
+// A raw mouse event as delivered by SDL. Stored on disk as a packed 18 byte record, see
+// input_trace.cc.
+struct InputTraceEvent {
+  // SDL event timestamp in nanoseconds.
+  u64 timestamp_ns = 0;
+  float xrel = 0;
+  float yrel = 0;
+  InputTraceEventType type = InputTraceEventType::MOTION;
+  u8 button = 0;
+};
+
+// Append only record of every mouse event during a run. Unlike the replay, which samples the
+// camera at a fixed rate, this keeps each event so high polling rate mice can be analyzed
+// exactly. The buffer is sized once before the run and never grows while recording.
+class InputTrace {
+ public:
+  InputTrace() {}
+  AIM_NO_COPY(InputTrace);
+
+  // Reserves room for duration_seconds worth of events at polling_rate_hz, up to a fixed cap.
+  void Reserve(float duration_seconds, int polling_rate_hz);
+
+  void SetStartTimestamp(u64 timestamp_ns) {
+    start_timestamp_ns_ = timestamp_ns;
+  }
+
+  // Events past the reserved capacity are dropped and counted instead of allocating.
+  void AddMotion(u64 timestamp_ns, float xrel, float yrel);
+  void AddButton(u64 timestamp_ns, u8 button, bool is_down);
+
+  const std::vector<InputTraceEvent>& events() const {
+    return events_;
+  }
+
+  u64 start_timestamp_ns() const {
+    return start_timestamp_ns_;
+  }
+
+  u64 num_dropped() const {
+    return num_dropped_;
+  }
+
+  bool WriteToFile(const std::filesystem::path& path) const;
+  static std::unique_ptr<InputTrace> ReadFromFile(const std::filesystem::path& path);
+
+ private:
+  void Add(const InputTraceEvent& event);
+
+  std::vector<InputTraceEvent> events_;
+  u64 start_timestamp_ns_ = 0;
+  u64 num_dropped_ = 0;
+};
+
+}  // namespace aim
@@ -0,0 +1,320 @@
+#include "packed_bundle.h"
+
+#include <absl/strings/strip.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+
+#include "aim/common/files.h"
+#include "aim/common/log.h"
+
+namespace aim {
+namespace {
+
+constexpr u32 kPackFileMagic = 0x50424941;  // "AIBP"
+constexpr u32 kPackFileVersion = 1;
+
+struct PackFileHeader {
+  u32 magic = kPackFileMagic;
+  u32 version = kPackFileVersion;
+  u64 num_resources = 0;
+};
+
+// Absolute position of a string or payload in the file.
+struct PackFileSpan {
+  u64 offset = 0;
+  u64 size = 0;
+};
+
+struct PackFileEntry {
+  u32 type = 0;
+  u32 reserved = 0;
+  PackFileSpan name;
+  PackFileSpan description;
+  PackFileSpan reference_id;
+  PackFileSpan payload;
+};
+
+// The resource to pack along with the strings its views point to.
+struct PackInput {
+  PackedResourceType type = PackedResourceType::SCENARIO;
+  std::string name;
+  std::string description;
+  std::string reference_id;
+  std::string payload;
+};
+
+bool ResourceLess(PackedResourceType lhs_type,
+                  std::string_view lhs_name,
+                  PackedResourceType rhs_type,
+                  std::string_view rhs_name) {
+  return std::tie(lhs_type, lhs_name) < std::tie(rhs_type, rhs_name);
+}
+
+bool IsValidType(u32 type) {
+  return type == (u32)PackedResourceType::SCENARIO || type == (u32)PackedResourceType::PLAYLIST;
+}
+
+template <typename T>
+void AppendValue(const T& value, std::string* out) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+PackFileSpan AppendData(const std::string& value, std::string* out) {
+  PackFileSpan span;
+  span.offset = out->size();
+  span.size = value.size();
+  out->append(value);
+  return span;
+}
+
+std::string GetResourceDirName(PackedResourceType type) {
+  return type == PackedResourceType::SCENARIO ? "scenarios" : "playlists";
+}
+
+// Reads every JSON file in dir into inputs, named by the file name without extension.
+template <typename Message>
+bool ReadResourceDir(const std::filesystem::path& dir,
+                     PackedResourceType type,
+                     bool recursive,
+                     std::vector<PackInput>* inputs) {
+  if (!std::filesystem::exists(dir)) {
+    return true;
+  }
+  auto add_file = [&](const std::filesystem::directory_entry& entry) {
+    std::string filename = entry.path().filename().string();
+    if (!std::filesystem::is_regular_file(entry) || !filename.ends_with(".json")) {
+      return true;
+    }
+    Message message;
+    if (!ReadJsonMessageFromFile(entry.path(), &message)) {
+      Logger::get()->warn("Unable to read {}", entry.path().string());
+      return false;
+    }
+    PackInput input;
+    input.type = type;
+    input.name = std::string(absl::StripSuffix(filename, ".json"));
+    if constexpr (std::is_same_v<Message, ScenarioDef>) {
+      input.description = message.description();
+      input.reference_id =
+          message.has_reference_def() ? message.reference_def().scenario_id() : "";
+    }
+    input.payload = message.SerializeAsString();
+    inputs->push_back(std::move(input));
+    return true;
+  };
+  if (recursive) {
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(dir)) {
+      if (!add_file(entry)) {
+        return false;
+      }
+    }
+  } else {
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+      if (!add_file(entry)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool WritePackFile(const std::filesystem::path& path, std::vector<PackInput> inputs) {
+  std::sort(inputs.begin(), inputs.end(), [](const PackInput& lhs, const PackInput& rhs) {
+    return ResourceLess(lhs.type, lhs.name, rhs.type, rhs.name);
+  });
+  for (int i = 1; i < inputs.size(); ++i) {
+    if (inputs[i - 1].type == inputs[i].type && inputs[i - 1].name == inputs[i].name) {
+      Logger::get()->warn("Bundle has two {} named {}",
+                          GetResourceDirName(inputs[i].type),
+                          inputs[i].name);
+      return false;
+    }
+  }
+
+  PackFileHeader header;
+  header.num_resources = inputs.size();
+  std::vector<PackFileEntry> entries(inputs.size());
+
+  // The strings are kept together ahead of the payloads so listing a bundle touches as few pages
+  // as possible.
+  std::string data;
+  size_t data_offset = sizeof(header) + sizeof(PackFileEntry) * entries.size();
+  data.resize(data_offset);
+  for (int i = 0; i < inputs.size(); ++i) {
+    entries[i].type = (u32)inputs[i].type;
+    entries[i].name = AppendData(inputs[i].name, &data);
+    entries[i].description = AppendData(inputs[i].description, &data);
+    entries[i].reference_id = AppendData(inputs[i].reference_id, &data);
+  }
+  for (int i = 0; i < inputs.size(); ++i) {
+    entries[i].payload = AppendData(inputs[i].payload, &data);
+  }
+  std::string table;
+  AppendValue(header, &table);
+  for (const PackFileEntry& entry : entries) {
+    AppendValue(entry, &table);
+  }
+  data.replace(0, data_offset, table);
+
+  std::filesystem::path temp_path = path;
+  temp_path += ".tmp";
+  std::ofstream outfile(temp_path, std::ios::binary | std::ios::trunc);
+  if (!outfile.is_open()) {
+    Logger::get()->warn("Unable to write packed bundle {}", temp_path.string());
+    return false;
+  }
+  outfile.write(data.data(), data.size());
+  outfile.close();
+  if (!outfile) {
+    Logger::get()->warn("Unable to write packed bundle {}", temp_path.string());
+    return false;
+  }
+  std::error_code ec;
+  std::filesystem::rename(temp_path, path, ec);
+  if (ec) {
+    Logger::get()->warn("Unable to replace packed bundle {}: {}", path.string(), ec.message());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+std::unique_ptr<PackedBundle> PackedBundle::Open(const std::filesystem::path& path) {
+  std::unique_ptr<MappedFile> file = MappedFile::Open(path);
+  if (!file) {
+    Logger::get()->warn("Unable to open packed bundle {}", path.string());
+    return nullptr;
+  }
+  std::string_view data = file->data();
+  auto invalid = [&](const char* reason) -> std::unique_ptr<PackedBundle> {
+    Logger::get()->warn("Ignoring invalid packed bundle {}: {}", path.string(), reason);
+    return nullptr;
+  };
+
+  PackFileHeader header;
+  if (data.size() < sizeof(header)) {
+    return invalid("truncated header");
+  }
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (header.magic != kPackFileMagic) {
+    return invalid("not a packed bundle");
+  }
+  if (header.version != kPackFileVersion) {
+    return invalid("unsupported version");
+  }
+  size_t max_resources = (data.size() - sizeof(header)) / sizeof(PackFileEntry);
+  if (header.num_resources > max_resources) {
+    return invalid("truncated table of contents");
+  }
+
+  // Every span is checked here so the views never need checking again.
+  u64 data_start = sizeof(header) + sizeof(PackFileEntry) * header.num_resources;
+  auto get_view = [&](const PackFileSpan& span, std::string_view* view) {
+    if (span.offset < data_start || span.offset > data.size() ||
+        span.size > data.size() - span.offset) {
+      return false;
+    }
+    *view = data.substr(span.offset, span.size);
+    return true;
+  };
+
+  std::unique_ptr<PackedBundle> bundle(new PackedBundle());
+  bundle->resources_.reserve(header.num_resources);
+  const char* entry_data = data.data() + sizeof(header);
+  for (u64 i = 0; i < header.num_resources; ++i) {
+    PackFileEntry entry;
+    std::memcpy(&entry, entry_data + i * sizeof(entry), sizeof(entry));
+    PackedResource resource;
+    resource.type = (PackedResourceType)entry.type;
+    bool ok = IsValidType(entry.type) && get_view(entry.name, &resource.name) &&
+              get_view(entry.description, &resource.description) &&
+              get_view(entry.reference_id, &resource.reference_id) &&
+              get_view(entry.payload, &resource.payload);
+    if (!ok) {
+      return invalid("corrupt table of contents");
+    }
+    if (bundle->resources_.size() > 0) {
+      const PackedResource& prev = bundle->resources_.back();
+      if (!ResourceLess(prev.type, prev.name, resource.type, resource.name)) {
+        return invalid("table of contents is not sorted");
+      }
+    }
+    bundle->resources_.push_back(resource);
+  }
+  bundle->path_ = path;
+  bundle->file_ = std::move(file);
+  return bundle;
+}
+
+const PackedResource* PackedBundle::Find(PackedResourceType type, std::string_view name) const {
+  auto it = std::lower_bound(resources_.begin(),
+                             resources_.end(),
+                             name,
+                             [&](const PackedResource& resource, std::string_view value) {
+                               return ResourceLess(resource.type, resource.name, type, value);
+                             });
+  if (it == resources_.end() || it->type != type || it->name != name) {
+    return nullptr;
+  }
+  return &*it;
+}
+
+bool PackedBundle::ReadScenario(std::string_view name, ScenarioDef* def) const {
+  const PackedResource* resource = Find(PackedResourceType::SCENARIO, name);
+  return resource != nullptr &&
+         def->ParseFromArray(resource->payload.data(), resource->payload.size());
+}
+
+bool PackedBundle::ReadPlaylist(std::string_view name, PlaylistDef* def) const {
+  const PackedResource* resource = Find(PackedResourceType::PLAYLIST, name);
+  return resource != nullptr &&
+         def->ParseFromArray(resource->payload.data(), resource->payload.size());
+}
+
+bool PackBundle(const std::filesystem::path& bundle_dir, const std::filesystem::path& pack_path) {
+  std::vector<PackInput> inputs;
+  bool ok =
+      ReadResourceDir<ScenarioDef>(
+          bundle_dir / "scenarios", PackedResourceType::SCENARIO, false, &inputs) &&
+      ReadResourceDir<PlaylistDef>(
+          bundle_dir / "playlists", PackedResourceType::PLAYLIST, true, &inputs);
+  if (!ok) {
+    return false;
+  }
+  return WritePackFile(pack_path, std::move(inputs));
+}
+
+bool UnpackBundle(const PackedBundle& bundle, const std::filesystem::path& bundle_dir) {
+  std::error_code ec;
+  std::filesystem::create_directories(bundle_dir / "scenarios", ec);
+  std::filesystem::create_directories(bundle_dir / "playlists", ec);
+  if (ec) {
+    Logger::get()->warn("Unable to create {}: {}", bundle_dir.string(), ec.message());
+    return false;
+  }
+  for (const PackedResource& resource : bundle.resources()) {
+    std::filesystem::path path =
+        bundle_dir / GetResourceDirName(resource.type) / (std::string(resource.name) + ".json");
+    bool ok;
+    if (resource.type == PackedResourceType::SCENARIO) {
+      ScenarioDef def;
+      ok = bundle.ReadScenario(resource.name, &def) && WriteJsonMessageToFile(path, def);
+    } else {
+      PlaylistDef def;
+      ok = bundle.ReadPlaylist(resource.name, &def) && WriteJsonMessageToFile(path, def);
+    }
+    if (!ok) {
+      Logger::get()->warn("Unable to unpack {}", path.string());
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace aim
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "aim/common/mapped_file.h"
+#include "aim/common/simple_types.h"
+#include "aim/proto/playlist.pb.h"
+#include "aim/proto/scenario.pb.h"
+
+namespace aim {
+
+// A bundle packed into one read only file, which can be installed in the bundles dir next to the
+// usual directory bundles.
+constexpr const char* kPackedBundleExtension = ".aimbundle";
+
+enum class PackedResourceType : u32 {
+  SCENARIO = 1,
+  PLAYLIST = 2,
+};
+
+// One resource of a packed bundle. The views point into the mapped file.
+struct PackedResource {
+  PackedResourceType type = PackedResourceType::SCENARIO;
+  std::string_view name;
+  // Only set for scenarios, so they can be listed without decoding the payload.
+  std::string_view description;
+  std::string_view reference_id;
+  // The binary encoded ScenarioDef or PlaylistDef.
+  std::string_view payload;
+};
+
+// A packed bundle file is a header, a table of contents, a table of the strings it refers to and
+// then the binary encoded payloads. The file is mapped rather than read, so opening even a large
+// bundle only touches the table of contents and reading a resource decodes it straight from the
+// mapping.
+class PackedBundle {
+ public:
+  // Returns null if the file can not be mapped or is not a valid packed bundle.
+  static std::unique_ptr<PackedBundle> Open(const std::filesystem::path& path);
+  AIM_NO_COPY(PackedBundle);
+
+  // Sorted by type and then name.
+  const std::vector<PackedResource>& resources() const {
+    return resources_;
+  }
+
+  // Returns null if there is no such resource.
+  const PackedResource* Find(PackedResourceType type, std::string_view name) const;
+
+  bool ReadScenario(std::string_view name, ScenarioDef* def) const;
+  bool ReadPlaylist(std::string_view name, PlaylistDef* def) const;
+
+  const std::filesystem::path& path() const {
+    return path_;
+  }
+
+ private:
+  PackedBundle() {}
+
+  std::filesystem::path path_;
+  std::unique_ptr<MappedFile> file_;
+  std::vector<PackedResource> resources_;
+};
+
+// Packs the scenarios and playlists of a bundle dir. Fails without writing anything if a file can
+// not be read, so a pack is never silently missing resources.
+bool PackBundle(const std::filesystem::path& bundle_dir, const std::filesystem::path& pack_path);
+
+// Writes every resource back out as JSON files laid out like a bundle dir.
+bool UnpackBundle(const PackedBundle& bundle, const std::filesystem::path& bundle_dir);
+
+}  // namespace aim
@@ -2,11 +2,16 @@
 
 #include <absl/strings/strip.h>
 
+#include <algorithm>
 #include <filesystem>
+#include <tuple>
 
 #include "aim/common/files.h"
 #include "aim/common/log.h"
+#include "aim/common/parallel.h"
+#include "aim/common/times.h"
 #include "aim/common/util.h"
+#include "aim/core/packed_bundle.h"
 
 namespace aim {
 namespace {
@@ -21,6 +26,12 @@ std::optional<std::filesystem::path> GetPlaylistPath(FileSystem* fs, const Resou
   if (!maybe_bundle.has_value()) {
     return {};
   }
+  if (maybe_bundle->packed) {
+    Logger::get()->warn("Unable to change {}, bundle {} is packed",
+                        resource.full_name(),
+                        resource.bundle_name());
+    return {};
+  }
   std::filesystem::path playlist_dir = maybe_bundle->path / "playlists";
   if (!std::filesystem::exists(playlist_dir)) {
     std::filesystem::create_directory(playlist_dir);
@@ -28,34 +39,106 @@ std::optional<std::filesystem::path> GetPlaylistPath(FileSystem* fs, const Resou
   return GetPlaylistPath(maybe_bundle->path, resource.relative_name());
 }
 
-std::vector<Playlist> LoadPlaylists(const std::string& bundle_name,
-                                    const std::filesystem::path& base_dir) {
-  if (!std::filesystem::exists(base_dir)) {
-    return {};
-  }
-  std::vector<Playlist> playlists;
-  for (const auto& entry : std::filesystem::recursive_directory_iterator(base_dir)) {
-    if (std::filesystem::is_regular_file(entry)) {
-      std::string filename = entry.path().filename().string();
-      if (!filename.ends_with(".json")) {
+struct PlaylistFile {
+  ResourceName name;
+  std::filesystem::path path;
+  // Set when the playlist is stored in the packed bundle at path rather than in its own file.
+  std::shared_ptr<const PackedBundle> packed_bundle;
+};
+
+// Lists the playlist files in each bundle, sorted by name within the bundle.
+std::vector<PlaylistFile> ListPlaylistFiles(const std::vector<BundleInfo>& bundles) {
+  std::vector<PlaylistFile> files;
+  for (const BundleInfo& bundle : bundles) {
+    if (bundle.packed) {
+      // Already sorted by name.
+      for (const PackedResource& resource : bundle.packed->resources()) {
+        if (resource.type == PackedResourceType::PLAYLIST) {
+          PlaylistFile file;
+          file.name.set(bundle.name, std::string(resource.name));
+          file.path = bundle.path;
+          file.packed_bundle = bundle.packed;
+          files.push_back(std::move(file));
+        }
+      }
+      continue;
+    }
+    std::filesystem::path base_dir = bundle.path / "playlists";
+    if (!std::filesystem::exists(base_dir)) {
+      continue;
+    }
+    size_t bundle_start = files.size();
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(base_dir)) {
+      if (!std::filesystem::is_regular_file(entry)) {
         continue;
       }
-      Playlist p;
-      p.name.set(bundle_name, absl::StripSuffix(filename, ".json"));
-
-      if (!ReadJsonMessageFromFile(entry.path(), &p.def)) {
-        Logger::get()->warn("Unable to read playlist {}", entry.path().string());
+      std::string filename = entry.path().filename().string();
+      if (!filename.ends_with(".json")) {
         continue;
       }
-      playlists.push_back(p);
+      PlaylistFile file;
+      file.name.set(bundle.name, absl::StripSuffix(filename, ".json"));
+      file.path = entry.path();
+      files.push_back(std::move(file));
     }
+    std::sort(files.begin() + bundle_start,
+              files.end(),
+              [](const PlaylistFile& lhs, const PlaylistFile& rhs) {
+                return lhs.name.relative_name() < rhs.name.relative_name();
+              });
   }
-  std::sort(playlists.begin(), playlists.end(), [](const Playlist& lhs, const Playlist& rhs) {
-    return lhs.name.full_name() < rhs.name.full_name();
+  return files;
+}
+
+// Parses the files on a worker pool. The result keeps the order of files and skips any which
+// could not be read.
+std::vector<Playlist> LoadPlaylists(std::vector<PlaylistFile> files) {
+  std::vector<std::optional<Playlist>> results(files.size());
+  ParallelFor(files.size(), [&](int i) {
+    const PlaylistFile& file = files[i];
+    Playlist playlist;
+    bool read = file.packed_bundle
+                    ? file.packed_bundle->ReadPlaylist(file.name.relative_name(), &playlist.def)
+                    : ReadJsonMessageFromFile(file.path, &playlist.def);
+    if (!read) {
+      Logger::get()->warn("Unable to read playlist {}", file.name.full_name());
+      return;
+    }
+    playlist.name = std::move(files[i].name);
+    results[i] = std::move(playlist);
   });
+
+  std::vector<Playlist> playlists;
+  playlists.reserve(results.size());
+  for (auto& result : results) {
+    if (result) {
+      playlists.push_back(std::move(*result));
+    }
+  }
   return playlists;
 }
 
+bool PlaylistNameLess(const ResourceName& lhs, const ResourceName& rhs) {
+  return std::tie(lhs.bundle_name(), lhs.relative_name()) <
+         std::tie(rhs.bundle_name(), rhs.relative_name());
+}
+
+// Returns the playlist stored at path if it is a playlist file anywhere under a bundle's
+// playlists dir.
+std::optional<ResourceName> GetPlaylistNameForPath(const std::vector<BundleInfo>& bundles,
+                                                   const std::filesystem::path& path) {
+  if (path.extension() != ".json") {
+    return {};
+  }
+  for (const BundleInfo& bundle : bundles) {
+    std::filesystem::path relative_path = path.lexically_relative(bundle.path / "playlists");
+    if (!relative_path.empty() && *relative_path.begin() != "..") {
+      return ResourceName(bundle.name, path.stem().string());
+    }
+  }
+  return {};
+}
+
 }  // namespace
 
 PlaylistManager::PlaylistManager(FileSystem* fs) : fs_(fs) {}
@@ -65,6 +148,7 @@ bool PlaylistManager::SavePlaylist(const ResourceName& name, const PlaylistDef&
   if (!path.has_value()) {
     return false;
   }
+  written_paths_.push_back(*path);
   return WriteJsonMessageToFile(*path, def);
 }
 
@@ -73,6 +157,7 @@ bool PlaylistManager::DeletePlaylist(const ResourceName& name) {
   if (!path.has_value()) {
     return false;
   }
+  written_paths_.push_back(*path);
   return std::filesystem::remove(*path);
 }
 
@@ -86,6 +171,8 @@ bool PlaylistManager::RenamePlaylist(const ResourceName& old_name, const Resourc
     return false;
   }
   std::filesystem::rename(*old_path, *new_path);
+  written_paths_.push_back(*old_path);
+  written_paths_.push_back(*new_path);
   return true;
 }
 
@@ -108,15 +195,100 @@ void PlaylistManager::RenameScenarioInAllPlaylists(const std::string& old_name,
 }
 
 void PlaylistManager::LoadPlaylistsFromDisk() {
-  playlists_.clear();
-  for (BundleInfo& bundle : fs_->GetBundles()) {
-    PushBackAll(&playlists_, LoadPlaylists(bundle.name, bundle.path / "playlists"));
-  }
+  written_paths_.clear();
+  Stopwatch stopwatch;
+  stopwatch.Start();
+  std::vector<PlaylistFile> files = ListPlaylistFiles(fs_->GetBundles());
+  int num_files = files.size();
+  playlists_ = LoadPlaylists(std::move(files));
+
   playlist_map_.clear();
+  playlist_map_.reserve(playlists_.size());
   for (const Playlist& playlist : playlists_) {
-    playlist_map_[playlist.name.full_name()] = playlist;
+    playlist_map_.emplace(playlist.name.full_name(), playlist);
   }
   playlist_run_map_.clear();
+  BuildSearchIndex();
+  Logger::get()->info("Loaded {} of {} playlists in {}ms",
+                      playlists_.size(),
+                      num_files,
+                      stopwatch.GetElapsedMicros() / 1000);
+}
+
+void PlaylistManager::UpdatePlaylistsFromDisk(std::vector<std::filesystem::path> changed_paths) {
+  PushBackAll(&changed_paths, written_paths_);
+  written_paths_.clear();
+  if (changed_paths.size() == 0) {
+    return;
+  }
+  std::sort(changed_paths.begin(), changed_paths.end());
+  changed_paths.erase(std::unique(changed_paths.begin(), changed_paths.end()), changed_paths.end());
+
+  std::vector<BundleInfo> bundles = fs_->GetBundles();
+  int num_updated = 0;
+  bool names_changed = false;
+  for (const std::filesystem::path& path : changed_paths) {
+    std::optional<ResourceName> name = GetPlaylistNameForPath(bundles, path);
+    if (!name) {
+      continue;
+    }
+    std::optional<Playlist> playlist;
+    std::error_code ec;
+    if (std::filesystem::is_regular_file(path, ec)) {
+      playlist = Playlist();
+      playlist->name = *name;
+      if (!ReadJsonMessageFromFile(path, &playlist->def)) {
+        Logger::get()->warn("Unable to read playlist {}", path.string());
+        playlist = {};
+      }
+    }
+
+    auto it = std::lower_bound(playlists_.begin(),
+                               playlists_.end(),
+                               *name,
+                               [](const Playlist& lhs, const ResourceName& rhs) {
+                                 return PlaylistNameLess(lhs.name, rhs);
+                               });
+    bool exists = it != playlists_.end() && it->name == *name;
+    std::string full_name = name->full_name();
+    if (playlist) {
+      if (exists && it->def.SerializeAsString() == playlist->def.SerializeAsString()) {
+        // Written by this class with the in memory playlist already up to date, so keep the run.
+        playlist_map_[full_name] = *it;
+        continue;
+      }
+      playlist_map_[full_name] = *playlist;
+      if (exists) {
+        *it = std::move(*playlist);
+      } else {
+        playlists_.insert(it, std::move(*playlist));
+        names_changed = true;
+      }
+    } else if (exists) {
+      playlists_.erase(it);
+      playlist_map_.erase(full_name);
+      names_changed = true;
+    } else {
+      continue;
+    }
+    playlist_run_map_.erase(full_name);
+    ++num_updated;
+  }
+  if (names_changed) {
+    BuildSearchIndex();
+  }
+  if (num_updated > 0) {
+    Logger::get()->info("Updated {} changed playlists", num_updated);
+  }
+}
+
+void PlaylistManager::BuildSearchIndex() {
+  std::vector<std::string> names;
+  names.reserve(playlists_.size());
+  for (const Playlist& playlist : playlists_) {
+    names.push_back(playlist.name.full_name());
+  }
+  search_index_.Build(names);
 }
 
 PlaylistRun* PlaylistManager::GetOptionalExistingRun(const std::string& name) {
@@ -7,6 +7,7 @@
 #include <unordered_map>
 
 #include "aim/common/resource_name.h"
+#include "aim/common/search.h"
 #include "aim/common/util.h"
 #include "aim/core/file_system.h"
 #include "aim/proto/playlist.pb.h"
@@ -46,6 +47,10 @@ class PlaylistManager {
   explicit PlaylistManager(FileSystem* fs);
 
   void LoadPlaylistsFromDisk();
+  // Re-reads only the given files, which may have been created, changed or deleted, plus any
+  // written through this class since the last update. Paths which are not playlist files are
+  // ignored.
+  void UpdatePlaylistsFromDisk(std::vector<std::filesystem::path> changed_paths);
 
   // Don't hold onto the pointer for long periods of time as it could be invalidated.
   PlaylistRun* GetCurrentRun() {
@@ -72,6 +77,11 @@ class PlaylistManager {
 
   std::optional<Playlist> GetPlaylist(const std::string& playlist_name) const;
 
+  // Indexes the full names of playlists() by position.
+  SearchIndex& search_index() {
+    return search_index_;
+  }
+
   void AddScenarioToPlaylist(const std::string& playlist_name, const std::string& scenario_name);
 
   bool SavePlaylist(const ResourceName& name, const PlaylistDef& def);
@@ -85,12 +95,15 @@ class PlaylistManager {
  private:
   PlaylistRun* GetOptionalExistingRun(const std::string& name);
   PlaylistRun InitializeRun(const Playlist& playlist);
+  void BuildSearchIndex();
 
   std::string current_playlist_name_;
   std::filesystem::path base_dir_;
   std::filesystem::path user_dir_;
   std::vector<Playlist> playlists_;
+  std::vector<std::filesystem::path> written_paths_;
   std::unordered_map<std::string, Playlist> playlist_map_;
+  SearchIndex search_index_;
   FileSystem* fs_;
   std::unordered_map<std::string, std::unique_ptr<PlaylistRun>> playlist_run_map_;
 };
@@ -0,0 +1,190 @@
+#include "replay_manager.h"
+
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <memory>
+
+#include "aim/common/log.h"
+#include "aim/common/times.h"
+
+namespace aim {
+namespace {
+
+constexpr const char* kReplayCodec = "proto";
+constexpr const int kKeepLastRunsPerScenario = 20;
+constexpr const int kKeepBestRunsPerScenario = 3;
+
+// 64-bit FNV-1a. Only used to detect truncated or corrupted replay files.
+u64 GetChecksum(const std::string& data) {
+  u64 hash = 14695981039346656037ULL;
+  for (unsigned char c : data) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+std::string GetInputTraceFileName(i64 stats_id) {
+  return std::format("{}.trace", stats_id);
+}
+
+}  // namespace
+
+ReplayManager::ReplayManager(FileSystem* fs, Database* database)
+    : replay_db_(std::make_unique<ReplayDb>(database)),
+      replay_dir_(fs->GetUserDataPath("replays")),
+      writer_(std::make_unique<TaskQueue>()) {}
+
+void ReplayManager::SaveReplay(const std::string& scenario_id,
+                               const StatsRow& stats,
+                               const Replay& replay,
+                               std::unique_ptr<InputTrace> input_trace) {
+  if (stats.stats_id <= 0) {
+    return;
+  }
+  std::string data;
+  if (!replay.SerializeToString(&data)) {
+    Logger::get()->warn("Unable to serialize replay for {}", scenario_id);
+    return;
+  }
+  ReplayRow row;
+  row.stats_id = stats.stats_id;
+  row.scenario_id = scenario_id;
+  row.timestamp = stats.timestamp.size() > 0 ? stats.timestamp : GetNowString();
+  row.score = stats.score;
+  row.codec = kReplayCodec;
+  row.byte_size = data.size();
+  row.checksum = GetChecksum(data);
+  row.file_name = std::format("{}.replay", stats.stats_id);
+  if (replay.replay_fps() > 0) {
+    row.duration_seconds = (replay.pitch_yaws_size() / 2) / (double)replay.replay_fps();
+  }
+
+  // The row is added right away so the replay shows up immediately. The payload, which can be
+  // many megabytes, is written on the writer thread.
+  replay_db_->AddReplay(row);
+  std::filesystem::path replay_path = replay_dir_ / row.file_name;
+  std::filesystem::path trace_path = replay_dir_ / GetInputTraceFileName(stats.stats_id);
+  std::shared_ptr<const InputTrace> trace = std::move(input_trace);
+  writer_->Submit([replay_path, trace_path, trace, data = std::move(data)] {
+    std::error_code ec;
+    std::filesystem::create_directories(replay_path.parent_path(), ec);
+    std::ofstream outfile(replay_path, std::ios::binary | std::ios::trunc);
+    if (!outfile.is_open()) {
+      Logger::get()->warn("Unable to write replay file {}", replay_path.string());
+      return;
+    }
+    outfile.write(data.data(), data.size());
+    outfile.close();
+    if (!outfile) {
+      Logger::get()->warn("Unable to write replay file {}", replay_path.string());
+      return;
+    }
+    if (trace) {
+      trace->WriteToFile(trace_path);
+    }
+  });
+  ApplyRetentionPolicy(scenario_id);
+}
+
+void ReplayManager::WaitForPendingWrites() {
+  writer_->WaitForIdle();
+}
+
+std::optional<ReplayRow> ReplayManager::GetReplayInfo(i64 stats_id) {
+  return replay_db_->GetReplay(stats_id);
+}
+
+std::vector<ReplayRow> ReplayManager::GetReplayInfos(const std::string& scenario_id) {
+  return replay_db_->GetReplays(scenario_id);
+}
+
+std::vector<ReplayRow> ReplayManager::GetAllReplayInfos() {
+  return replay_db_->GetAllReplays();
+}
+
+bool ReplayManager::HasReplay(i64 stats_id) {
+  return GetReplayInfo(stats_id).has_value();
+}
+
+std::unique_ptr<Replay> ReplayManager::LoadReplay(i64 stats_id) {
+  auto maybe_row = replay_db_->GetReplay(stats_id);
+  if (!maybe_row) {
+    return {};
+  }
+  WaitForPendingWrites();
+  return LoadReplay(*maybe_row);
+}
+
+std::unique_ptr<Replay> ReplayManager::LoadReplay(const ReplayRow& row) const {
+  if (row.codec != kReplayCodec) {
+    Logger::get()->warn("Unsupported replay codec {} for run {}", row.codec, row.stats_id);
+    return {};
+  }
+  std::ifstream file(replay_dir_ / row.file_name, std::ios::binary);
+  if (!file.is_open()) {
+    Logger::get()->warn("Missing replay file {}", row.file_name);
+    return {};
+  }
+  std::string data(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{});
+  if ((i64)data.size() != row.byte_size || GetChecksum(data) != row.checksum) {
+    Logger::get()->warn("Replay file {} is corrupted", row.file_name);
+    return {};
+  }
+  auto replay = std::make_unique<Replay>();
+  if (!replay->ParseFromString(data)) {
+    Logger::get()->warn("Unable to parse replay file {}", row.file_name);
+    return {};
+  }
+  return replay;
+}
+
+std::unique_ptr<InputTrace> ReplayManager::LoadInputTrace(i64 stats_id) const {
+  writer_->WaitForIdle();
+  return InputTrace::ReadFromFile(replay_dir_ / GetInputTraceFileName(stats_id));
+}
+
+void ReplayManager::DeleteReplay(i64 stats_id) {
+  auto maybe_row = replay_db_->GetReplay(stats_id);
+  if (!maybe_row) {
+    return;
+  }
+  DeleteReplayFile(*maybe_row);
+  replay_db_->DeleteReplay(stats_id);
+}
+
+void ReplayManager::DeleteAllReplays(const std::string& scenario_id) {
+  for (const ReplayRow& row : replay_db_->GetReplays(scenario_id)) {
+    DeleteReplayFile(row);
+  }
+  replay_db_->DeleteAllReplays(scenario_id);
+}
+
+bool ReplayManager::RenameScenario(const std::string& old_scenario_id,
+                                   const std::string& new_scenario_id) {
+  return replay_db_->RenameScenario(old_scenario_id, new_scenario_id);
+}
+
+void ReplayManager::ApplyRetentionPolicy(const std::string& scenario_id) {
+  auto expired = replay_db_->GetExpiredReplays(
+      scenario_id, kKeepLastRunsPerScenario, kKeepBestRunsPerScenario);
+  for (const ReplayRow& row : expired) {
+    DeleteReplayFile(row);
+    replay_db_->DeleteReplay(row.stats_id);
+  }
+}
+
+void ReplayManager::DeleteReplayFile(const ReplayRow& row) {
+  if (row.file_name.size() == 0) {
+    return;
+  }
+  writer_->Submit([replay_path = replay_dir_ / row.file_name,
+                    trace_path = replay_dir_ / GetInputTraceFileName(row.stats_id)] {
+    std::error_code ec;
+    std::filesystem::remove(replay_path, ec);
+    std::filesystem::remove(trace_path, ec);
+  });
+}
+
+}  // namespace aim
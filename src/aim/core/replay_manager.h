@@ -0,0 +1,72 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "aim/common/simple_types.h"
+#include "aim/common/task_queue.h"
+#include "aim/core/file_system.h"
+#include "aim/core/input_trace.h"
+#include "aim/database/database.h"
+#include "aim/database/replay_db.h"
+#include "aim/database/stats_db.h"
+#include "aim/proto/replay.pb.h"
+
+namespace aim {
+
+// Stores replays for runs keyed by the stats id of the run. Only metadata is kept in the
+// database. Payloads are written to individual files and only read when a replay is opened. Files
+// are written and deleted on a background thread, and loads wait for any pending writes.
+class ReplayManager {
+ public:
+  ReplayManager(FileSystem* fs, Database* database);
+  AIM_NO_COPY(ReplayManager);
+
+  // The replay is serialized right away, so it may be freed once this returns. The input trace is
+  // optional and is stored next to the replay payload.
+  void SaveReplay(const std::string& scenario_id,
+                  const StatsRow& stats,
+                  const Replay& replay,
+                  std::unique_ptr<InputTrace> input_trace = nullptr);
+
+  // Blocks until every replay file saved or deleted so far has been written.
+  void WaitForPendingWrites();
+
+  // Metadata only. Does not read any replay payloads.
+  std::optional<ReplayRow> GetReplayInfo(i64 stats_id);
+  std::vector<ReplayRow> GetReplayInfos(const std::string& scenario_id);
+  std::vector<ReplayRow> GetAllReplayInfos();
+
+  bool HasReplay(i64 stats_id);
+
+  // Reads and verifies the payload for the replay.
+  std::unique_ptr<Replay> LoadReplay(i64 stats_id);
+
+  // Reads and verifies the payload described by the metadata row. Only touches the replay file so
+  // it is safe to call from worker threads. Call WaitForPendingWrites() first if the replay may
+  // have just been saved.
+  std::unique_ptr<Replay> LoadReplay(const ReplayRow& row) const;
+
+  // Returns null if the run was recorded without an input trace.
+  std::unique_ptr<InputTrace> LoadInputTrace(i64 stats_id) const;
+
+  void DeleteReplay(i64 stats_id);
+  void DeleteAllReplays(const std::string& scenario_id);
+  bool RenameScenario(const std::string& old_scenario_id, const std::string& new_scenario_id);
+
+ private:
+  // Removes replays that are neither recent nor personal bests.
+  void ApplyRetentionPolicy(const std::string& scenario_id);
+  void DeleteReplayFile(const ReplayRow& row);
+
+  std::unique_ptr<ReplayDb> replay_db_;
+  std::filesystem::path replay_dir_;
+  // Writes and deletes replay files in order, so a delete never overtakes the write of the same
+  // file. Declared last so pending writes finish before the state they use is destroyed.
+  std::unique_ptr<TaskQueue> writer_;
+};
+
+}  // namespace aim
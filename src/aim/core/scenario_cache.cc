@@ -0,0 +1,180 @@
+#include "scenario_cache.h"
+
+#include <google/protobuf/descriptor.h>
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unordered_set>
+
+#include "aim/common/log.h"
+#include "aim/proto/scenario.pb.h"
+
+namespace aim {
+namespace {
+
+constexpr u32 kCacheFileMagic = 0x43534941;  // "AISC"
+constexpr u32 kCacheFileVersion = 2;
+
+struct CacheFileHeader {
+  u32 magic = kCacheFileMagic;
+  u32 version = kCacheFileVersion;
+  u64 schema_hash = 0;
+  u64 num_entries = 0;
+};
+
+// 64-bit FNV-1a.
+void AddToHash(const std::string& data, u64* hash) {
+  for (unsigned char c : data) {
+    *hash ^= c;
+    *hash *= 1099511628211ULL;
+  }
+}
+
+void AddFileToHash(const google::protobuf::FileDescriptor* file,
+                   std::unordered_set<const google::protobuf::FileDescriptor*>* visited,
+                   u64* hash) {
+  if (!visited->insert(file).second) {
+    return;
+  }
+  AddToHash(file->DebugString(), hash);
+  for (int i = 0; i < file->dependency_count(); ++i) {
+    AddFileToHash(file->dependency(i), visited, hash);
+  }
+}
+
+// Changes whenever a field is added to or removed from ScenarioDef or anything it uses. Entries
+// parsed by an older build could have read the JSON differently.
+u64 GetSchemaHash() {
+  static const u64 schema_hash = [] {
+    u64 hash = 14695981039346656037ULL;
+    std::unordered_set<const google::protobuf::FileDescriptor*> visited;
+    AddFileToHash(ScenarioDef::descriptor()->file(), &visited, &hash);
+    return hash;
+  }();
+  return schema_hash;
+}
+
+template <typename T>
+void AppendValue(T value, std::string* out) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void AppendString(const std::string& value, std::string* out) {
+  AppendValue<u64>(value.size(), out);
+  out->append(value);
+}
+
+class CacheReader {
+ public:
+  explicit CacheReader(const std::string& data) : data_(data) {}
+
+  template <typename T>
+  bool Read(T* value) {
+    if (data_.size() - offset_ < sizeof(T)) {
+      return false;
+    }
+    std::memcpy(value, data_.data() + offset_, sizeof(T));
+    offset_ += sizeof(T);
+    return true;
+  }
+
+  bool ReadString(std::string* value) {
+    u64 size;
+    if (!Read(&size) || data_.size() - offset_ < size) {
+      return false;
+    }
+    value->assign(data_.data() + offset_, size);
+    offset_ += size;
+    return true;
+  }
+
+  bool at_end() const {
+    return offset_ == data_.size();
+  }
+
+ private:
+  const std::string& data_;
+  size_t offset_ = 0;
+};
+
+}  // namespace
+
+ScenarioCache ReadScenarioCache(const std::filesystem::path& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return {};
+  }
+  std::string data(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{});
+  CacheReader reader(data);
+  CacheFileHeader header;
+  if (!reader.Read(&header) || header.magic != kCacheFileMagic ||
+      header.version != kCacheFileVersion) {
+    Logger::get()->warn("Ignoring invalid scenario cache {}", path.string());
+    return {};
+  }
+  if (header.schema_hash != GetSchemaHash()) {
+    Logger::get()->info("Scenario cache was written by another version, rebuilding");
+    return {};
+  }
+
+  ScenarioCache cache;
+  cache.reserve(header.num_entries);
+  for (u64 i = 0; i < header.num_entries; ++i) {
+    ScenarioCacheEntry entry;
+    bool ok = reader.ReadString(&entry.path) && reader.Read(&entry.file_size) &&
+              reader.Read(&entry.modify_time) && reader.ReadString(&entry.description) &&
+              reader.ReadString(&entry.reference_id);
+    if (!ok) {
+      Logger::get()->warn("Ignoring truncated scenario cache {}", path.string());
+      return {};
+    }
+    std::string key = entry.path;
+    cache.emplace(std::move(key), std::move(entry));
+  }
+  if (!reader.at_end()) {
+    Logger::get()->warn("Ignoring corrupted scenario cache {}", path.string());
+    return {};
+  }
+  return cache;
+}
+
+bool WriteScenarioCache(const std::filesystem::path& path,
+                        const std::vector<ScenarioCacheEntry>& entries) {
+  CacheFileHeader header;
+  header.schema_hash = GetSchemaHash();
+  header.num_entries = entries.size();
+
+  std::string data;
+  AppendValue(header, &data);
+  for (const ScenarioCacheEntry& entry : entries) {
+    AppendString(entry.path, &data);
+    AppendValue(entry.file_size, &data);
+    AppendValue(entry.modify_time, &data);
+    AppendString(entry.description, &data);
+    AppendString(entry.reference_id, &data);
+  }
+
+  std::filesystem::path temp_path = path;
+  temp_path += ".tmp";
+  std::ofstream outfile(temp_path, std::ios::binary | std::ios::trunc);
+  if (!outfile.is_open()) {
+    Logger::get()->warn("Unable to write scenario cache {}", temp_path.string());
+    return false;
+  }
+  outfile.write(data.data(), data.size());
+  outfile.close();
+  if (!outfile) {
+    Logger::get()->warn("Unable to write scenario cache {}", temp_path.string());
+    return false;
+  }
+  std::error_code ec;
+  std::filesystem::rename(temp_path, path, ec);
+  if (ec) {
+    Logger::get()->warn("Unable to replace scenario cache {}: {}", path.string(), ec.message());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace aim
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "aim/common/simple_types.h"
+
+namespace aim {
+
+// What the scenario browser needs from one scenario file as of when it was last parsed, so
+// unchanged files do not need to be read at startup.
+struct ScenarioCacheEntry {
+  std::string path;
+  u64 file_size = 0;
+  // Ticks of std::filesystem::file_time_type.
+  i64 modify_time = 0;
+
+  std::string description;
+  std::string reference_id;
+};
+
+// Keyed by path.
+using ScenarioCache = std::unordered_map<std::string, ScenarioCacheEntry>;
+
+// Returns an empty cache if the file is missing, corrupt or was written for a different version
+// of the scenario protos.
+ScenarioCache ReadScenarioCache(const std::filesystem::path& path);
+
+// Replaces the cache file so a crash while writing never leaves a partial cache behind.
+bool WriteScenarioCache(const std::filesystem::path& path,
+                        const std::vector<ScenarioCacheEntry>& entries);
+
+}  // namespace aim
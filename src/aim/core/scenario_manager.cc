@@ -5,18 +5,29 @@
 #include <shellapi.h>
 #endif
 
+#include <algorithm>
 #include <memory>
+#include <tuple>
+#include <unordered_set>
 #include <vector>
 
-#include "absl/strings/str_split.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/string_view.h"
 #include "absl/strings/strip.h"
 #include "aim/common/files.h"
 #include "aim/common/log.h"
+#include "aim/common/parallel.h"
+#include "aim/common/times.h"
 #include "aim/common/util.h"
 #include "aim/core/file_system.h"
+#include "aim/core/history_manager.h"
+#include "aim/core/packed_bundle.h"
 #include "aim/core/playlist_manager.h"
+#include "aim/core/replay_manager.h"
+#include "aim/core/scenario_cache.h"
 #include "aim/core/stats_manager.h"
+#include "aim/database/database.h"
+#include "aim/database/settings_db.h"
 
 namespace aim {
 namespace {
@@ -31,6 +42,12 @@ std::optional<std::filesystem::path> GetScenarioPath(FileSystem* fs, const Resou
   if (!maybe_bundle.has_value()) {
     return {};
   }
+  if (maybe_bundle->packed) {
+    Logger::get()->warn("Unable to change {}, bundle {} is packed",
+                        resource.full_name(),
+                        resource.bundle_name());
+    return {};
+  }
   std::filesystem::path scenario_dir = maybe_bundle->path / "scenarios";
   if (!std::filesystem::exists(scenario_dir)) {
     std::filesystem::create_directory(scenario_dir);
@@ -38,59 +55,218 @@ std::optional<std::filesystem::path> GetScenarioPath(FileSystem* fs, const Resou
   return GetScenarioPath(maybe_bundle->path, resource.relative_name());
 }
 
-std::vector<ScenarioItem> LoadScenarios(const std::string& bundle_name,
-                                        const std::filesystem::path& base_dir) {
-  if (!std::filesystem::exists(base_dir)) {
-    return {};
+constexpr const char* kScenarioCacheFileName = "scenario_cache.bin";
+// Enough for a long playlist and the reference chains of its scenarios.
+constexpr size_t kMaxLoadedScenarios = 256;
+
+// Fills in everything for scenarios in packed bundles, whose table of contents has the metadata.
+void ListPackedScenarios(const BundleInfo& bundle, std::vector<ScenarioInfo>* files) {
+  std::error_code ec;
+  i64 modify_time = std::filesystem::last_write_time(bundle.path, ec).time_since_epoch().count();
+  for (const PackedResource& resource : bundle.packed->resources()) {
+    if (resource.type != PackedResourceType::SCENARIO) {
+      continue;
+    }
+    ScenarioInfo file;
+    file.name.set(bundle.name, std::string(resource.name));
+    file.description = resource.description;
+    file.reference_id = resource.reference_id;
+    file.path = bundle.path;
+    file.file_size = resource.payload.size();
+    file.modify_time = modify_time;
+    file.packed_bundle = bundle.packed;
+    files->push_back(std::move(file));
   }
-  std::vector<ScenarioItem> scenarios;
-  for (const auto& entry : std::filesystem::directory_iterator(base_dir)) {
-    if (!std::filesystem::is_regular_file(entry)) {
+}
+
+// Lists the scenario files in each bundle, sorted by id within the bundle. Only the name and file
+// fields are filled in for scenarios which are not packed.
+std::vector<ScenarioInfo> ListScenarioFiles(const std::vector<BundleInfo>& bundles) {
+  std::vector<ScenarioInfo> files;
+  for (const BundleInfo& bundle : bundles) {
+    if (bundle.packed) {
+      // Already sorted by name.
+      ListPackedScenarios(bundle, &files);
       continue;
     }
-    std::string filename = entry.path().filename().string();
-    if (!filename.ends_with(".json")) {
+    std::filesystem::path base_dir = bundle.path / "scenarios";
+    if (!std::filesystem::exists(base_dir)) {
       continue;
     }
-    ScenarioItem item;
-    item.name.set(bundle_name, absl::StripSuffix(filename, ".json"));
+    size_t bundle_start = files.size();
+    for (const auto& entry : std::filesystem::directory_iterator(base_dir)) {
+      if (!std::filesystem::is_regular_file(entry)) {
+        continue;
+      }
+      std::string filename = entry.path().filename().string();
+      if (!filename.ends_with(".json")) {
+        continue;
+      }
+      ScenarioInfo file;
+      file.name.set(bundle.name, absl::StripSuffix(filename, ".json"));
+      file.path = entry.path();
+      std::error_code ec;
+      file.file_size = entry.file_size(ec);
+      file.modify_time = entry.last_write_time(ec).time_since_epoch().count();
+      files.push_back(std::move(file));
+    }
+    std::sort(files.begin() + bundle_start,
+              files.end(),
+              [](const ScenarioInfo& lhs, const ScenarioInfo& rhs) {
+                return lhs.name.relative_name() < rhs.name.relative_name();
+              });
+  }
+  return files;
+}
 
-    if (!ReadJsonMessageFromFile(entry.path(), &item.def)) {
-      Logger::get()->warn("Unable to read scenario {}", entry.path().string());
-      continue;
+bool ReadScenarioDef(const ScenarioInfo& info, ScenarioDef* def) {
+  bool read = info.packed_bundle ? info.packed_bundle->ReadScenario(info.name.relative_name(), def)
+                                 : ReadJsonMessageFromFile(info.path, def);
+  if (!read) {
+    Logger::get()->warn("Unable to read scenario {}", info.id());
+  }
+  return read;
+}
+
+// Parses the file to fill in the fields which come from its contents.
+bool ReadScenarioInfo(ScenarioInfo* info) {
+  ScenarioDef def;
+  if (!ReadJsonMessageFromFile(info->path, &def)) {
+    Logger::get()->warn("Unable to read scenario {}", info->path.string());
+    return false;
+  }
+  info->description = def.description();
+  info->reference_id = def.has_reference_def() ? def.reference_def().scenario_id() : "";
+  return true;
+}
+
+const ScenarioCacheEntry* FindCacheEntry(const ScenarioCache& cache, const ScenarioInfo& file) {
+  auto it = cache.find(file.path.string());
+  if (it == cache.end() || it->second.file_size != file.file_size ||
+      it->second.modify_time != file.modify_time) {
+    return nullptr;
+  }
+  return &it->second;
+}
+
+struct LoadedScenarioInfos {
+  std::vector<std::shared_ptr<const ScenarioInfo>> scenarios;
+  int num_cached = 0;
+  int num_packed = 0;
+};
+
+// Takes the info for unchanged files from the cache and parses the rest on a worker pool. Packed
+// scenarios are complete already. The result keeps the order of files and skips any which could
+// not be read.
+LoadedScenarioInfos LoadScenarioInfos(std::vector<ScenarioInfo> files, const ScenarioCache& cache) {
+  std::vector<char> loaded(files.size(), false);
+  std::vector<char> cached(files.size(), false);
+  ParallelFor(files.size(), [&](int i) {
+    ScenarioInfo& info = files[i];
+    if (info.packed_bundle) {
+      loaded[i] = true;
+      return;
+    }
+    const ScenarioCacheEntry* entry = FindCacheEntry(cache, info);
+    if (entry != nullptr) {
+      info.description = entry->description;
+      info.reference_id = entry->reference_id;
+      cached[i] = true;
+      loaded[i] = true;
+    } else {
+      loaded[i] = ReadScenarioInfo(&info);
+    }
+  });
+
+  LoadedScenarioInfos result;
+  result.scenarios.reserve(files.size());
+  for (int i = 0; i < files.size(); ++i) {
+    if (loaded[i]) {
+      result.scenarios.push_back(std::make_shared<ScenarioInfo>(std::move(files[i])));
+      result.num_cached += cached[i] ? 1 : 0;
+      result.num_packed += files[i].packed_bundle ? 1 : 0;
     }
-    item.unevaluated_def = item.def;
-    scenarios.push_back(item);
   }
-  std::sort(scenarios.begin(),
-            scenarios.end(),
-            [](const ScenarioItem& lhs, const ScenarioItem& rhs) { return lhs.id() < rhs.id(); });
-  return scenarios;
+  return result;
 }
 
-ScenarioNode* GetOrCreateNamedNode(std::vector<std::unique_ptr<ScenarioNode>>* nodes,
-                                   const std::string& name) {
-  for (auto& node : *nodes) {
-    if (node->name == name) {
-      return node.get();
+void SaveScenarioCache(const std::filesystem::path& path,
+                       const std::vector<std::shared_ptr<const ScenarioInfo>>& scenarios) {
+  std::vector<ScenarioCacheEntry> entries;
+  entries.reserve(scenarios.size());
+  for (const auto& info : scenarios) {
+    if (info->packed_bundle) {
+      continue;
+    }
+    ScenarioCacheEntry entry;
+    entry.path = info->path.string();
+    entry.file_size = info->file_size;
+    entry.modify_time = info->modify_time;
+    entry.description = info->description;
+    entry.reference_id = info->reference_id;
+    entries.push_back(std::move(entry));
+  }
+  WriteScenarioCache(path, entries);
+}
+
+// Orders scenarios the way ListScenarioFiles does, since bundles are listed by name.
+bool ScenarioNameLess(const ResourceName& lhs, const ResourceName& rhs) {
+  return std::tie(lhs.bundle_name(), lhs.relative_name()) <
+         std::tie(rhs.bundle_name(), rhs.relative_name());
+}
+
+std::vector<std::shared_ptr<const ScenarioInfo>>::iterator LowerBoundScenario(
+    std::vector<std::shared_ptr<const ScenarioInfo>>* scenarios, const ResourceName& name) {
+  return std::lower_bound(
+      scenarios->begin(),
+      scenarios->end(),
+      name,
+      [](const std::shared_ptr<const ScenarioInfo>& lhs, const ResourceName& rhs) {
+        return ScenarioNameLess(lhs->name, rhs);
+      });
+}
+
+// Returns the scenario stored at path if it is a scenario file directly in a bundle's scenarios
+// dir.
+std::optional<ResourceName> GetScenarioNameForPath(const std::vector<BundleInfo>& bundles,
+                                                   const std::filesystem::path& path) {
+  std::filesystem::path dir = path.parent_path();
+  if (path.extension() != ".json" || dir.filename() != "scenarios") {
+    return {};
+  }
+  for (const BundleInfo& bundle : bundles) {
+    if (bundle.path == dir.parent_path()) {
+      return ResourceName(bundle.name, path.stem().string());
     }
   }
+  return {};
+}
 
-  auto node = std::make_unique<ScenarioNode>();
-  node->name = name;
-  ScenarioNode* result = node.get();
-  nodes->push_back(std::move(node));
-  return result;
+// Nodes are only ever appended, so children keep the order of the first scenario under them.
+ScenarioNode* GetOrCreateNamedNode(const std::string& name,
+                                   std::unordered_map<std::string, ScenarioNode*>* node_map,
+                                   std::vector<std::unique_ptr<ScenarioNode>>* nodes) {
+  auto [it, inserted] = node_map->try_emplace(name, nullptr);
+  if (inserted) {
+    auto node = std::make_unique<ScenarioNode>();
+    node->name = name;
+    it->second = node.get();
+    nodes->push_back(std::move(node));
+  }
+  return it->second;
 }
 
 std::optional<std::string> StripLevelSuffix(const std::string& scenario_name,
                                             float* level_out = nullptr) {
-  std::vector<std::string_view> words =
-      absl::StrSplit(scenario_name, absl::ByAnyChar(" \t\n\r\f\v"), absl::SkipEmpty());
-  if (words.empty()) {
+  constexpr const char* kWhitespace = " \t\n\r\f\v";
+  size_t suffix_end = scenario_name.find_last_not_of(kWhitespace);
+  if (suffix_end == std::string::npos) {
     return {};
   }
-  std::string_view suffix = words.back();
+  size_t suffix_start = scenario_name.find_last_of(kWhitespace, suffix_end);
+  suffix_start = suffix_start == std::string::npos ? 0 : suffix_start + 1;
+  std::string_view suffix =
+      std::string_view(scenario_name).substr(suffix_start, suffix_end + 1 - suffix_start);
   if (suffix.length() <= 1 || suffix[0] != 'L') {
     return {};
   }
@@ -104,42 +280,62 @@ std::optional<std::string> StripLevelSuffix(const std::string& scenario_name,
   return std::string(stripped);
 }
 
-// Returns a list of scenario prefixes that should be grouped together in the UI.
-// This allows grouping all of the scenarios ending in L00, L01, L02.1 etc in the
-// scenario browser.
-std::vector<std::string> GetScenarioSharedPrefixes(const std::vector<ScenarioItem>& scenarios) {
+// Returns the scenario prefixes that should be grouped together in the UI, and sets the level
+// prefix of each scenario if it has one. This allows grouping all of the scenarios ending in L00,
+// L01, L02.1 etc in the scenario browser.
+std::unordered_set<std::string> GetScenarioSharedPrefixes(
+    const std::vector<std::string>& ids,
+    std::vector<std::optional<std::string>>* level_prefixes) {
   std::unordered_map<std::string, int> prefix_count_map;
-  std::unordered_set<std::string> scenario_names;
-  for (const ScenarioItem& s : scenarios) {
-    scenario_names.insert(s.id());
-    auto maybe_prefix = StripLevelSuffix(s.id());
-    if (maybe_prefix) {
-      prefix_count_map[*maybe_prefix]++;
+  level_prefixes->resize(ids.size());
+  for (int i = 0; i < ids.size(); ++i) {
+    (*level_prefixes)[i] = StripLevelSuffix(ids[i]);
+    if ((*level_prefixes)[i]) {
+      prefix_count_map[*(*level_prefixes)[i]]++;
     }
   }
-  std::vector<std::string> prefixes;
+  std::unordered_set<std::string> prefixes;
   for (auto& entry : prefix_count_map) {
-    if (entry.second > 4 && !scenario_names.contains(entry.first)) {
-      prefixes.push_back(entry.first);
+    if (entry.second > 4) {
+      prefixes.insert(entry.first);
     }
   }
+  // A prefix which is also the name of a scenario is not grouped. There are far fewer prefixes
+  // than scenarios, so look the scenarios up in the prefixes rather than the other way around.
+  for (const std::string& id : ids) {
+    prefixes.erase(id);
+  }
   return prefixes;
 }
 
 std::vector<std::unique_ptr<ScenarioNode>> GetTopLevelNodes(
-    const std::vector<ScenarioItem>& scenarios) {
+    const std::vector<std::shared_ptr<const ScenarioInfo>>& scenarios) {
+  std::vector<std::string> ids;
+  ids.reserve(scenarios.size());
+  for (const auto& item : scenarios) {
+    ids.push_back(item->id());
+  }
+  std::vector<std::optional<std::string>> level_prefixes;
+  std::unordered_set<std::string> prefixes = GetScenarioSharedPrefixes(ids, &level_prefixes);
+
   std::vector<std::unique_ptr<ScenarioNode>> nodes;
-  auto prefixes = GetScenarioSharedPrefixes(scenarios);
-  for (const ScenarioItem& item : scenarios) {
-    ScenarioNode* bundle = GetOrCreateNamedNode(&nodes, item.name.bundle_name());
+  std::unordered_map<std::string, ScenarioNode*> bundle_nodes;
+  // Prefixes start with the bundle name, so one map covers the prefix nodes of every bundle.
+  std::unordered_map<std::string, ScenarioNode*> prefix_nodes;
+  for (int i = 0; i < scenarios.size(); ++i) {
+    const auto& item = scenarios[i];
+    ScenarioNode* bundle =
+        GetOrCreateNamedNode(item->name.bundle_name(), &bundle_nodes, &nodes);
 
     auto scenario_node = std::make_unique<ScenarioNode>();
     scenario_node->scenario = item;
-    scenario_node->name = item.id();
+    scenario_node->name = std::move(ids[i]);
+    scenario_node->scenario_index = i;
 
-    auto maybe_prefix = StripLevelSuffix(item.id());
-    if (maybe_prefix && VectorContains(prefixes, *maybe_prefix)) {
-      ScenarioNode* prefix_node = GetOrCreateNamedNode(&bundle->child_nodes, *maybe_prefix);
+    const std::optional<std::string>& maybe_prefix = level_prefixes[i];
+    if (maybe_prefix && prefixes.contains(*maybe_prefix)) {
+      ScenarioNode* prefix_node =
+          GetOrCreateNamedNode(*maybe_prefix, &prefix_nodes, &bundle->child_nodes);
       prefix_node->child_nodes.emplace_back(std::move(scenario_node));
     } else {
       bundle->child_nodes.emplace_back(std::move(scenario_node));
@@ -149,91 +345,284 @@ std::vector<std::unique_ptr<ScenarioNode>> GetTopLevelNodes(
   return nodes;
 }
 
+void UpdateScenarioNodes(
+    const std::unordered_map<std::string, std::shared_ptr<const ScenarioInfo>>& scenario_map,
+    const std::unordered_set<std::string>& ids,
+    std::vector<std::unique_ptr<ScenarioNode>>* nodes) {
+  for (auto& node : *nodes) {
+    if (node->scenario) {
+      auto it = scenario_map.find(node->name);
+      if (it != scenario_map.end() && ids.contains(node->name)) {
+        node->scenario = it->second;
+      }
+    }
+    UpdateScenarioNodes(scenario_map, ids, &node->child_nodes);
+  }
+}
+
 }  // namespace
 
 ScenarioManager::ScenarioManager(FileSystem* fs,
+                                 Database* database,
                                  PlaylistManager* playlist_manager,
-                                 StatsManager* stats_manager)
-    : fs_(fs), playlist_manager_(playlist_manager), stats_manager_(stats_manager) {}
+                                 StatsManager* stats_manager,
+                                 ReplayManager* replay_manager,
+                                 HistoryManager* history_manager,
+                                 SettingsDb* settings_db)
+    : loaded_scenarios_(kMaxLoadedScenarios),
+      fs_(fs),
+      database_(database),
+      playlist_manager_(playlist_manager),
+      stats_manager_(stats_manager),
+      replay_manager_(replay_manager),
+      history_manager_(history_manager),
+      settings_db_(settings_db) {}
 
 std::vector<std::string> ScenarioManager::GetAllRelativeNamesInBundle(
     const std::string& bundle_name) {
   std::vector<std::string> names;
-  for (const ScenarioItem& s : scenarios()) {
-    if (s.name.bundle_name() == bundle_name) {
-      names.push_back(s.name.relative_name());
+  for (const auto& s : scenarios()) {
+    if (s->name.bundle_name() == bundle_name) {
+      names.push_back(s->name.relative_name());
     }
   }
   return names;
 }
 
 void ScenarioManager::LoadScenariosFromDisk() {
-  scenarios_.clear();
+  written_paths_.clear();
+  Stopwatch stopwatch;
+  stopwatch.Start();
+  std::vector<ScenarioInfo> files = ListScenarioFiles(fs_->GetBundles());
+  std::filesystem::path cache_path = fs_->GetUserDataPath(kScenarioCacheFileName);
+  ScenarioCache cache = ReadScenarioCache(cache_path);
+  i64 list_micros = stopwatch.GetElapsedMicros();
+
+  int num_files = files.size();
+  LoadedScenarioInfos loaded = LoadScenarioInfos(std::move(files), cache);
+  scenarios_ = std::move(loaded.scenarios);
   scenario_map_.clear();
-  for (BundleInfo& bundle : fs_->GetBundles()) {
-    PushBackAll(&scenarios_, LoadScenarios(bundle.name, bundle.path / "scenarios"));
+  scenario_map_.reserve(scenarios_.size());
+  for (const auto& info : scenarios_) {
+    scenario_map_.emplace(info->id(), info);
   }
-  for (ScenarioItem& item : scenarios_) {
-    scenario_map_[item.id()] = item;
+  loaded_scenarios_.Clear();
+  if (loaded.num_cached + loaded.num_packed != scenarios_.size() ||
+      cache.size() != loaded.num_cached) {
+    SaveScenarioCache(cache_path, scenarios_);
   }
+  cache.clear();
+
+  scenario_nodes_ = GetTopLevelNodes(scenarios_);
+  BuildSearchIndex();
+  ++generation_;
+  Logger::get()->info("Loaded {} of {} scenarios ({} cached, {} packed) in {}ms (list {}ms)",
+                      scenarios_.size(),
+                      num_files,
+                      loaded.num_cached,
+                      loaded.num_packed,
+                      stopwatch.GetElapsedMicros() / 1000,
+                      list_micros / 1000);
+}
 
-  // Now evaluate all references.
-  for (ScenarioItem& item : scenarios_) {
-    auto evaluated_scenario = GetEvaluatedScenario(item.id());
-    if (evaluated_scenario) {
-      item.def = evaluated_scenario->def;
+void ScenarioManager::UpdateScenariosFromDisk(std::vector<std::filesystem::path> changed_paths) {
+  PushBackAll(&changed_paths, written_paths_);
+  written_paths_.clear();
+  if (changed_paths.size() == 0) {
+    return;
+  }
+  Stopwatch stopwatch;
+  stopwatch.Start();
+  std::sort(changed_paths.begin(), changed_paths.end());
+  changed_paths.erase(std::unique(changed_paths.begin(), changed_paths.end()), changed_paths.end());
+
+  std::vector<BundleInfo> bundles = fs_->GetBundles();
+  std::vector<std::string> changed_ids;
+  bool ids_changed = false;
+  for (const std::filesystem::path& path : changed_paths) {
+    std::optional<ResourceName> name = GetScenarioNameForPath(bundles, path);
+    if (!name) {
+      continue;
+    }
+    std::shared_ptr<ScenarioInfo> info;
+    std::error_code ec;
+    if (std::filesystem::is_regular_file(path, ec)) {
+      info = std::make_shared<ScenarioInfo>();
+      info->name = *name;
+      info->path = path;
+      info->file_size = std::filesystem::file_size(path, ec);
+      info->modify_time = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+      if (!ReadScenarioInfo(info.get())) {
+        info = nullptr;
+      }
+    }
+
+    auto it = LowerBoundScenario(&scenarios_, *name);
+    bool exists = it != scenarios_.end() && (*it)->name == *name;
+    std::string id = name->full_name();
+    if (info) {
+      scenario_map_[id] = info;
+      if (exists) {
+        *it = std::move(info);
+      } else {
+        scenarios_.insert(it, std::move(info));
+        ids_changed = true;
+      }
+    } else if (exists) {
+      scenarios_.erase(it);
+      scenario_map_.erase(id);
+      ids_changed = true;
     } else {
-      item.has_invalid_reference = true;
+      continue;
     }
-    scenario_map_[item.id()] = item;
+    changed_ids.push_back(std::move(id));
+  }
+  if (changed_ids.size() == 0) {
+    return;
   }
 
-  scenario_nodes_ = GetTopLevelNodes(scenarios_);
+  // Everything whose reference chain passes through a changed scenario is unloaded so it is read
+  // and evaluated again when next used.
+  std::unordered_map<std::string, std::vector<std::string>> dependents;
+  for (const auto& info : scenarios_) {
+    if (info->reference_id.size() > 0) {
+      dependents[info->reference_id].push_back(info->id());
+    }
+  }
+  std::unordered_set<std::string> affected_ids(changed_ids.begin(), changed_ids.end());
+  std::vector<std::string> pending_ids = changed_ids;
+  while (pending_ids.size() > 0) {
+    std::string id = std::move(pending_ids.back());
+    pending_ids.pop_back();
+    for (const std::string& dependent_id : dependents[id]) {
+      if (affected_ids.insert(dependent_id).second) {
+        pending_ids.push_back(dependent_id);
+      }
+    }
+  }
+  for (const std::string& id : affected_ids) {
+    loaded_scenarios_.Erase(id);
+  }
+
+  // The grouping by level prefix and the positions of scenarios depend on the full set of ids, so
+  // the tree and search index are only rebuilt when that changes.
+  if (ids_changed) {
+    scenario_nodes_ = GetTopLevelNodes(scenarios_);
+    BuildSearchIndex();
+  } else {
+    UpdateScenarioNodes(scenario_map_, affected_ids, &scenario_nodes_);
+  }
+  ++generation_;
+  Logger::get()->info("Updated {} changed scenarios and {} dependents in {}ms",
+                      changed_ids.size(),
+                      affected_ids.size() - changed_ids.size(),
+                      stopwatch.GetElapsedMicros() / 1000);
 }
 
-std::optional<ScenarioItem> ScenarioManager::GetScenario(const std::string& scenario_id) {
+std::shared_ptr<const ScenarioInfo> ScenarioManager::GetScenarioInfo(
+    const std::string& scenario_id) const {
   auto it = scenario_map_.find(scenario_id);
   if (it != scenario_map_.end()) {
     return it->second;
   }
-  return {};
+  return nullptr;
 }
 
-std::optional<ScenarioItem> ScenarioManager::GetEvaluatedScenario(const std::string& scenario_id) {
-  std::unordered_set<std::string> visited_scenario_names;
-  return GetEvaluatedScenario(scenario_id, &visited_scenario_names);
-}
-
-std::optional<ScenarioItem> ScenarioManager::GetEvaluatedScenario(
-    const std::string& scenario_id, std::unordered_set<std::string>* visited_scenario_names) {
-  bool added = visited_scenario_names->insert(scenario_id).second;
-  if (!added) {
-    Logger::get()->warn("Scenario cycle detected reading {}", scenario_id);
-    return {};
+std::shared_ptr<const ScenarioItem> ScenarioManager::GetScenario(const std::string& scenario_id) {
+  const std::shared_ptr<const ScenarioItem>* loaded = loaded_scenarios_.Get(scenario_id);
+  if (loaded != nullptr) {
+    return *loaded;
+  }
+
+  // Each scenario references at most one other. Read the chain until reaching a scenario without
+  // a reference or one which is already loaded.
+  std::vector<std::shared_ptr<ScenarioItem>> chain;
+  std::unordered_set<std::string> chain_ids;
+  std::shared_ptr<const ScenarioItem> referenced;
+  std::optional<std::string> cycle_id;
+  std::string id = scenario_id;
+  while (true) {
+    if (!chain_ids.insert(id).second) {
+      cycle_id = id;
+      break;
+    }
+    if (chain.size() > 0) {
+      loaded = loaded_scenarios_.Get(id);
+      if (loaded != nullptr) {
+        referenced = *loaded;
+        break;
+      }
+    }
+    auto info_it = scenario_map_.find(id);
+    if (info_it == scenario_map_.end()) {
+      break;
+    }
+    auto item = std::make_shared<ScenarioItem>();
+    item->name = info_it->second->name;
+    if (!ReadScenarioDef(*info_it->second, &item->unevaluated_def)) {
+      break;
+    }
+    chain.push_back(item);
+    if (!item->unevaluated_def.has_reference_def()) {
+      break;
+    }
+    id = item->unevaluated_def.reference_def().scenario_id();
   }
-  auto maybe_scenario = GetScenario(scenario_id);
-  if (!maybe_scenario) {
-    return {};
+  if (chain.size() == 0) {
+    return nullptr;
   }
-  ScenarioItem scenario = *maybe_scenario;
-  if (!scenario.def.has_reference_def()) {
-    scenario.def = ApplyScenarioOverrides(scenario.def);
-    return scenario;
+
+  if (cycle_id) {
+    std::string cycle;
+    bool in_cycle = false;
+    for (const auto& item : chain) {
+      std::string item_id = item->id();
+      in_cycle = in_cycle || item_id == *cycle_id;
+      if (in_cycle) {
+        cycle += item_id + " -> ";
+      }
+    }
+    Logger::get()->warn("Scenario reference cycle: {}{}", cycle, *cycle_id);
+  }
+
+  // Evaluate from the end of the chain so each scenario builds on the one it references.
+  for (int i = chain.size() - 1; i >= 0; --i) {
+    ScenarioItem* item = chain[i].get();
+    const ScenarioItem* base = i + 1 < chain.size() ? chain[i + 1].get() : referenced.get();
+    const ScenarioDef& def = item->unevaluated_def;
+    if (!def.has_reference_def()) {
+      item->def = ApplyScenarioOverrides(def);
+    } else if (cycle_id || base == nullptr || base->has_invalid_reference) {
+      item->def = def;
+      item->has_invalid_reference = true;
+    } else {
+      item->def = base->def;
+      if (def.has_overrides()) {
+        *item->def.mutable_overrides() = def.overrides();
+        item->def = ApplyScenarioOverrides(item->def);
+      }
+    }
+    loaded_scenarios_.Put(item->id(), chain[i]);
   }
+  return chain[0];
+}
 
-  auto referenced_scenario =
-      GetEvaluatedScenario(scenario.def.reference_def().scenario_id(), visited_scenario_names);
-  if (!referenced_scenario) {
-    return {};
+std::shared_ptr<const ScenarioItem> ScenarioManager::GetEvaluatedScenario(
+    const std::string& scenario_id) {
+  std::shared_ptr<const ScenarioItem> item = GetScenario(scenario_id);
+  if (!item || item->has_invalid_reference) {
+    return nullptr;
   }
+  return item;
+}
 
-  ScenarioItem resolved = *referenced_scenario;
-  resolved.name = scenario.name;
-  if (scenario.def.has_overrides()) {
-    *resolved.def.mutable_overrides() = scenario.def.overrides();
-    resolved.def = ApplyScenarioOverrides(resolved.def);
+void ScenarioManager::BuildSearchIndex() {
+  std::vector<std::string> ids;
+  ids.reserve(scenarios_.size());
+  for (const auto& item : scenarios_) {
+    ids.push_back(item->id());
   }
-  return resolved;
+  search_index_.Build(ids);
 }
 
 ScenarioDef ApplyScenarioOverrides(const ScenarioDef& original) {
@@ -269,6 +658,7 @@ bool ScenarioManager::SaveScenario(const ResourceName& name, const ScenarioDef&
   if (!path.has_value()) {
     return false;
   }
+  written_paths_.push_back(*path);
   return WriteJsonMessageToFile(*path, def);
 }
 
@@ -286,6 +676,7 @@ bool ScenarioManager::DeleteScenario(const ResourceName& name) {
   if (!path.has_value()) {
     return false;
   }
+  written_paths_.push_back(*path);
   return std::filesystem::remove(*path);
 }
 
@@ -299,15 +690,33 @@ bool ScenarioManager::RenameScenario(const ResourceName& old_name, const Resourc
     return false;
   }
   std::filesystem::rename(*old_path, *new_path);
+  written_paths_.push_back(*old_path);
+  written_paths_.push_back(*new_path);
   playlist_manager_->RenameScenarioInAllPlaylists(old_name.full_name(), new_name.full_name());
-  stats_manager_->RenameScenario(old_name.full_name(), new_name.full_name());
+
+  // Stats, replays, history and settings are renamed in one transaction so a failure in any of
+  // them rolls all of them back. A crash mid commit can still leave some files renamed, since
+  // commits are only atomic per file. Queued stats writes need the stats db so they must finish
+  // before the transaction takes the write lock.
+  const std::string& old_id = old_name.full_name();
+  const std::string& new_id = new_name.full_name();
+  stats_manager_->WaitForPendingWrites();
+  bool renamed = database_->RunInTransaction([&] {
+    return stats_manager_->RenameScenario(old_id, new_id) &&
+           replay_manager_->RenameScenario(old_id, new_id) &&
+           history_manager_->RenameScenario(old_id, new_id) &&
+           settings_db_->RenameScenario(old_id, new_id);
+  });
+  if (!renamed) {
+    Logger::get()->warn("Unable to move stats and history from {} to {}", old_id, new_id);
+  }
 
   // Fix any references to the renamed scenario.
-  for (const ScenarioItem& item : scenarios_) {
-    if (item.def.reference_def().scenario_id() == old_name.full_name()) {
-      ScenarioDef new_def = item.def;
-      new_def.mutable_reference_def()->set_scenario_id(new_name.full_name());
-      SaveScenario(item.name, new_def);
+  for (const auto& info : scenarios_) {
+    ScenarioDef def;
+    if (info->reference_id == old_id && !info->packed_bundle && ReadScenarioDef(*info, &def)) {
+      def.mutable_reference_def()->set_scenario_id(new_id);
+      SaveScenario(info->name, def);
     }
   }
   return true;
@@ -325,7 +734,7 @@ void ScenarioManager::OpenFile(const ResourceName& name) {
 void ScenarioManager::GenerateScenarioLevels(const std::string& starting_scenario_id,
                                              const ScenarioOverrides& overrides,
                                              int num_levels) {
-  auto starting_scenario = GetScenario(starting_scenario_id);
+  auto starting_scenario = GetScenarioInfo(starting_scenario_id);
   if (!starting_scenario) {
     return;
   }
@@ -343,7 +752,7 @@ void ScenarioManager::GenerateScenarioLevels(const std::string& starting_scenari
                                     ? std::format("{} L0{}", *base_name, current_level)
                                     : std::format("{} L{}", *base_name, current_level);
     ResourceName next(bundle_name, relative_name);
-    if (GetScenario(next.full_name()).has_value()) {
+    if (GetScenarioInfo(next.full_name()) != nullptr) {
       return;
     }
     ScenarioDef def;
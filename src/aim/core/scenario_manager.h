@@ -1,12 +1,15 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
 #include <optional>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "aim/common/lru_cache.h"
 #include "aim/common/resource_name.h"
+#include "aim/common/search.h"
 #include "aim/common/simple_types.h"
 #include "aim/core/file_system.h"
 #include "aim/core/screen.h"
@@ -14,9 +17,35 @@
 
 namespace aim {
 
+class Database;
+class HistoryManager;
 class PlaylistManager;
+class ReplayManager;
+class SettingsDb;
 class StatsManager;
 
+// What browsing needs to know about an installed scenario, kept for every scenario without reading
+// the full def.
+struct ScenarioInfo {
+  ResourceName name;
+  std::string description;
+  // The scenario this one extends, if it is a reference scenario.
+  std::string reference_id;
+
+  std::filesystem::path path;
+  u64 file_size = 0;
+  // Ticks of std::filesystem::file_time_type.
+  i64 modify_time = 0;
+  // Set when the scenario is stored in the packed bundle at path rather than in its own file.
+  std::shared_ptr<const PackedBundle> packed_bundle;
+
+  std::string id() const {
+    return name.full_name();
+  }
+};
+
+// Items are shared as std::shared_ptr<const ScenarioItem> and never modified once handed out, so
+// a handle stays valid after the scenario is reloaded. Reloading publishes a new item instead.
 struct ScenarioItem {
   ResourceName name;
   ScenarioDef def;
@@ -33,7 +62,9 @@ struct ScenarioItem {
 struct ScenarioNode {
   // Either name or scenario will be specified. If scenario is set, this is a leaf node.
   std::string name;
-  std::optional<ScenarioItem> scenario;
+  std::shared_ptr<const ScenarioInfo> scenario;
+  // Position of the scenario in ScenarioManager::scenarios() and its search index.
+  int scenario_index = -1;
   std::vector<std::unique_ptr<ScenarioNode>> child_nodes;
 };
 
@@ -41,21 +72,47 @@ ScenarioDef ApplyScenarioOverrides(const ScenarioDef& original_def);
 
 class ScenarioManager {
  public:
-  ScenarioManager(FileSystem* fs, PlaylistManager* playlist_manager, StatsManager* stats_manager);
+  ScenarioManager(FileSystem* fs,
+                  Database* database,
+                  PlaylistManager* playlist_manager,
+                  StatsManager* stats_manager,
+                  ReplayManager* replay_manager,
+                  HistoryManager* history_manager,
+                  SettingsDb* settings_db);
   AIM_NO_COPY(ScenarioManager);
 
   void LoadScenariosFromDisk();
+  // Re-reads only the given files, which may have been created, changed or deleted, plus any
+  // written through this class since the last update, then unloads every scenario which
+  // references them. Paths which are not scenario files are ignored.
+  void UpdateScenariosFromDisk(std::vector<std::filesystem::path> changed_paths);
   std::vector<std::string> GetAllRelativeNamesInBundle(const std::string& bundle_name);
 
-  std::optional<ScenarioItem> GetScenario(const std::string& scenario_id);
+  // Returns null if there is no scenario with this id. Does not read the scenario file.
+  std::shared_ptr<const ScenarioInfo> GetScenarioInfo(const std::string& scenario_id) const;
 
-  // Gets the scenario following any references and applying all overrides.
-  std::optional<ScenarioItem> GetEvaluatedScenario(const std::string& scenario_id);
+  // Reads the scenario and the chain of scenarios it references the first time it is used. The
+  // most recently used scenarios stay loaded. Returns null if there is no scenario with this id.
+  std::shared_ptr<const ScenarioItem> GetScenario(const std::string& scenario_id);
 
-  std::optional<ScenarioItem> GetCurrentScenario() {
+  // Gets the scenario following any references and applying all overrides. Returns null if the
+  // scenario is missing or its references can not be resolved.
+  std::shared_ptr<const ScenarioItem> GetEvaluatedScenario(const std::string& scenario_id);
+
+  std::shared_ptr<const ScenarioItem> GetCurrentScenario() {
     return GetScenario(current_scenario_id_);
   }
 
+  const std::string& current_scenario_id() const {
+    return current_scenario_id_;
+  }
+
+  // Incremented whenever scenarios are loaded or updated from disk. Callers which keep a handle
+  // can compare this to know when to look the scenario up again.
+  u64 generation() const {
+    return generation_;
+  }
+
   void ClearCurrentScenario() {
     current_scenario_id_ = "";
     current_running_scenario_ = {};
@@ -70,10 +127,10 @@ class ScenarioManager {
       current_running_scenario_ = {};
     }
     current_scenario_id_ = scenario_id;
-    return GetScenario(scenario_id).has_value();
+    return GetScenarioInfo(scenario_id) != nullptr;
   }
 
-  const std::vector<ScenarioItem>& scenarios() const {
+  const std::vector<std::shared_ptr<const ScenarioInfo>>& scenarios() const {
     return scenarios_;
   }
 
@@ -81,6 +138,11 @@ class ScenarioManager {
     return scenario_nodes_;
   }
 
+  // Indexes the ids of scenarios() by position.
+  SearchIndex& search_index() {
+    return search_index_;
+  }
+
   bool SaveScenario(const ResourceName& name, const ScenarioDef& def);
   // Return the name the scenario was saved with if successful.
   std::optional<ResourceName> SaveScenarioWithUniqueName(const ResourceName& name,
@@ -103,18 +165,26 @@ class ScenarioManager {
   }
 
  private:
-  std::optional<ScenarioItem> GetEvaluatedScenario(
-      const std::string& scenario_id, std::unordered_set<std::string>* visited_scenario_names);
+  void BuildSearchIndex();
 
-  std::vector<ScenarioItem> scenarios_;
-  std::unordered_map<std::string, ScenarioItem> scenario_map_;
+  std::vector<std::shared_ptr<const ScenarioInfo>> scenarios_;
+  std::unordered_map<std::string, std::shared_ptr<const ScenarioInfo>> scenario_map_;
+  // Evaluated scenarios by id.
+  LruCache<std::string, std::shared_ptr<const ScenarioItem>> loaded_scenarios_;
   std::vector<std::unique_ptr<ScenarioNode>> scenario_nodes_;
+  SearchIndex search_index_;
+  std::vector<std::filesystem::path> written_paths_;
   FileSystem* fs_;
+  Database* database_;
   PlaylistManager* playlist_manager_;
   StatsManager* stats_manager_;
+  ReplayManager* replay_manager_;
+  HistoryManager* history_manager_;
+  SettingsDb* settings_db_;
   std::shared_ptr<Screen> current_running_scenario_;
 
   std::string current_scenario_id_;
+  u64 generation_ = 0;
 };
 
 }  // namespace aim
@@ -130,15 +130,21 @@ SettingsManager::SettingsManager(const std::filesystem::path& settings_path,
                                  SettingsDb* settings_db,
                                  HistoryManager* history_manager)
     : settings_path_(settings_path),
+      settings_writer_(settings_path),
       theme_dir_(theme_dir),
       texture_dir_(texture_dir),
       settings_db_(settings_db),
       history_manager_(history_manager) {}
 
 SettingsManager::~SettingsManager() {
-  if (needs_save_) {
+  if (needs_save_ || settings_writer_.TakeWriteFailed()) {
     FlushToDisk("");
   }
+  // Skips the write and retry delays so nothing is lost on exit. A failure here means every retry
+  // failed too, so all that is left is to report it.
+  if (!settings_writer_.Flush()) {
+    Logger::get()->error("Unable to save settings to {}", settings_path_.string());
+  }
 }
 
 absl::Status SettingsManager::Initialize() {
@@ -297,6 +303,10 @@ void SettingsManager::MaybeInvalidateThemeCache() {
   }
 }
 
+void SettingsManager::InvalidateThemeCache() {
+  theme_cache_.clear();
+}
+
 float SettingsManager::GetDpi() {
   float dpi = settings_.dpi();
   return dpi > 0 ? dpi : kDefaultDpi;
@@ -376,6 +386,11 @@ void SettingsManager::MarkDirty() {
 }
 
 bool SettingsManager::MaybeFlushToDisk(const std::string& scenario_id) {
+  // The writer already retried a failed write a few times. Once it gives up, the current settings
+  // are submitted again on the next call.
+  if (settings_writer_.TakeWriteFailed()) {
+    needs_save_ = true;
+  }
   if (needs_save_) {
     FlushToDisk(scenario_id);
     return true;
@@ -400,9 +415,8 @@ void SettingsManager::WriteScenarioSettings(const std::string& scenario_id) {
 
 void SettingsManager::FlushToDisk(const std::string& scenario_id) {
   WriteScenarioSettings(scenario_id);
-  if (WriteJsonMessageToFile(settings_path_, settings_)) {
-    needs_save_ = false;
-  }
+  settings_writer_.Submit(settings_);
+  needs_save_ = false;
 }
 
 SettingsUpdater::SettingsUpdater(SettingsManager* settings_manager, HistoryManager* history_manager)
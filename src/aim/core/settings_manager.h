@@ -11,6 +11,7 @@
 #include "aim/common/simple_types.h"
 #include "aim/common/times.h"
 #include "aim/core/history_manager.h"
+#include "aim/core/settings_writer.h"
 #include "aim/database/settings_db.h"
 #include "aim/proto/settings.pb.h"
 #include "aim/proto/theme.pb.h"
@@ -79,11 +80,18 @@ class SettingsManager {
   Crosshair GetCurrentCrosshair();
 
   void MarkDirty();
+  // Saves the scenario's settings and queues the settings file to be written in the background,
+  // so this is cheap enough to call mid-scenario.
   void FlushToDisk(const std::string& scenario_id);
-  // Only flush to disk if marked dirty.
+  // Only flush to disk if marked dirty or the last background write failed.
   bool MaybeFlushToDisk(const std::string& scenario_id);
 
   void MaybeInvalidateThemeCache();
+  void InvalidateThemeCache();
+
+  const std::filesystem::path& theme_dir() const {
+    return theme_dir_;
+  }
 
   SettingsUpdater CreateUpdater();
 
@@ -94,6 +102,7 @@ class SettingsManager {
   std::filesystem::path settings_path_;
   Settings settings_;
   bool needs_save_ = false;
+  SettingsWriter settings_writer_;
   std::filesystem::path theme_dir_;
   std::filesystem::path texture_dir_;
   std::unordered_map<std::string, ThemeCacheEntry> theme_cache_;
@@ -0,0 +1,103 @@
+#include "settings_writer.h"
+
+#include <utility>
+
+#include "aim/common/files.h"
+
+namespace aim {
+namespace {
+
+// How long settings must stay unchanged before they are written.
+constexpr std::chrono::milliseconds kWriteDelay(500);
+// A failed write is tried again after this long, e.g. once a virus scanner lets go of the file.
+constexpr std::chrono::milliseconds kRetryDelay(5000);
+// Attempts per settings before the failure is reported.
+constexpr int kMaxWriteAttempts = 3;
+
+}  // namespace
+
+SettingsWriter::SettingsWriter(const std::filesystem::path& settings_path)
+    : settings_path_(settings_path) {}
+
+SettingsWriter::~SettingsWriter() {
+  // Skips the delay of a queued write. The queue finishes it before joining.
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    flush_requested_ = true;
+  }
+  delay_cv_.notify_one();
+}
+
+void SettingsWriter::Submit(const Settings& settings) {
+  bool needs_write = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_settings_ = settings;
+    write_time_ = std::chrono::steady_clock::now() + kWriteDelay;
+    needs_write = !std::exchange(is_write_queued_, true);
+  }
+  delay_cv_.notify_one();
+  if (needs_write) {
+    queue_.Submit([this] { WritePending(); });
+  }
+}
+
+bool SettingsWriter::Flush() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    flush_requested_ = true;
+  }
+  delay_cv_.notify_one();
+  queue_.WaitForIdle();
+  std::lock_guard<std::mutex> lock(mutex_);
+  flush_requested_ = false;
+  return !std::exchange(last_write_failed_, false);
+}
+
+bool SettingsWriter::TakeWriteFailed() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return std::exchange(last_write_failed_, false);
+}
+
+void SettingsWriter::WritePending() {
+  Settings settings;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // Each submit pushes the write back, so a burst of changes is written once at the end.
+    while (!flush_requested_ && std::chrono::steady_clock::now() < write_time_) {
+      delay_cv_.wait_until(lock, write_time_);
+    }
+    settings = std::move(*pending_settings_);
+    pending_settings_.reset();
+    is_write_queued_ = false;
+  }
+  bool ok = WriteJsonMessageToFileDurably(settings_path_, settings);
+  bool needs_retry = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ok) {
+      num_failed_attempts_ = 0;
+      last_write_failed_ = false;
+      return;
+    }
+    ++num_failed_attempts_;
+    if (pending_settings_) {
+      // Newer settings are already queued and replace these.
+      return;
+    }
+    if (num_failed_attempts_ < kMaxWriteAttempts) {
+      pending_settings_ = std::move(settings);
+      write_time_ = std::chrono::steady_clock::now() + kRetryDelay;
+      is_write_queued_ = true;
+      needs_retry = true;
+    } else {
+      num_failed_attempts_ = 0;
+      last_write_failed_ = true;
+    }
+  }
+  if (needs_retry) {
+    queue_.Submit([this] { WritePending(); });
+  }
+}
+
+}  // namespace aim
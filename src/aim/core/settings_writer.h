@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+
+#include "aim/common/simple_types.h"
+#include "aim/common/task_queue.h"
+#include "aim/proto/settings.pb.h"
+
+namespace aim {
+
+// Writes the settings file on a background thread so saving never blocks the caller. Settings
+// submitted in quick succession, like while dragging the crosshair size, are coalesced and only
+// the latest are written once changes stop for a moment.
+//
+// A failed write is tried again a few seconds later, or right away while flushing, for up to
+// three attempts. Only once every attempt failed is the failure reported by Flush() and
+// TakeWriteFailed().
+class SettingsWriter {
+ public:
+  explicit SettingsWriter(const std::filesystem::path& settings_path);
+  // Writes any settings still pending before returning.
+  ~SettingsWriter();
+  AIM_NO_COPY(SettingsWriter);
+
+  // Replaces any settings which have not been written yet.
+  void Submit(const Settings& settings);
+
+  // Blocks until the last submitted settings have been written, skipping the write and retry
+  // delays. Returns false if every attempt to write them failed.
+  bool Flush();
+
+  // Returns true once after every attempt to write the latest settings failed, so the caller can
+  // submit them again later.
+  bool TakeWriteFailed();
+
+ private:
+  // Waits out the write delay and then writes the latest pending settings, queueing a retry if
+  // that fails.
+  void WritePending();
+
+  std::filesystem::path settings_path_;
+  std::mutex mutex_;
+  // Wakes a write waiting out its delay.
+  std::condition_variable delay_cv_;
+  std::optional<Settings> pending_settings_;
+  std::chrono::steady_clock::time_point write_time_;
+  bool is_write_queued_ = false;
+  bool flush_requested_ = false;
+  int num_failed_attempts_ = 0;
+  bool last_write_failed_ = false;
+  // Declared last so it finishes before the state it uses is destroyed.
+  TaskQueue queue_;
+};
+
+}  // namespace aim
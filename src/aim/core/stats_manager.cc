@@ -1,8 +1,15 @@
 #include "stats_manager.h"
 
+#include <algorithm>
+#include <chrono>
+#include <fstream>
 #include <glm/ext/scalar_common.hpp>
+#include <functional>
 #include <memory>
+#include <utility>
 
+#include "aim/common/log.h"
+#include "aim/common/times.h"
 #include "aim/common/util.h"
 
 namespace aim {
@@ -25,26 +32,229 @@ float GetScoreLevel(float score, float start_score, float end_score) {
   return glm::clamp<float>(num_levels * percent, 0, num_levels + 0.99);
 }
 
+bool HasDefaultTrackingScoreLevels(const ScenarioDef& def) {
+  return def.has_centering_def() || def.has_wall_arc_def() ||
+         def.shot_type().type_case() == ShotType::kTrackingInvincible;
+}
+
+void AddRunToAggregate(const StatsRow& row, AggregateScenarioStats* stats) {
+  if (stats->total_runs == 0 || row.score >= stats->high_score_stats.score) {
+    stats->high_score_stats = row;
+  }
+  if (row.stats_id >= stats->last_run_stats.stats_id) {
+    stats->last_run_stats = row;
+  }
+  stats->total_runs++;
+  stats->score_sum += row.score;
+  stats->score_sum_squares += row.score * row.score;
+}
+
+std::optional<i64> ExportStatsToFile(StatsDb* db, const std::filesystem::path& path) {
+  auto format = GetStatsFileFormat(path);
+  if (!format) {
+    Logger::get()->warn("Unknown stats file type {}", path.string());
+    return {};
+  }
+  std::ofstream out(path, std::ios::trunc);
+  if (!out.is_open()) {
+    Logger::get()->warn("Unable to write {}", path.string());
+    return {};
+  }
+  Stopwatch stopwatch;
+  stopwatch.Start();
+  i64 num_written = ExportStats(db, *format, &out);
+  out.close();
+  if (out.fail()) {
+    Logger::get()->warn("Unable to write {}", path.string());
+    return {};
+  }
+  Logger::get()->info("Exported {} runs to {} in {}ms",
+                      num_written,
+                      path.string(),
+                      stopwatch.GetElapsedMicros() / 1000);
+  return num_written;
+}
+
+std::optional<StatsImportResult> ImportStatsFromFile(StatsDb* db,
+                                                     const std::filesystem::path& path,
+                                                     const std::function<i64()>& next_stats_id) {
+  auto format = GetStatsFileFormat(path);
+  if (!format) {
+    Logger::get()->warn("Unknown stats file type {}", path.string());
+    return {};
+  }
+  std::ifstream in(path);
+  if (!in.is_open()) {
+    Logger::get()->warn("Unable to read {}", path.string());
+    return {};
+  }
+  Stopwatch stopwatch;
+  stopwatch.Start();
+  auto result = ImportStats(db, *format, &in, next_stats_id);
+  if (result) {
+    Logger::get()->info("Imported {} runs from {} in {}ms, skipped {}",
+                        result->num_imported,
+                        path.string(),
+                        stopwatch.GetElapsedMicros() / 1000,
+                        result->num_skipped);
+  }
+  return result;
+}
+
 }  // namespace
 
-StatsManager::StatsManager(FileSystem* fs)
-    : stats_db_(std::make_unique<StatsDb>(fs->GetUserDataPath("stats.db"))) {}
+StatsManager::StatsManager(FileSystem* fs, Database* database)
+    : stats_db_(std::make_unique<StatsDb>(database)),
+      writer_(std::make_unique<StatsWriter>(fs->GetUserDataPath("stats.db"))),
+      loader_(std::make_unique<StatsWriter>(fs->GetUserDataPath("stats.db"))) {
+  next_stats_id_ = stats_db_->GetMaxStatsId() + 1;
+}
 
-void StatsManager::AddStats(const std::string& scenario_id, StatsRow* row) {
-  stats_db_->AddStats(scenario_id, row);
-  stats_cache_.erase(scenario_id);
+std::shared_future<i64> StatsManager::AddStats(const std::string& scenario_id,
+                                               StatsRow* row,
+                                               std::optional<RunMetricsRow> metrics) {
+  if (row->timestamp.size() == 0) {
+    row->timestamp = GetNowString();
+  }
+  // Ids are handed out here rather than by the writer so callers can use them immediately.
+  row->stats_id = next_stats_id_++;
+
+  auto promise = std::make_shared<std::promise<i64>>();
+  std::shared_future<i64> committed = promise->get_future().share();
+  pending_stats_.push_back({scenario_id, *row, committed});
+  auto it = stats_cache_.find(scenario_id);
+  if (it != stats_cache_.end()) {
+    AddRunToAggregate(*row, &it->second);
+  }
+  auto tree_it = score_trees_.find(scenario_id);
+  if (tree_it != score_trees_.end()) {
+    tree_it->second.Insert(row->score);
+  }
+
+  writer_->Submit([scenario_id, row = *row, metrics = std::move(metrics), promise](
+                      StatsDb* db) mutable {
+    bool added = db->AddStats(scenario_id, &row, metrics ? &*metrics : nullptr);
+    promise->set_value(added ? row.stats_id : 0);
+  });
+  return committed;
+}
+
+void StatsManager::WaitForPendingWrites() {
+  writer_->Flush();
+  ClearCommittedPendingStats();
+}
+
+void StatsManager::ClearCommittedPendingStats() {
+  MergeFinishedStatsTransfer();
+  DropFailedPendingStats();
+  // A prefetch may have read the db before a pending row committed, so keep the rows around until
+  // every prefetch has been merged.
+  if (loading_scenario_ids_.size() > 0) {
+    return;
+  }
+  std::erase_if(pending_stats_, [](const PendingStats& pending) {
+    return pending.committed.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+  });
+}
+
+void StatsManager::DropFailedPendingStats() {
+  // The row was counted in the cached aggregate and rank tree as soon as it was added, so take it
+  // back out now that it will never reach the db.
+  auto failed = [](const PendingStats& pending) {
+    return pending.committed.wait_for(std::chrono::seconds(0)) == std::future_status::ready &&
+           pending.committed.get() == 0;
+  };
+  for (const PendingStats& pending : pending_stats_) {
+    if (!failed(pending)) {
+      continue;
+    }
+    InvalidateAggregateStats(pending.scenario_id);
+    auto tree_it = score_trees_.find(pending.scenario_id);
+    if (tree_it != score_trees_.end()) {
+      tree_it->second.Erase(pending.row.score);
+    }
+  }
+  std::erase_if(pending_stats_, failed);
 }
 
 std::vector<StatsRow> StatsManager::GetStats(const std::string& scenario_id) {
-  // TODO: Cache at this layer?
-  return stats_db_->GetStats(scenario_id);
+  // Anything committed before the query is guaranteed to be in the results. Rows which are still
+  // pending may or may not be, so merge them in by id.
+  ClearCommittedPendingStats();
+  std::vector<StatsRow> all_stats = stats_db_->GetStats(scenario_id);
+  for (const PendingStats& pending : pending_stats_) {
+    if (pending.scenario_id != scenario_id) {
+      continue;
+    }
+    bool found = std::any_of(all_stats.begin(), all_stats.end(), [&](const StatsRow& row) {
+      return row.stats_id == pending.row.stats_id;
+    });
+    if (!found) {
+      all_stats.push_back(pending.row);
+    }
+  }
+  return all_stats;
 }
 
 i64 StatsManager::GetLatestRunId(const std::string& scenario_id) {
-  return stats_db_->GetLatestRunId(scenario_id);
+  i64 run_id = stats_db_->GetLatestRunId(scenario_id);
+  for (const PendingStats& pending : pending_stats_) {
+    if (pending.scenario_id == scenario_id) {
+      run_id = std::max(run_id, pending.row.stats_id);
+    }
+  }
+  return run_id;
+}
+
+std::optional<StatsRow> StatsManager::GetStatsRow(const std::string& scenario_id, i64 stats_id) {
+  for (const PendingStats& pending : pending_stats_) {
+    if (pending.scenario_id == scenario_id && pending.row.stats_id == stats_id) {
+      return pending.row;
+    }
+  }
+  return stats_db_->GetStatsRow(scenario_id, stats_id);
+}
+
+std::optional<StatsRow> StatsManager::GetHighScoreBefore(const std::string& scenario_id,
+                                                         i64 stats_id) {
+  ClearCommittedPendingStats();
+  std::optional<StatsRow> high_score = stats_db_->GetHighScoreBefore(scenario_id, stats_id);
+  for (const PendingStats& pending : pending_stats_) {
+    if (pending.scenario_id == scenario_id && pending.row.stats_id < stats_id &&
+        (!high_score || pending.row.score >= high_score->score)) {
+      high_score = pending.row;
+    }
+  }
+  return high_score;
+}
+
+ScoreHistory StatsManager::GetScoreHistory(const ScoreHistoryQuery& query, int max_points) {
+  ClearCommittedPendingStats();
+  ScoreHistory history = stats_db_->GetScoreHistory(query, max_points);
+  i64 last_stats_id = history.points.size() > 0 ? history.points.back().stats_id : 0;
+  for (const PendingStats& pending : pending_stats_) {
+    const StatsRow& row = pending.row;
+    if (pending.scenario_id != query.scenario_id || row.stats_id <= last_stats_id ||
+        row.stats_id < query.min_stats_id || row.stats_id > query.max_stats_id) {
+      continue;
+    }
+    ScoreHistoryPoint point;
+    point.stats_id = row.stats_id;
+    point.timestamp_micros = ParseTimestampStringAsMicros(row.timestamp).value_or(0);
+    if (point.timestamp_micros < query.min_timestamp_micros ||
+        point.timestamp_micros > query.max_timestamp_micros) {
+      continue;
+    }
+    point.score = row.score;
+    point.index = history.num_runs++;
+    ++history.num_runs_in_bounds;
+    history.points.push_back(point);
+  }
+  return history;
 }
 
 AggregateScenarioStats StatsManager::GetAggregateStats(const std::string& scenario_id) {
+  MergeLoadedAggregateStats();
   auto it = stats_cache_.find(scenario_id);
   if (it != stats_cache_.end()) {
     return it->second;
@@ -54,35 +264,145 @@ AggregateScenarioStats StatsManager::GetAggregateStats(const std::string& scenar
   return stats;
 }
 
+ScoreRank StatsManager::GetScoreRank(const std::string& scenario_id, double score) {
+  OrderStatisticsTree* tree = GetScoreTree(scenario_id);
+  ScoreRank rank;
+  rank.num_runs = tree->size();
+  rank.rank = tree->CountGreater(score) + 1;
+  if (rank.num_runs > 0) {
+    rank.top_percent = 100.0 * (rank.num_runs - tree->CountLess(score)) / rank.num_runs;
+  }
+  return rank;
+}
+
+OrderStatisticsTree* StatsManager::GetScoreTree(const std::string& scenario_id) {
+  auto it = score_trees_.find(scenario_id);
+  if (it != score_trees_.end()) {
+    return &it->second;
+  }
+  Stopwatch stopwatch;
+  stopwatch.Start();
+  ClearCommittedPendingStats();
+  i64 max_stats_id = 0;
+  std::vector<double> scores = stats_db_->GetScores(scenario_id, &max_stats_id);
+  OrderStatisticsTree& tree = score_trees_[scenario_id];
+  tree.Reserve(scores.size() + pending_stats_.size());
+  for (double score : scores) {
+    tree.Insert(score);
+  }
+  for (const PendingStats& pending : pending_stats_) {
+    if (pending.scenario_id == scenario_id && pending.row.stats_id > max_stats_id) {
+      tree.Insert(pending.row.score);
+    }
+  }
+  Logger::get()->info("Loaded {} scores for {} in {}ms",
+                      tree.size(),
+                      scenario_id,
+                      stopwatch.GetElapsedMicros() / 1000);
+  return &tree;
+}
+
+std::optional<AggregateScenarioStats> StatsManager::GetCachedAggregateStats(
+    const std::string& scenario_id) {
+  MergeLoadedAggregateStats();
+  auto it = stats_cache_.find(scenario_id);
+  if (it != stats_cache_.end()) {
+    return it->second;
+  }
+  PrefetchAggregateStats({scenario_id});
+  return {};
+}
+
+void StatsManager::PrefetchAggregateStats(const std::vector<std::string>& scenario_ids) {
+  std::vector<std::string> missing_ids;
+  for (const std::string& scenario_id : scenario_ids) {
+    if (!stats_cache_.contains(scenario_id) && loading_scenario_ids_.insert(scenario_id).second) {
+      missing_ids.push_back(scenario_id);
+    }
+  }
+  if (missing_ids.size() == 0) {
+    return;
+  }
+  loader_->Submit(
+      [this, ids = std::move(missing_ids), generation = cache_generation_](StatsDb* db) {
+        Stopwatch stopwatch;
+        stopwatch.Start();
+        std::vector<ScenarioAggregateRow> aggregates = db->GetAggregateStats(ids);
+        {
+          std::lock_guard<std::mutex> lock(loaded_mutex_);
+          for (int i = 0; i < ids.size(); ++i) {
+            loaded_aggregates_.push_back({ids[i], generation, std::move(aggregates[i])});
+          }
+        }
+        Logger::get()->info("Prefetched aggregate stats for {} scenarios in {}ms",
+                            ids.size(),
+                            stopwatch.GetElapsedMicros() / 1000);
+      });
+}
+
+void StatsManager::MergeLoadedAggregateStats() {
+  MergeFinishedStatsTransfer();
+  std::vector<LoadedAggregate> loaded;
+  {
+    std::lock_guard<std::mutex> lock(loaded_mutex_);
+    loaded.swap(loaded_aggregates_);
+  }
+  for (const LoadedAggregate& aggregate : loaded) {
+    loading_scenario_ids_.erase(aggregate.scenario_id);
+    if (aggregate.cache_generation == cache_generation_) {
+      stats_cache_[aggregate.scenario_id] = ToAggregateStats(aggregate.scenario_id, aggregate.row);
+    }
+  }
+}
+
+void StatsManager::InvalidateAggregateStats(const std::string& scenario_id) {
+  stats_cache_.erase(scenario_id);
+  loading_scenario_ids_.erase(scenario_id);
+  ++cache_generation_;
+}
+
+void StatsManager::InvalidateAllStats() {
+  stats_cache_.clear();
+  loading_scenario_ids_.clear();
+  score_trees_.clear();
+  ++cache_generation_;
+}
+
 AggregateScenarioStats StatsManager::GetAggregateStatsFromDb(const std::string& scenario_id) {
-  std::vector<StatsRow> all_stats = GetStats(scenario_id);
+  ClearCommittedPendingStats();
+  return ToAggregateStats(scenario_id, stats_db_->GetAggregateStats(scenario_id));
+}
 
+AggregateScenarioStats StatsManager::ToAggregateStats(const std::string& scenario_id,
+                                                      const ScenarioAggregateRow& aggregate) {
   AggregateScenarioStats info;
-  info.total_runs = all_stats.size();
-  if (all_stats.size() == 0) {
-    return info;
-  }
-
-  info.last_run_stats = all_stats.back();
-  int found_max_index = 0;
-  float max_score = -100000;
-  for (int i = 0; i < all_stats.size(); ++i) {
-    StatsRow& stats = all_stats[i];
-    if (stats.score >= max_score) {
-      found_max_index = i;
-      max_score = stats.score;
+  info.total_runs = aggregate.num_runs;
+  if (aggregate.num_runs > 0) {
+    info.high_score_stats = aggregate.best_stats;
+    info.last_run_stats = aggregate.last_stats;
+    info.score_sum = aggregate.score_sum;
+    info.score_sum_squares = aggregate.score_sum_squares;
+  }
+  // Pending rows have higher ids than anything committed, so any row past the last committed run
+  // is not in the aggregate yet.
+  for (const PendingStats& pending : pending_stats_) {
+    if (pending.scenario_id == scenario_id &&
+        pending.row.stats_id > info.last_run_stats.stats_id) {
+      AddRunToAggregate(pending.row, &info);
     }
   }
-  info.high_score_stats = all_stats[found_max_index];
   return info;
 }
 
+bool HasScenarioScoreLevels(const ScenarioDef& def) {
+  return def.start_score() > 0 || HasDefaultTrackingScoreLevels(def);
+}
+
 float GetScenarioScoreLevel(float score, const ScenarioDef& def) {
   if (def.start_score() > 0) {
     return GetScoreLevel(score, def.start_score(), def.end_score());
   }
-  if (def.has_centering_def() || def.has_wall_arc_def() ||
-      def.shot_type().type_case() == ShotType::kTrackingInvincible) {
+  if (HasDefaultTrackingScoreLevels(def)) {
     // Default range to tracking from 40% to 75% of time.
     return GetScoreLevel(score, def.duration_seconds() * 0.399, def.duration_seconds() * 0.75);
   }
@@ -90,24 +410,131 @@ float GetScenarioScoreLevel(float score, const ScenarioDef& def) {
 }
 
 void StatsManager::DeleteAllStats(const std::string& scenario_id) {
+  WaitForPendingWrites();
   stats_db_->DeleteAllStats(scenario_id);
-  stats_cache_.erase(scenario_id);
+  InvalidateAggregateStats(scenario_id);
+  score_trees_.erase(scenario_id);
 }
 
-void StatsManager::CopyAllStats(const std::string& from_scenario_id,
+bool StatsManager::CopyAllStats(const std::string& from_scenario_id,
                                 const std::string& to_scenario_id) {
-  stats_db_->CopyAllStats(from_scenario_id, to_scenario_id);
+  WaitForPendingWrites();
+  bool copied = stats_db_->CopyAllStats(from_scenario_id, to_scenario_id);
+  InvalidateAggregateStats(to_scenario_id);
+  score_trees_.erase(to_scenario_id);
+  // The copies took ids past anything handed out so far.
+  next_stats_id_ = std::max(next_stats_id_.load(), stats_db_->GetMaxStatsId() + 1);
+  return copied;
 }
 
-void StatsManager::DeleteStats(const std::string& scenario_id, i64 run_id) {
-  stats_db_->DeleteStats(scenario_id, run_id);
+bool StatsManager::StartExportStats(const std::filesystem::path& path) {
+  if (is_transferring_stats_) {
+    return false;
+  }
+  is_transferring_stats_ = true;
+  writer_->Submit([this, path](StatsDb* db) {
+    StatsTransferResult result;
+    result.num_exported = ExportStatsToFile(db, path);
+    std::lock_guard<std::mutex> lock(finished_transfer_mutex_);
+    finished_transfer_ = std::move(result);
+  });
+  return true;
 }
 
-void StatsManager::RenameScenario(const std::string& old_scenario_id,
+bool StatsManager::StartImportStats(const std::filesystem::path& path) {
+  if (is_transferring_stats_) {
+    return false;
+  }
+  is_transferring_stats_ = true;
+  writer_->Submit([this, path](StatsDb* db) {
+    StatsTransferResult result;
+    result.is_import = true;
+    result.import_result = ImportStatsFromFile(db, path, [this] { return next_stats_id_++; });
+    std::lock_guard<std::mutex> lock(finished_transfer_mutex_);
+    finished_transfer_ = std::move(result);
+  });
+  return true;
+}
+
+std::optional<StatsTransferResult> StatsManager::TakeStatsTransferResult() {
+  MergeFinishedStatsTransfer();
+  return std::exchange(transfer_result_, std::nullopt);
+}
+
+void StatsManager::MergeFinishedStatsTransfer() {
+  if (!is_transferring_stats_) {
+    return;
+  }
+  std::optional<StatsTransferResult> finished;
+  {
+    std::lock_guard<std::mutex> lock(finished_transfer_mutex_);
+    finished.swap(finished_transfer_);
+  }
+  if (!finished) {
+    return;
+  }
+  is_transferring_stats_ = false;
+  if (finished->is_import) {
+    InvalidateAllStats();
+  }
+  transfer_result_ = std::move(finished);
+}
+
+bool StatsManager::DeleteStats(const std::string& scenario_id, i64 run_id) {
+  WaitForPendingWrites();
+  std::optional<StatsRow> row = stats_db_->GetStatsRow(scenario_id, run_id);
+  if (!row || !stats_db_->DeleteStats(scenario_id, run_id)) {
+    return false;
+  }
+  InvalidateAggregateStats(scenario_id);
+  auto tree_it = score_trees_.find(scenario_id);
+  if (tree_it != score_trees_.end()) {
+    tree_it->second.Erase(row->score);
+  }
+  return true;
+}
+
+bool StatsManager::RenameScenario(const std::string& old_scenario_id,
                                   const std::string& new_scenario_id) {
-  stats_db_->RenameScenario(old_scenario_id, new_scenario_id);
-  stats_cache_.erase(old_scenario_id);
-  stats_cache_.erase(new_scenario_id);
+  WaitForPendingWrites();
+  InvalidateAggregateStats(old_scenario_id);
+  InvalidateAggregateStats(new_scenario_id);
+  score_trees_.erase(old_scenario_id);
+  score_trees_.erase(new_scenario_id);
+  return stats_db_->RenameScenario(old_scenario_id, new_scenario_id);
+}
+
+void StatsManager::AddRunAnalyses(const std::vector<RunAnalysisRow>& rows) {
+  stats_db_->AddRunAnalyses(rows);
+}
+
+std::vector<RunAnalysisRow> StatsManager::GetRunAnalyses(const std::string& scenario_id) {
+  return stats_db_->GetRunAnalyses(scenario_id);
+}
+
+std::vector<i64> StatsManager::GetAnalyzedRunIds() {
+  return stats_db_->GetAnalyzedRunIds();
+}
+
+std::future<std::vector<i64>> StatsManager::LoadAnalyzedRunIds() {
+  auto promise = std::make_shared<std::promise<std::vector<i64>>>();
+  std::future<std::vector<i64>> run_ids = promise->get_future();
+  loader_->Submit([promise](StatsDb* db) { promise->set_value(db->GetAnalyzedRunIds()); });
+  return run_ids;
+}
+
+std::optional<RunMetricsRow> StatsManager::GetRunMetrics(i64 stats_id) {
+  return stats_db_->GetRunMetrics(stats_id);
+}
+
+std::vector<RunMetricsSummary> StatsManager::GetRunMetricsTrend(const std::string& scenario_id,
+                                                                int max_runs) {
+  return stats_db_->GetRunMetricsTrend(scenario_id, max_runs);
+}
+
+std::optional<RunMetricsSummary> StatsManager::GetRunMetricsAverages(
+    const std::string& scenario_id, int num_runs, int skip_runs) {
+  return stats_db_->GetRunMetricsAverages(scenario_id, num_runs, skip_runs);
 }
 
 }  // namespace aim
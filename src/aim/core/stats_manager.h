@@ -1,51 +1,199 @@
 #pragma once
 
+#include <atomic>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "aim/common/order_statistics.h"
 #include "aim/common/simple_types.h"
 #include "aim/core/file_system.h"
+#include "aim/database/database.h"
 #include "aim/database/stats_db.h"
+#include "aim/database/stats_io.h"
+#include "aim/database/stats_writer.h"
 #include "aim/proto/scenario.pb.h"
 
 namespace aim {
 
 float GetScenarioScoreLevel(float score, const ScenarioDef& def);
 
+// Whether GetScenarioScoreLevel returns levels for this scenario.
+bool HasScenarioScoreLevels(const ScenarioDef& def);
+
 struct AggregateScenarioStats {
   StatsRow high_score_stats;
   StatsRow last_run_stats;
-  int total_runs;
+  int total_runs = 0;
+  double score_sum = 0;
+  double score_sum_squares = 0;
+};
+
+struct ScoreRank {
+  // 1 is the best. Runs with equal scores share a rank.
+  i64 rank = 0;
+  i64 num_runs = 0;
+  // Percent of runs scoring at least as well, e.g. 3 for "top 3%".
+  double top_percent = 0;
 };
 
+// Outcome of an export or import started with StartExportStats or StartImportStats.
+struct StatsTransferResult {
+  bool is_import = false;
+  // Runs written by an export. Unset if the export failed.
+  std::optional<i64> num_exported;
+  // Unset if the import failed.
+  std::optional<StatsImportResult> import_result;
+};
+
+// Must be used from a single thread. Aggregate stats can be prefetched on a background thread with
+// its own connection; finished loads are handed back under a lock and merged into the cache the
+// next time the aggregates are read.
 class StatsManager {
  public:
-  explicit StatsManager(FileSystem* fs);
+  StatsManager(FileSystem* fs, Database* database);
   AIM_NO_COPY(StatsManager);
 
-  void AddStats(const std::string& scenario_id, StatsRow* row);
+  // Assigns row->stats_id right away and commits the row on the background writer. The future
+  // resolves to the stats id once the row is committed, or 0 if the write failed. Reads made
+  // before then still include the row. metrics is committed together with the row.
+  std::shared_future<i64> AddStats(const std::string& scenario_id,
+                                   StatsRow* row,
+                                   std::optional<RunMetricsRow> metrics = {});
+
+  // Blocks until every queued write has been committed.
+  void WaitForPendingWrites();
 
   std::vector<StatsRow> GetStats(const std::string& scenario_id);
 
   i64 GetLatestRunId(const std::string& scenario_id);
 
+  std::optional<StatsRow> GetStatsRow(const std::string& scenario_id, i64 stats_id);
+
+  // Best run before stats_id, e.g. the high score a run was trying to beat.
+  std::optional<StatsRow> GetHighScoreBefore(const std::string& scenario_id, i64 stats_id);
+
+  // Downsampled scores for charting. Runs which are still being written are appended after the
+  // downsampled points.
+  ScoreHistory GetScoreHistory(const ScoreHistoryQuery& query, int max_points);
+
+  // Reads from the db if the aggregate is not cached yet.
   AggregateScenarioStats GetAggregateStats(const std::string& scenario_id);
 
+  // Rank of score among every run of the scenario. The scores are loaded into an order statistics
+  // tree on first use and kept up to date as runs are added or deleted, so later calls are
+  // O(log n).
+  ScoreRank GetScoreRank(const std::string& scenario_id, double score);
+
+  // Never touches the db. Returns nothing and starts a prefetch if the aggregate is not loaded yet
+  // so callers can draw a placeholder.
+  std::optional<AggregateScenarioStats> GetCachedAggregateStats(const std::string& scenario_id);
+
+  // Loads the aggregates for every scenario which is not cached or loading yet in one read
+  // transaction on the prefetch thread.
+  void PrefetchAggregateStats(const std::vector<std::string>& scenario_ids);
+
   void DeleteAllStats(const std::string& scenario_id);
 
-  void CopyAllStats(const std::string& from_scenario_id, const std::string& to_scenario_id);
+  bool CopyAllStats(const std::string& from_scenario_id, const std::string& to_scenario_id);
 
-  void DeleteStats(const std::string& scenario_id, i64 run_id);
+  // Exports and imports run on the writer thread, which has its own connection, after every write
+  // queued before them. The format is picked from the extension, see GetStatsFileFormat. Returns
+  // false without starting if an export or import is already running.
+  bool StartExportStats(const std::filesystem::path& path);
 
-  void RenameScenario(const std::string& old_scenario_id, const std::string& new_scenario_id);
+  // Adds every run in the file with new ids. The new ids are above every local run, but recent runs
+  // are ordered by timestamp, so imported runs still show up by when they were played.
+  bool StartImportStats(const std::filesystem::path& path);
+
+  bool is_transferring_stats() const {
+    return is_transferring_stats_;
+  }
+
+  // Returns the outcome once the running export or import finished, and nothing before then.
+  std::optional<StatsTransferResult> TakeStatsTransferResult();
+
+  bool DeleteStats(const std::string& scenario_id, i64 run_id);
+
+  // Waits for pending writes first, so when this is part of a larger transaction call
+  // WaitForPendingWrites() before the transaction starts.
+  bool RenameScenario(const std::string& old_scenario_id, const std::string& new_scenario_id);
+
+  void AddRunAnalyses(const std::vector<RunAnalysisRow>& rows);
+
+  std::vector<RunAnalysisRow> GetRunAnalyses(const std::string& scenario_id);
+
+  // Ids of every run with an analysis, including ones whose replay could not be analyzed.
+  std::vector<i64> GetAnalyzedRunIds();
+  // Same as GetAnalyzedRunIds but read on the prefetch loader, so it can be waited on from a
+  // worker thread.
+  std::future<std::vector<i64>> LoadAnalyzedRunIds();
+
+  // Metrics for runs which are still being written are not included.
+  std::optional<RunMetricsRow> GetRunMetrics(i64 stats_id);
+
+  std::vector<RunMetricsSummary> GetRunMetricsTrend(const std::string& scenario_id, int max_runs);
+
+  std::optional<RunMetricsSummary> GetRunMetricsAverages(const std::string& scenario_id,
+                                                         int num_runs,
+                                                         int skip_runs);
 
  private:
+  struct PendingStats {
+    std::string scenario_id;
+    StatsRow row;
+    std::shared_future<i64> committed;
+  };
+
+  struct LoadedAggregate {
+    std::string scenario_id;
+    u64 cache_generation = 0;
+    ScenarioAggregateRow row;
+  };
+
   AggregateScenarioStats GetAggregateStatsFromDb(const std::string& scenario_id);
+  // Moves finished prefetches into stats_cache_, dropping any which started before the cache was
+  // last invalidated.
+  void MergeLoadedAggregateStats();
+  void InvalidateAggregateStats(const std::string& scenario_id);
+  // Drops every cached aggregate and rank tree after a bulk change.
+  void InvalidateAllStats();
+  OrderStatisticsTree* GetScoreTree(const std::string& scenario_id);
+  // Merges in rows which are still pending.
+  AggregateScenarioStats ToAggregateStats(const std::string& scenario_id,
+                                          const ScenarioAggregateRow& aggregate);
+  void ClearCommittedPendingStats();
+  // Removes rows whose write failed, undoing their effect on the cached aggregate and rank tree.
+  void DropFailedPendingStats();
+  // Picks up a finished export or import, dropping every cached aggregate after an import.
+  void MergeFinishedStatsTransfer();
 
   std::unique_ptr<StatsDb> stats_db_;
+  // Imports on the writer thread take ids from here too, so they never collide with runs added
+  // while the import is running.
+  std::atomic<i64> next_stats_id_ = 1;
+  bool is_transferring_stats_ = false;
+  std::optional<StatsTransferResult> transfer_result_;
+  std::mutex finished_transfer_mutex_;
+  std::optional<StatsTransferResult> finished_transfer_;
+  // Declared after the state its tasks use so it finishes them before that state is destroyed.
+  std::unique_ptr<StatsWriter> writer_;
+  std::vector<PendingStats> pending_stats_;
   std::unordered_map<std::string, AggregateScenarioStats> stats_cache_;
+  std::unordered_set<std::string> loading_scenario_ids_;
+  u64 cache_generation_ = 0;
+  std::unordered_map<std::string, OrderStatisticsTree> score_trees_;
+
+  std::mutex loaded_mutex_;
+  std::vector<LoadedAggregate> loaded_aggregates_;
+  // Declared last so the prefetch thread stops before the state it writes to is destroyed.
+  std::unique_ptr<StatsWriter> loader_;
 };
 
 }  // namespace aim
@@ -0,0 +1,142 @@
+#include "database.h"
+
+#include <algorithm>
+#include <cctype>
+#include <format>
+#include <thread>
+
+#include "aim/common/log.h"
+#include "aim/common/times.h"
+
+namespace aim {
+namespace {
+
+const char* kAttachSql = "ATTACH DATABASE ? AS ?;";
+
+bool MigrateFile(const DatabaseFile& file) {
+  sqlite3* db = nullptr;
+  std::string path = file.path.string();
+  if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+    Logger::get()->warn("Cannot open {} db: {}", file.schema, sqlite3_errmsg(db));
+    sqlite3_close(db);
+    return false;
+  }
+  // journal_mode is stored in the file so setting it here also covers the shared connection.
+  ConfigureSqliteConnection(db);
+  bool ok = ApplySqliteMigrations(db, file.schema, file.migrations);
+  sqlite3_close(db);
+  return ok;
+}
+
+// Collapses the statement onto one line for logging.
+std::string GetOneLineSql(const char* sql) {
+  std::string result;
+  bool pending_space = false;
+  for (const char* c = sql; *c != '\0'; ++c) {
+    if (std::isspace(static_cast<unsigned char>(*c))) {
+      pending_space = result.size() > 0;
+      continue;
+    }
+    if (pending_space) {
+      result += ' ';
+      pending_space = false;
+    }
+    result += *c;
+  }
+  return result;
+}
+
+}  // namespace
+
+Database::Database() {
+  // The main schema is an empty in-memory db so every file is attached the same way.
+  if (sqlite3_open(":memory:", &db_) != SQLITE_OK) {
+    Logger::get()->error("Cannot open database: {}", sqlite3_errmsg(db_));
+    sqlite3_close(db_);
+    db_ = nullptr;
+    return;
+  }
+  ConfigureSqliteConnection(db_);
+  statements_ = std::make_unique<SqliteStatementCache>(db_);
+}
+
+Database::~Database() {
+  // Statements must be finalized before the connection can close.
+  statements_.reset();
+  if (db_ != nullptr) {
+    sqlite3_close(db_);
+  }
+}
+
+bool Database::Attach(const std::vector<DatabaseFile>& files) {
+  if (db_ == nullptr) {
+    return false;
+  }
+  Stopwatch stopwatch;
+  stopwatch.Start();
+
+  std::vector<char> migrated(files.size(), false);
+  std::vector<std::thread> threads;
+  threads.reserve(files.size());
+  for (int i = 0; i < files.size(); ++i) {
+    threads.emplace_back([&, i] { migrated[i] = MigrateFile(files[i]); });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  bool ok = true;
+  for (int i = 0; i < files.size(); ++i) {
+    const DatabaseFile& file = files[i];
+    if (!migrated[i]) {
+      ok = false;
+      continue;
+    }
+    SqliteStatement stmt = statements_->Get(kAttachSql);
+    if (!stmt) {
+      Logger::get()->warn("Failed to prepare statement: {}", sqlite3_errmsg(db_));
+      return false;
+    }
+    BindString(stmt, 1, file.path.string());
+    BindString(stmt, 2, file.schema);
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+      Logger::get()->warn("Cannot attach {} db: {}", file.schema, sqlite3_errmsg(db_));
+      ok = false;
+      continue;
+    }
+    ConfigureSqliteSchema(db_, file.schema);
+  }
+  Logger::get()->info(
+      "Opened {} databases in {}ms", files.size(), stopwatch.GetElapsedMicros() / 1000);
+  return ok;
+}
+
+bool Database::RunInTransaction(const std::function<bool()>& fn) {
+  SqliteTransaction transaction(db_);
+  if (!fn()) {
+    return false;
+  }
+  return transaction.Commit();
+}
+
+std::vector<SqliteStatementTimes> Database::GetQueryTimes() const {
+  std::vector<SqliteStatementTimes> times = statements_->GetTimes();
+  std::sort(times.begin(), times.end(), [](const auto& lhs, const auto& rhs) {
+    return lhs.total_micros > rhs.total_micros;
+  });
+  return times;
+}
+
+void Database::LogQueryTimes(int limit) const {
+  std::vector<SqliteStatementTimes> times = GetQueryTimes();
+  for (int i = 0; i < times.size() && i < limit; ++i) {
+    const SqliteStatementTimes& t = times[i];
+    Logger::get()->info("{} calls, {}us total, {}us max: {}",
+                        t.num_calls,
+                        t.total_micros,
+                        t.max_micros,
+                        GetOneLineSql(t.sql));
+  }
+}
+
+}  // namespace aim
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "aim/common/simple_types.h"
+#include "aim/database/sqlite_util.h"
+
+namespace aim {
+
+struct DatabaseFile {
+  // Name the file is attached as, e.g. "stats".
+  std::string schema;
+  std::filesystem::path path;
+  std::vector<SqliteMigration> migrations;
+};
+
+// A sqlite connection shared by the db classes on the main thread. Each file is attached under its
+// own schema name so queries can join across them and share one statement cache. Queries do not
+// qualify table names so table names must be unique across the attached files.
+//
+// Atomicity is per file. The files use WAL, and sqlite does not commit a WAL transaction across
+// several files atomically, so a crash during commit may leave only some of the files updated.
+//
+// Not thread safe. Code which writes from another thread, like the background stats writer,
+// opens its own Database on the same files.
+class Database {
+ public:
+  Database();
+  ~Database();
+  AIM_NO_COPY(Database);
+
+  // Migrates each file on its own connection in parallel and then attaches them in order. Returns
+  // false if any file could not be migrated or attached.
+  bool Attach(const std::vector<DatabaseFile>& files);
+
+  sqlite3* db() {
+    return db_;
+  }
+
+  SqliteStatementCache* statements() {
+    return statements_.get();
+  }
+
+  // Runs fn inside one transaction on this connection. If fn returns false everything it wrote is
+  // rolled back in every file. A successful commit is only atomic per file, see above. Db methods
+  // called from fn join the transaction.
+  bool RunInTransaction(const std::function<bool()>& fn);
+
+  // Timings for every prepared statement, slowest total time first.
+  std::vector<SqliteStatementTimes> GetQueryTimes() const;
+
+  void LogQueryTimes(int limit) const;
+
+ private:
+  sqlite3* db_ = nullptr;
+  std::unique_ptr<SqliteStatementCache> statements_;
+};
+
+}  // namespace aim
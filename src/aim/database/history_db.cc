@@ -1,15 +1,13 @@
 #include "history_db.h"
 
-#include <google/protobuf/json/json.h>
-#include <google/protobuf/util/json_util.h>
 #include <sqlite3.h>
 
-#include <format>
+#include <optional>
 #include <string>
 
 #include "aim/common/log.h"
 #include "aim/common/times.h"
-#include "aim/common/util.h"
+#include "aim/database/database.h"
 #include "aim/database/sqlite_util.h"
 
 namespace aim {
@@ -25,19 +23,43 @@ CREATE TABLE IF NOT EXISTS RecentViews (
 );
 )AIMS";
 
+// The text Timestamp column is no longer written. Views are ordered by TimestampMicros, which the
+// index serves directly for the most recent N of a type.
+const char* kAddRecentViewsTimestampMicros = R"AIMS(
+ALTER TABLE RecentViews ADD COLUMN TimestampMicros INTEGER;
+CREATE INDEX IF NOT EXISTS RecentViewsByTime ON RecentViews (Type, TimestampMicros DESC);
+)AIMS";
+
+const char* kGetRecentViewsMissingTimestampMicrosSql = R"AIMS(
+SELECT rowid, Timestamp FROM RecentViews WHERE TimestampMicros IS NULL;
+)AIMS";
+
+const char* kSetRecentViewTimestampMicrosSql = R"AIMS(
+UPDATE RecentViews SET TimestampMicros = ? WHERE rowid = ?;
+)AIMS";
+
+// The timestamp is kept strictly above the newest view of the type so two views in the same
+// microsecond, or after the clock moves back, still order by when they were recorded.
 const char* kInsertRecentViewsSql = R"AIMS(
-INSERT INTO RecentViews (Type, Id, Timestamp) VALUES (?, ?, ?)
-ON CONFLICT (Type, Id) DO UPDATE SET Timestamp = ?;
+INSERT INTO RecentViews (Type, Id, TimestampMicros)
+VALUES (?1, ?2, MAX(?3, COALESCE(
+    (SELECT MAX(TimestampMicros) FROM RecentViews WHERE Type = ?1), 0) + 1))
+ON CONFLICT (Type, Id) DO UPDATE SET TimestampMicros = excluded.TimestampMicros;
 )AIMS";
 
 const char* kGetRecentViewsForTypeSql = R"AIMS(
-SELECT Id, Timestamp
+SELECT Id, TimestampMicros
 FROM RecentViews
 WHERE Type = ?
-ORDER BY Timestamp DESC
+ORDER BY TimestampMicros DESC
 LIMIT ?;
 )AIMS";
 
+// A newer view already recorded for the new id is replaced.
+const char* kRenameRecentViewSql = R"AIMS(
+UPDATE OR REPLACE RecentViews SET Id = ? WHERE Type = ? AND Id = ?;
+)AIMS";
+
 std::string RecentViewTypeToString(RecentViewType t) {
   switch (t) {
     case RecentViewType::PLAYLIST:
@@ -52,52 +74,90 @@ std::string RecentViewTypeToString(RecentViewType t) {
   return "UnknownViewType";
 }
 
-}  // namespace
-
-HistoryDb::HistoryDb(const std::filesystem::path& db_path) {
-  char* err_msg = 0;
-  std::string db_path_str = db_path.string();
-  int rc = sqlite3_open(db_path_str.c_str(), &db_);
+bool BackfillRecentViewTimestampMicros(sqlite3* db) {
+  sqlite3_stmt* select_stmt;
+  if (sqlite3_prepare_v2(db, kGetRecentViewsMissingTimestampMicrosSql, -1, &select_stmt, nullptr) !=
+      SQLITE_OK) {
+    return false;
+  }
+  sqlite3_stmt* update_stmt;
+  if (sqlite3_prepare_v2(db, kSetRecentViewTimestampMicrosSql, -1, &update_stmt, nullptr) !=
+      SQLITE_OK) {
+    sqlite3_finalize(select_stmt);
+    return false;
+  }
 
-  if (rc != SQLITE_OK) {
-    Logger::get()->warn("Cannot open history db: {}", sqlite3_errmsg(db_));
-    sqlite3_close(db_);
-    db_ = nullptr;
+  bool ok = true;
+  while (ok && sqlite3_step(select_stmt) == SQLITE_ROW) {
+    i64 row_id = sqlite3_column_int64(select_stmt, 0);
+    const unsigned char* timestamp = sqlite3_column_text(select_stmt, 1);
+    std::optional<i64> micros;
+    if (timestamp != nullptr) {
+      micros = ParseTimestampStringAsMicros(reinterpret_cast<const char*>(timestamp));
+    }
+    // Unparseable views sort after every dated one rather than being lost.
+    sqlite3_bind_int64(update_stmt, 1, micros.value_or(0));
+    sqlite3_bind_int64(update_stmt, 2, row_id);
+    ok = sqlite3_step(update_stmt) == SQLITE_DONE;
+    sqlite3_reset(update_stmt);
   }
 
-  ExecuteSqliteQuery(db_, kCreateRecentViewsTable);
+  sqlite3_finalize(select_stmt);
+  sqlite3_finalize(update_stmt);
+  return ok;
 }
 
-HistoryDb::~HistoryDb() {
-  if (db_ != nullptr) {
-    sqlite3_close(db_);
-  }
+}  // namespace
+
+std::vector<SqliteMigration> GetHistoryMigrations() {
+  return {
+      {1, kCreateRecentViewsTable},
+      {2, kAddRecentViewsTimestampMicros, BackfillRecentViewTimestampMicros},
+  };
 }
 
+HistoryDb::HistoryDb(Database* database)
+    : db_(database->db()), statements_(database->statements()) {}
+
 void HistoryDb::UpdateRecentView(RecentViewType t, const std::string& id) {
-  sqlite3_stmt* stmt;
-  int rc = sqlite3_prepare_v2(db_, kInsertRecentViewsSql, -1, &stmt, nullptr);
-  if (rc != SQLITE_OK) {
+  SqliteStatement stmt = statements_->Get(kInsertRecentViewsSql);
+  if (!stmt) {
     Logger::get()->warn("Failed to prepare statement: {}", sqlite3_errmsg(db_));
     return;
   }
 
   std::string type_string = RecentViewTypeToString(t);
-  std::string timestamp = GetNowString();
-
   BindString(stmt, 1, type_string);
   BindString(stmt, 2, id);
-  BindString(stmt, 3, timestamp);
-  BindString(stmt, 4, timestamp);
+  sqlite3_bind_int64(stmt, 3, GetNowMicros());
 
-  rc = sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  if (sqlite3_step(stmt) != SQLITE_DONE) {
+    Logger::get()->warn("Failed to update recent view {}: {}", id, sqlite3_errmsg(db_));
+  }
+}
+
+bool HistoryDb::RenameRecentView(RecentViewType t,
+                                 const std::string& old_id,
+                                 const std::string& new_id) {
+  SqliteStatement stmt = statements_->Get(kRenameRecentViewSql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to prepare statement: {}", sqlite3_errmsg(db_));
+    return false;
+  }
+  std::string type_string = RecentViewTypeToString(t);
+  BindString(stmt, 1, new_id);
+  BindString(stmt, 2, type_string);
+  BindString(stmt, 3, old_id);
+  if (sqlite3_step(stmt) != SQLITE_DONE) {
+    Logger::get()->warn("Failed to rename recent view {}: {}", old_id, sqlite3_errmsg(db_));
+    return false;
+  }
+  return true;
 }
 
 std::vector<RecentView> HistoryDb::GetRecentViews(RecentViewType t, int limit) {
-  sqlite3_stmt* stmt;
-  int rc = sqlite3_prepare_v2(db_, kGetRecentViewsForTypeSql, -1, &stmt, nullptr);
-  if (rc != SQLITE_OK) {
+  SqliteStatement stmt = statements_->Get(kGetRecentViewsForTypeSql);
+  if (!stmt) {
     Logger::get()->warn("Failed to fetch data: {}", sqlite3_errmsg(db_));
     return {};
   }
@@ -111,22 +171,29 @@ std::vector<RecentView> HistoryDb::GetRecentViews(RecentViewType t, int limit) {
     views.push_back({});
     RecentView& view = views.back();
     view.id = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-    view.timestamp = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+    view.timestamp_micros = sqlite3_column_int64(stmt, 1);
   }
-
-  sqlite3_finalize(stmt);
   return views;
 }
 
 std::vector<std::string> HistoryDb::GetRecentUniqueNames(RecentViewType t, int limit) {
-  auto views = GetRecentViews(t, limit);
-  std::vector<std::string> result;
-  for (auto& view : views) {
-    if (!VectorContains(result, view.id)) {
-      result.push_back(view.id);
-    }
+  SqliteStatement stmt = statements_->Get(kGetRecentViewsForTypeSql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to fetch data: {}", sqlite3_errmsg(db_));
+    return {};
+  }
+
+  std::string type_string = RecentViewTypeToString(t);
+  BindString(stmt, 1, type_string);
+  sqlite3_bind_int(stmt, 2, limit);
+
+  // (Type, Id) is the primary key so the ids are already unique.
+  std::vector<std::string> names;
+  names.reserve(limit);
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    names.push_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
   }
-  return result;
+  return names;
 }
 
 }  // namespace aim
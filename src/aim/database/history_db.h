@@ -3,6 +3,7 @@
 #include <sqlite3.h>
 
 #include <filesystem>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -10,26 +11,36 @@
 
 namespace aim {
 
+class Database;
+class SqliteStatementCache;
+struct SqliteMigration;
+
+std::vector<SqliteMigration> GetHistoryMigrations();
+
 enum class RecentViewType { SCENARIO, PLAYLIST, THEME, CROSSHAIR };
 
 struct RecentView {
   std::string id;
-  std::string timestamp;
+  i64 timestamp_micros = 0;
 };
 
 class HistoryDb {
  public:
-  explicit HistoryDb(const std::filesystem::path& db_path);
-  ~HistoryDb();
+  // Uses the connection owned by database, which must outlive this.
+  explicit HistoryDb(Database* database);
   AIM_NO_COPY(HistoryDb);
 
   void UpdateRecentView(RecentViewType t, const std::string& id);
 
+  bool RenameRecentView(RecentViewType t, const std::string& old_id, const std::string& new_id);
+
+  // Most recent first.
   std::vector<RecentView> GetRecentViews(RecentViewType t, int limit);
   std::vector<std::string> GetRecentUniqueNames(RecentViewType t, int limit);
 
  private:
   sqlite3* db_ = nullptr;
+  SqliteStatementCache* statements_;
 };
 
 }  // namespace aim
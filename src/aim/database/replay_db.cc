@@ -0,0 +1,282 @@
+#include "replay_db.h"
+
+#include <sqlite3.h>
+
+#include <string>
+
+#include "aim/common/log.h"
+#include "aim/database/database.h"
+#include "aim/database/sqlite_util.h"
+
+namespace aim {
+namespace {
+
+const char* kCreateReplaysTable = R"AIMS(
+CREATE TABLE IF NOT EXISTS Replays (
+    StatsId INTEGER PRIMARY KEY,
+    ScenarioId TEXT,
+    Timestamp TEXT,
+    DurationSeconds REAL,
+    Score REAL,
+    Codec TEXT,
+    ByteSize INTEGER,
+    Checksum INTEGER,
+    FileName TEXT
+);
+CREATE INDEX IF NOT EXISTS ReplaysByScenario ON Replays (ScenarioId, StatsId);
+)AIMS";
+
+const char* kInsertSql = R"AIMS(
+INSERT OR REPLACE INTO Replays (
+    StatsId,
+    ScenarioId,
+    Timestamp,
+    DurationSeconds,
+    Score,
+    Codec,
+    ByteSize,
+    Checksum,
+    FileName)
+  VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?);
+)AIMS";
+
+const char* kGetReplaySql = R"AIMS(
+SELECT
+  StatsId,
+  ScenarioId,
+  Timestamp,
+  DurationSeconds,
+  Score,
+  Codec,
+  ByteSize,
+  Checksum,
+  FileName
+FROM Replays
+WHERE StatsId = ?;
+)AIMS";
+
+const char* kGetReplaysForScenarioSql = R"AIMS(
+SELECT
+  StatsId,
+  ScenarioId,
+  Timestamp,
+  DurationSeconds,
+  Score,
+  Codec,
+  ByteSize,
+  Checksum,
+  FileName
+FROM Replays
+WHERE ScenarioId = ?
+ORDER BY StatsId ASC;
+)AIMS";
+
+const char* kGetAllReplaysSql = R"AIMS(
+SELECT
+  StatsId,
+  ScenarioId,
+  Timestamp,
+  DurationSeconds,
+  Score,
+  Codec,
+  ByteSize,
+  Checksum,
+  FileName
+FROM Replays
+ORDER BY StatsId ASC;
+)AIMS";
+
+// Keeps the most recent runs and the personal bests. Everything else is returned.
+const char* kGetExpiredReplaysSql = R"AIMS(
+SELECT
+  StatsId,
+  ScenarioId,
+  Timestamp,
+  DurationSeconds,
+  Score,
+  Codec,
+  ByteSize,
+  Checksum,
+  FileName
+FROM Replays
+WHERE ScenarioId = ?1
+  AND StatsId NOT IN (
+    SELECT StatsId FROM Replays WHERE ScenarioId = ?1 ORDER BY StatsId DESC LIMIT ?2)
+  AND StatsId NOT IN (
+    SELECT StatsId FROM Replays WHERE ScenarioId = ?1 ORDER BY Score DESC, StatsId DESC LIMIT ?3)
+ORDER BY StatsId ASC;
+)AIMS";
+
+const char* kDeleteReplaySql = R"AIMS(
+DELETE FROM Replays WHERE StatsId = ?;
+)AIMS";
+
+const char* kDeleteAllReplaysForScenarioSql = R"AIMS(
+DELETE FROM Replays WHERE ScenarioId = ?;
+)AIMS";
+
+const char* kRenameScenarioSql = R"AIMS(
+UPDATE Replays SET ScenarioId = ? WHERE ScenarioId = ?;
+)AIMS";
+
+std::string GetColumnString(sqlite3_stmt* stmt, int column) {
+  const unsigned char* text = sqlite3_column_text(stmt, column);
+  return text != nullptr ? reinterpret_cast<const char*>(text) : "";
+}
+
+ReplayRow ReadReplayRow(sqlite3_stmt* stmt) {
+  ReplayRow row;
+  row.stats_id = sqlite3_column_int64(stmt, 0);
+  row.scenario_id = GetColumnString(stmt, 1);
+  row.timestamp = GetColumnString(stmt, 2);
+  row.duration_seconds = sqlite3_column_double(stmt, 3);
+  row.score = sqlite3_column_double(stmt, 4);
+  row.codec = GetColumnString(stmt, 5);
+  row.byte_size = sqlite3_column_int64(stmt, 6);
+  row.checksum = static_cast<u64>(sqlite3_column_int64(stmt, 7));
+  row.file_name = GetColumnString(stmt, 8);
+  return row;
+}
+
+}  // namespace
+
+std::vector<SqliteMigration> GetReplayMigrations() {
+  return {
+      {1, kCreateReplaysTable},
+  };
+}
+
+ReplayDb::ReplayDb(Database* database)
+    : db_(database->db()), statements_(database->statements()) {}
+
+void ReplayDb::AddReplay(const ReplayRow& row) {
+  SqliteStatement stmt = statements_->Get(kInsertSql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to prepare statement: {}", sqlite3_errmsg(db_));
+    return;
+  }
+
+  sqlite3_bind_int64(stmt, 1, row.stats_id);
+  BindString(stmt, 2, row.scenario_id);
+  BindString(stmt, 3, row.timestamp);
+  sqlite3_bind_double(stmt, 4, row.duration_seconds);
+  sqlite3_bind_double(stmt, 5, row.score);
+  BindString(stmt, 6, row.codec);
+  sqlite3_bind_int64(stmt, 7, row.byte_size);
+  sqlite3_bind_int64(stmt, 8, static_cast<i64>(row.checksum));
+  BindString(stmt, 9, row.file_name);
+
+  int rc = sqlite3_step(stmt);
+  if (rc != SQLITE_DONE) {
+    Logger::get()->warn("Failed to add replay for {}: {}", row.stats_id, sqlite3_errmsg(db_));
+  }
+}
+
+std::optional<ReplayRow> ReplayDb::GetReplay(i64 stats_id) {
+  SqliteStatement stmt = statements_->Get(kGetReplaySql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to fetch data: {}", sqlite3_errmsg(db_));
+    return {};
+  }
+  sqlite3_bind_int64(stmt, 1, stats_id);
+
+  std::optional<ReplayRow> result;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    result = ReadReplayRow(stmt);
+  }
+  return result;
+}
+
+std::vector<ReplayRow> ReplayDb::GetReplays(const std::string& scenario_id) {
+  SqliteStatement stmt = statements_->Get(kGetReplaysForScenarioSql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to fetch data: {}", sqlite3_errmsg(db_));
+    return {};
+  }
+  BindString(stmt, 1, scenario_id);
+
+  std::vector<ReplayRow> replays;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    replays.push_back(ReadReplayRow(stmt));
+  }
+  return replays;
+}
+
+std::vector<ReplayRow> ReplayDb::GetAllReplays() {
+  SqliteStatement stmt = statements_->Get(kGetAllReplaysSql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to fetch data: {}", sqlite3_errmsg(db_));
+    return {};
+  }
+
+  std::vector<ReplayRow> replays;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    replays.push_back(ReadReplayRow(stmt));
+  }
+  return replays;
+}
+
+std::vector<ReplayRow> ReplayDb::GetExpiredReplays(const std::string& scenario_id,
+                                                   int keep_last_n,
+                                                   int keep_best_n) {
+  SqliteStatement stmt = statements_->Get(kGetExpiredReplaysSql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to fetch data: {}", sqlite3_errmsg(db_));
+    return {};
+  }
+  BindString(stmt, 1, scenario_id);
+  sqlite3_bind_int(stmt, 2, keep_last_n);
+  sqlite3_bind_int(stmt, 3, keep_best_n);
+
+  std::vector<ReplayRow> replays;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    replays.push_back(ReadReplayRow(stmt));
+  }
+  return replays;
+}
+
+void ReplayDb::DeleteReplay(i64 stats_id) {
+  SqliteStatement stmt = statements_->Get(kDeleteReplaySql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to prepare statement: {}", sqlite3_errmsg(db_));
+    return;
+  }
+  sqlite3_bind_int64(stmt, 1, stats_id);
+  int rc = sqlite3_step(stmt);
+  if (rc != SQLITE_DONE) {
+    Logger::get()->warn("Failed to delete replay {}: {}", stats_id, sqlite3_errmsg(db_));
+  }
+}
+
+void ReplayDb::DeleteAllReplays(const std::string& scenario_id) {
+  SqliteStatement stmt = statements_->Get(kDeleteAllReplaysForScenarioSql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to prepare statement: {}", sqlite3_errmsg(db_));
+    return;
+  }
+  BindString(stmt, 1, scenario_id);
+  int rc = sqlite3_step(stmt);
+  if (rc != SQLITE_DONE) {
+    Logger::get()->warn("Failed to delete replays for {}: {}", scenario_id, sqlite3_errmsg(db_));
+  }
+}
+
+bool ReplayDb::RenameScenario(const std::string& old_scenario_id,
+                              const std::string& new_scenario_id) {
+  SqliteStatement stmt = statements_->Get(kRenameScenarioSql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to prepare statement: {}", sqlite3_errmsg(db_));
+    return false;
+  }
+  BindString(stmt, 1, new_scenario_id);
+  BindString(stmt, 2, old_scenario_id);
+  int rc = sqlite3_step(stmt);
+  if (rc != SQLITE_DONE) {
+    Logger::get()->warn(
+        "Failed to rename replays for {}: {}", old_scenario_id, sqlite3_errmsg(db_));
+    return false;
+  }
+  return true;
+}
+
+}  // namespace aim
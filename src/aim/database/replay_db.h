@@ -0,0 +1,66 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "aim/common/simple_types.h"
+
+namespace aim {
+
+class Database;
+class SqliteStatementCache;
+struct SqliteMigration;
+
+std::vector<SqliteMigration> GetReplayMigrations();
+
+// Metadata describing a stored replay. The replay payload itself lives outside of the database
+// and is only read when the replay is opened.
+struct ReplayRow {
+  i64 stats_id = 0;
+  std::string scenario_id;
+  std::string timestamp;
+  double duration_seconds = 0;
+  double score = 0;
+  std::string codec;
+  i64 byte_size = 0;
+  u64 checksum = 0;
+  std::string file_name;
+};
+
+class ReplayDb {
+ public:
+  // Uses the connection owned by database, which must outlive this.
+  explicit ReplayDb(Database* database);
+  AIM_NO_COPY(ReplayDb);
+
+  void AddReplay(const ReplayRow& row);
+
+  std::optional<ReplayRow> GetReplay(i64 stats_id);
+
+  std::vector<ReplayRow> GetReplays(const std::string& scenario_id);
+
+  std::vector<ReplayRow> GetAllReplays();
+
+  // Returns the replays for the scenario which are neither in the most recent keep_last_n runs
+  // nor in the top keep_best_n scores.
+  std::vector<ReplayRow> GetExpiredReplays(const std::string& scenario_id,
+                                           int keep_last_n,
+                                           int keep_best_n);
+
+  void DeleteReplay(i64 stats_id);
+
+  void DeleteAllReplays(const std::string& scenario_id);
+
+  bool RenameScenario(const std::string& old_scenario_id, const std::string& new_scenario_id);
+
+ private:
+  sqlite3* db_ = nullptr;
+  SqliteStatementCache* statements_;
+};
+
+}  // namespace aim
@@ -9,6 +9,7 @@
 
 #include "aim/common/log.h"
 #include "aim/common/times.h"
+#include "aim/database/database.h"
 #include "aim/database/sqlite_util.h"
 
 namespace aim {
@@ -23,8 +24,7 @@ CREATE TABLE IF NOT EXISTS ScenarioSettings (
 )AIMS";
 
 const char* kInsertSql = R"AIMS(
-INSERT OR REPLACE INTO ScenarioSettings (ScenarioId, Settings) VALUES ( ?, ?);
-ON CONFLICT (ScenarioId) DO UPDATE SET Settings = ?;
+INSERT OR REPLACE INTO ScenarioSettings (ScenarioId, Settings) VALUES (?, ?);
 )AIMS";
 
 const char* kGetScenarioSettingsSql = R"AIMS(
@@ -33,33 +33,26 @@ FROM ScenarioSettings
 WHERE ScenarioId = ?;
 )AIMS";
 
-}  // namespace
-
-SettingsDb::SettingsDb(const std::filesystem::path& db_path) {
-  char* err_msg = 0;
-  std::string db_path_str = db_path.string();
-  int rc = sqlite3_open(db_path_str.c_str(), &db_);
+// Settings already saved for the new id are replaced.
+const char* kRenameScenarioSql = R"AIMS(
+UPDATE OR REPLACE ScenarioSettings SET ScenarioId = ? WHERE ScenarioId = ?;
+)AIMS";
 
-  if (rc != SQLITE_OK) {
-    Logger::get()->warn("Cannot open settings db: {}", sqlite3_errmsg(db_));
-    sqlite3_close(db_);
-    db_ = nullptr;
-  }
+}  // namespace
 
-  ExecuteSqliteQuery(db_, kCreateScenarioSettingsTable);
+std::vector<SqliteMigration> GetSettingsMigrations() {
+  return {
+      {1, kCreateScenarioSettingsTable},
+  };
 }
 
-SettingsDb::~SettingsDb() {
-  if (db_ != nullptr) {
-    sqlite3_close(db_);
-  }
-}
+SettingsDb::SettingsDb(Database* database)
+    : db_(database->db()), statements_(database->statements()) {}
 
 void SettingsDb::UpdateScenarioSettings(const std::string& scenario_id,
                                         const ScenarioSettings& settings) {
-  sqlite3_stmt* stmt;
-  int rc = sqlite3_prepare_v2(db_, kInsertSql, -1, &stmt, nullptr);
-  if (rc != SQLITE_OK) {
+  SqliteStatement stmt = statements_->Get(kInsertSql);
+  if (!stmt) {
     Logger::get()->warn("Failed to prepare statement: {}", sqlite3_errmsg(db_));
     return;
   }
@@ -76,16 +69,16 @@ void SettingsDb::UpdateScenarioSettings(const std::string& scenario_id,
 
   BindString(stmt, 1, scenario_id);
   BindString(stmt, 2, json_string);
-  BindString(stmt, 3, json_string);
 
-  rc = sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  if (sqlite3_step(stmt) != SQLITE_DONE) {
+    Logger::get()->warn(
+        "Failed to update settings for {}: {}", scenario_id, sqlite3_errmsg(db_));
+  }
 }
 
 std::optional<ScenarioSettings> SettingsDb::GetScenarioSettings(const std::string& scenario_id) {
-  sqlite3_stmt* stmt;
-  int rc = sqlite3_prepare_v2(db_, kGetScenarioSettingsSql, -1, &stmt, nullptr);
-  if (rc != SQLITE_OK) {
+  SqliteStatement stmt = statements_->Get(kGetScenarioSettingsSql);
+  if (!stmt) {
     Logger::get()->warn("Failed to fetch data: {}", sqlite3_errmsg(db_));
     return {};
   }
@@ -106,9 +99,24 @@ std::optional<ScenarioSettings> SettingsDb::GetScenarioSettings(const std::strin
       Logger::get()->warn("Unable to parse settings json ({}): {}", status.message(), json_text);
     }
   }
-
-  sqlite3_finalize(stmt);
   return maybe_settings;
 }
 
+bool SettingsDb::RenameScenario(const std::string& old_scenario_id,
+                                const std::string& new_scenario_id) {
+  SqliteStatement stmt = statements_->Get(kRenameScenarioSql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to prepare statement: {}", sqlite3_errmsg(db_));
+    return false;
+  }
+  BindString(stmt, 1, new_scenario_id);
+  BindString(stmt, 2, old_scenario_id);
+  if (sqlite3_step(stmt) != SQLITE_DONE) {
+    Logger::get()->warn(
+        "Failed to rename scenario settings for {}: {}", old_scenario_id, sqlite3_errmsg(db_));
+    return false;
+  }
+  return true;
+}
+
 }  // namespace aim
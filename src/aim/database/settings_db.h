@@ -3,6 +3,7 @@
 #include <sqlite3.h>
 
 #include <filesystem>
+#include <memory>
 #include <optional>
 #include <string>
 #include <vector>
@@ -11,15 +12,23 @@
 
 namespace aim {
 
+class Database;
+class SqliteStatementCache;
+struct SqliteMigration;
+
+std::vector<SqliteMigration> GetSettingsMigrations();
+
 class SettingsDb {
  public:
-  explicit SettingsDb(const std::filesystem::path& db_path);
-  ~SettingsDb();
+  // Uses the connection owned by database, which must outlive this.
+  explicit SettingsDb(Database* database);
 
   void UpdateScenarioSettings(const std::string& scenario_id, const ScenarioSettings& settings);
 
   std::optional<ScenarioSettings> GetScenarioSettings(const std::string& scenario_id);
 
+  bool RenameScenario(const std::string& old_scenario_id, const std::string& new_scenario_id);
+
   SettingsDb(const SettingsDb&) = delete;
   SettingsDb(SettingsDb&&) = default;
   SettingsDb& operator=(SettingsDb other) = delete;
@@ -27,6 +36,7 @@ class SettingsDb {
 
  private:
   sqlite3* db_ = nullptr;
+  SqliteStatementCache* statements_;
 };
 
 }  // namespace aim
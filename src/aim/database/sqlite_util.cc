@@ -0,0 +1,87 @@
+#include "sqlite_util.h"
+
+#include <format>
+
+#include "aim/common/log.h"
+
+namespace aim {
+namespace {
+
+constexpr int kBusyTimeoutMillis = 5000;
+constexpr i64 kMmapSizeBytes = 64 * 1024 * 1024;
+// Negative values are in KiB.
+constexpr int kCacheSizeKib = -8192;
+
+}  // namespace
+
+void ConfigureSqliteConnection(sqlite3* db) {
+  if (db == nullptr) {
+    return;
+  }
+  // More than one connection may write to the same file so wait on locks instead of failing.
+  sqlite3_busy_timeout(db, kBusyTimeoutMillis);
+  ConfigureSqliteSchema(db, "main");
+}
+
+void ConfigureSqliteSchema(sqlite3* db, const std::string& schema) {
+  if (db == nullptr) {
+    return;
+  }
+  std::string sql = std::format(
+      "PRAGMA {0}.journal_mode = WAL; PRAGMA {0}.synchronous = NORMAL; "
+      "PRAGMA {0}.mmap_size = {1}; PRAGMA {0}.cache_size = {2};",
+      schema,
+      kMmapSizeBytes,
+      kCacheSizeKib);
+  ExecuteSqliteQuery(db, sql.c_str());
+}
+
+int GetSqliteUserVersion(sqlite3* db) {
+  sqlite3_stmt* stmt;
+  int rc = sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &stmt, nullptr);
+  if (rc != SQLITE_OK) {
+    return 0;
+  }
+  int version = 0;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    version = sqlite3_column_int(stmt, 0);
+  }
+  sqlite3_finalize(stmt);
+  return version;
+}
+
+bool ApplySqliteMigrations(sqlite3* db,
+                           const std::string& db_name,
+                           const std::vector<SqliteMigration>& migrations) {
+  if (db == nullptr) {
+    return false;
+  }
+  int current_version = GetSqliteUserVersion(db);
+  for (const SqliteMigration& migration : migrations) {
+    if (migration.version <= current_version) {
+      continue;
+    }
+    ExecuteSqliteQuery(db, "BEGIN TRANSACTION;");
+    bool ok = migration.sql == nullptr || ExecuteSqliteQuery(db, migration.sql);
+    if (ok && migration.fn) {
+      ok = migration.fn(db);
+    }
+    if (ok) {
+      std::string set_version = std::format("PRAGMA user_version = {};", migration.version);
+      ok = ExecuteSqliteQuery(db, set_version.c_str());
+    }
+    if (!ok) {
+      std::string error = sqlite3_errmsg(db);
+      ExecuteSqliteQuery(db, "ROLLBACK;");
+      Logger::get()->error(
+          "Failed to migrate {} db to version {}: {}", db_name, migration.version, error);
+      return false;
+    }
+    ExecuteSqliteQuery(db, "COMMIT;");
+    Logger::get()->info("Migrated {} db to version {}", db_name, migration.version);
+    current_version = migration.version;
+  }
+  return true;
+}
+
+}  // namespace aim
@@ -2,7 +2,13 @@
 
 #include <sqlite3.h>
 
+#include <chrono>
+#include <functional>
 #include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "aim/common/simple_types.h"
 
 namespace aim {
 
@@ -21,4 +27,180 @@ static void BindString(sqlite3_stmt* stmt, int index, const std::string& value)
   sqlite3_bind_text(stmt, index, value.c_str(), value.size(), SQLITE_TRANSIENT);
 }
 
+// Opens a transaction which is rolled back unless Commit() succeeds. Immediate transactions take
+// the write lock up front so another connection waits on busy_timeout instead of failing midway.
+// Inside an existing transaction this becomes a savepoint so db methods can be composed into a
+// larger transaction.
+class SqliteTransaction {
+ public:
+  explicit SqliteTransaction(sqlite3* db, bool immediate = true) : db_(db) {
+    is_savepoint_ = sqlite3_get_autocommit(db_) == 0;
+    if (is_savepoint_) {
+      active_ = ExecuteSqliteQuery(db_, "SAVEPOINT AimTransaction;");
+    } else {
+      active_ = ExecuteSqliteQuery(
+          db_, immediate ? "BEGIN IMMEDIATE TRANSACTION;" : "BEGIN DEFERRED TRANSACTION;");
+    }
+  }
+
+  ~SqliteTransaction() {
+    if (active_) {
+      Rollback();
+    }
+  }
+
+  AIM_NO_COPY(SqliteTransaction);
+
+  bool Commit() {
+    if (!active_) {
+      return false;
+    }
+    active_ = false;
+    if (!ExecuteSqliteQuery(db_, is_savepoint_ ? "RELEASE AimTransaction;" : "COMMIT;")) {
+      Rollback();
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  void Rollback() {
+    if (is_savepoint_) {
+      ExecuteSqliteQuery(db_, "ROLLBACK TO AimTransaction;");
+      ExecuteSqliteQuery(db_, "RELEASE AimTransaction;");
+    } else {
+      ExecuteSqliteQuery(db_, "ROLLBACK;");
+    }
+  }
+
+  sqlite3* db_;
+  bool is_savepoint_ = false;
+  bool active_ = false;
+};
+
+// Applies the settings shared by every connection to the main schema. WAL lets readers keep going
+// while a write commits, and with synchronous=NORMAL only checkpoints wait on fsync instead of
+// every commit.
+void ConfigureSqliteConnection(sqlite3* db);
+
+// Applies the same per file settings to an attached schema.
+void ConfigureSqliteSchema(sqlite3* db, const std::string& schema);
+
+// A schema change which is applied once. Migrations run in version order, each inside its own
+// transaction, and PRAGMA user_version records the last one applied.
+struct SqliteMigration {
+  int version = 0;
+  const char* sql = nullptr;
+  // Optional data migration run after sql in the same transaction.
+  std::function<bool(sqlite3*)> fn;
+};
+
+int GetSqliteUserVersion(sqlite3* db);
+
+// Returns false if a migration failed. Migrations after the failed one are not attempted.
+bool ApplySqliteMigrations(sqlite3* db,
+                           const std::string& db_name,
+                           const std::vector<SqliteMigration>& migrations);
+
+struct SqliteStatementTimes {
+  const char* sql = nullptr;
+  u64 num_calls = 0;
+  i64 total_micros = 0;
+  i64 max_micros = 0;
+};
+
+// Handle to a cached prepared statement. The statement is reset and its bindings cleared when the
+// handle goes out of scope so it is ready for the next caller. Converts to sqlite3_stmt* so it can
+// be passed straight to the sqlite3 api.
+class SqliteStatement {
+ public:
+  SqliteStatement() {}
+  SqliteStatement(sqlite3_stmt* stmt, SqliteStatementTimes* times)
+      : stmt_(stmt), times_(times), start_time_(std::chrono::steady_clock::now()) {}
+
+  ~SqliteStatement() {
+    if (stmt_ == nullptr) {
+      return;
+    }
+    sqlite3_reset(stmt_);
+    sqlite3_clear_bindings(stmt_);
+    i64 micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - start_time_)
+                     .count();
+    times_->num_calls++;
+    times_->total_micros += micros;
+    if (micros > times_->max_micros) {
+      times_->max_micros = micros;
+    }
+  }
+
+  SqliteStatement(const SqliteStatement&) = delete;
+  SqliteStatement& operator=(const SqliteStatement&) = delete;
+  SqliteStatement(SqliteStatement&& other) noexcept
+      : stmt_(other.stmt_), times_(other.times_), start_time_(other.start_time_) {
+    other.stmt_ = nullptr;
+  }
+  SqliteStatement& operator=(SqliteStatement&&) = delete;
+
+  operator sqlite3_stmt*() const {
+    return stmt_;
+  }
+
+ private:
+  sqlite3_stmt* stmt_ = nullptr;
+  SqliteStatementTimes* times_ = nullptr;
+  std::chrono::steady_clock::time_point start_time_;
+};
+
+// Prepares each statement once per connection and hands out reusable handles. Statements are keyed
+// by the address of their SQL string so callers should pass the same constant each time. Must be
+// destroyed before the connection is closed.
+class SqliteStatementCache {
+ public:
+  explicit SqliteStatementCache(sqlite3* db) : db_(db) {}
+  AIM_NO_COPY(SqliteStatementCache);
+
+  ~SqliteStatementCache() {
+    for (auto& [sql, entry] : entries_) {
+      sqlite3_finalize(entry.stmt);
+    }
+  }
+
+  // Returns a null handle if the statement could not be prepared.
+  SqliteStatement Get(const char* sql) {
+    auto it = entries_.find(sql);
+    if (it == entries_.end()) {
+      sqlite3_stmt* stmt = nullptr;
+      int rc = sqlite3_prepare_v3(db_, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr);
+      if (rc != SQLITE_OK) {
+        sqlite3_finalize(stmt);
+        return {};
+      }
+      Entry entry;
+      entry.stmt = stmt;
+      entry.times.sql = sql;
+      it = entries_.emplace(sql, entry).first;
+    }
+    return SqliteStatement(it->second.stmt, &it->second.times);
+  }
+
+  std::vector<SqliteStatementTimes> GetTimes() const {
+    std::vector<SqliteStatementTimes> times;
+    times.reserve(entries_.size());
+    for (auto& [sql, entry] : entries_) {
+      times.push_back(entry.times);
+    }
+    return times;
+  }
+
+ private:
+  struct Entry {
+    sqlite3_stmt* stmt = nullptr;
+    SqliteStatementTimes times;
+  };
+
+  sqlite3* db_;
+  std::unordered_map<const char*, Entry> entries_;
+};
+
 }  // namespace aim
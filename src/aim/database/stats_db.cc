@@ -2,11 +2,16 @@
 
 #include <sqlite3.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <format>
+#include <optional>
 #include <string>
 
 #include "aim/common/log.h"
 #include "aim/common/times.h"
+#include "aim/database/database.h"
 #include "aim/database/sqlite_util.h"
 
 namespace aim {
@@ -14,7 +19,7 @@ namespace {
 
 const char* kCreateStatsTable = R"AIMS(
 CREATE TABLE IF NOT EXISTS Stats (
-    ScenarioId TEXT PRIMARY_KEY,
+    ScenarioId TEXT,
     StatsId INTEGER PRIMARY KEY AUTOINCREMENT,
     Timestamp TEXT,
     Score REAL,
@@ -25,20 +30,208 @@ CREATE TABLE IF NOT EXISTS Stats (
 );
 )AIMS";
 
+const char* kCreateRunAnalysisTable = R"AIMS(
+CREATE TABLE IF NOT EXISTS RunAnalysis (
+    StatsId INTEGER PRIMARY KEY,
+    ScenarioId TEXT,
+    NumShots INTEGER,
+    NumKills INTEGER,
+    NumEngagements INTEGER,
+    MeanReactionSeconds REAL,
+    MeanTimeToTargetSeconds REAL,
+    MeanOvershootDegrees REAL,
+    MeanUndershootDegrees REAL,
+    TrackingErrorRmsDegrees REAL,
+    Smoothness REAL,
+    Failed INTEGER NOT NULL DEFAULT 0
+);
+CREATE INDEX IF NOT EXISTS RunAnalysisByScenario ON RunAnalysis (ScenarioId, StatsId);
+)AIMS";
+
+// Adds the index the typo'd PRIMARY_KEY on ScenarioId never created and an integer timestamp
+// which can be range queried and sorted without parsing. Imported runs get ids above every local
+// run, so runs are put in order by when they were played rather than by id.
+const char* kAddStatsIndexAndTimestampMicros = R"AIMS(
+CREATE INDEX IF NOT EXISTS StatsByScenario ON Stats (ScenarioId, StatsId);
+ALTER TABLE Stats ADD COLUMN TimestampMicros INTEGER;
+CREATE INDEX IF NOT EXISTS StatsByScenarioTimestamp ON Stats (ScenarioId, TimestampMicros, StatsId);
+)AIMS";
+
+// One row per scenario summarizing all of its runs so the best and last run can be found without
+// scanning Stats. Kept in sync in the same transaction as every change to Stats.
+const char* kCreateScenarioAggregatesTable = R"AIMS(
+CREATE TABLE IF NOT EXISTS ScenarioAggregates (
+    ScenarioId TEXT PRIMARY KEY,
+    RunCount INTEGER,
+    BestStatsId INTEGER,
+    BestScore REAL,
+    LastStatsId INTEGER,
+    ScoreSum REAL,
+    ScoreSumSquares REAL
+);
+INSERT OR REPLACE INTO ScenarioAggregates (
+    ScenarioId,
+    RunCount,
+    BestStatsId,
+    BestScore,
+    LastStatsId,
+    ScoreSum,
+    ScoreSumSquares)
+  SELECT
+    s.ScenarioId,
+    COUNT(*),
+    (SELECT b.StatsId FROM Stats b
+      WHERE b.ScenarioId = s.ScenarioId
+      ORDER BY b.Score DESC, b.StatsId DESC LIMIT 1),
+    MAX(s.Score),
+    (SELECT l.StatsId FROM Stats l
+      WHERE l.ScenarioId = s.ScenarioId
+      ORDER BY l.TimestampMicros DESC, l.StatsId DESC LIMIT 1),
+    SUM(s.Score),
+    SUM(s.Score * s.Score)
+  FROM Stats s
+  GROUP BY s.ScenarioId;
+)AIMS";
+
+const char* kGetStatsMissingTimestampMicrosSql = R"AIMS(
+SELECT StatsId, Timestamp FROM Stats WHERE TimestampMicros IS NULL;
+)AIMS";
+
+const char* kSetTimestampMicrosSql = R"AIMS(
+UPDATE Stats SET TimestampMicros = ? WHERE StatsId = ?;
+)AIMS";
+
 const char* kInsertSql = R"AIMS(
 INSERT INTO Stats (
-	StatsId,
+    StatsId,
     ScenarioId,
     Timestamp,
+    TimestampMicros,
     NumHits,
     NumShots,
     CmPer360,
     Score)
-  VALUES (NULL, ?, ?, ?, ?, ?, ?);
+  VALUES (?, ?, ?, ?, ?, ?, ?, ?);
+)AIMS";
+
+// AUTOINCREMENT never reuses ids so deleted rows still count.
+const char* kGetMaxStatsIdSql = R"AIMS(
+SELECT MAX(Id) FROM (
+  SELECT MAX(StatsId) AS Id FROM Stats
+  UNION ALL
+  SELECT seq AS Id FROM sqlite_sequence WHERE name = 'Stats');
+)AIMS";
+
+// Ties go to the most recent run. The last run is the one with the latest timestamp, ?4.
+const char* kAddToScenarioAggregatesSql = R"AIMS(
+INSERT INTO ScenarioAggregates (
+    ScenarioId,
+    RunCount,
+    BestStatsId,
+    BestScore,
+    LastStatsId,
+    ScoreSum,
+    ScoreSumSquares)
+  VALUES (?1, 1, ?2, ?3, ?2, ?3, ?3 * ?3)
+  ON CONFLICT (ScenarioId) DO UPDATE SET
+    RunCount = RunCount + 1,
+    BestStatsId = CASE
+      WHEN excluded.BestScore > BestScore OR
+          (excluded.BestScore = BestScore AND excluded.BestStatsId > BestStatsId)
+        THEN excluded.BestStatsId
+      ELSE BestStatsId END,
+    BestScore = MAX(BestScore, excluded.BestScore),
+    LastStatsId = CASE
+      WHEN (?4, excluded.LastStatsId) > (
+          SELECT l.TimestampMicros, l.StatsId FROM Stats l
+          WHERE l.StatsId = ScenarioAggregates.LastStatsId)
+        THEN excluded.LastStatsId
+      ELSE LastStatsId END,
+    ScoreSum = ScoreSum + excluded.ScoreSum,
+    ScoreSumSquares = ScoreSumSquares + excluded.ScoreSumSquares;
+)AIMS";
+
+const char* kDeleteScenarioAggregatesSql = R"AIMS(
+DELETE FROM ScenarioAggregates WHERE ScenarioId = ?;
 )AIMS";
 
+// Recomputes the row from Stats. Used when the best run may have been removed.
+const char* kRebuildScenarioAggregatesSql = R"AIMS(
+INSERT OR REPLACE INTO ScenarioAggregates (
+    ScenarioId,
+    RunCount,
+    BestStatsId,
+    BestScore,
+    LastStatsId,
+    ScoreSum,
+    ScoreSumSquares)
+  SELECT
+    s.ScenarioId,
+    COUNT(*),
+    (SELECT b.StatsId FROM Stats b
+      WHERE b.ScenarioId = s.ScenarioId
+      ORDER BY b.Score DESC, b.StatsId DESC LIMIT 1),
+    MAX(s.Score),
+    (SELECT l.StatsId FROM Stats l
+      WHERE l.ScenarioId = s.ScenarioId
+      ORDER BY l.TimestampMicros DESC, l.StatsId DESC LIMIT 1),
+    SUM(s.Score),
+    SUM(s.Score * s.Score)
+  FROM Stats s
+  WHERE s.ScenarioId = ?
+  GROUP BY s.ScenarioId;
+)AIMS";
+
+const char* kGetScenarioAggregatesSql = R"AIMS(
+SELECT
+  a.RunCount,
+  a.ScoreSum,
+  a.ScoreSumSquares,
+  b.StatsId,
+  b.Timestamp,
+  b.NumHits,
+  b.NumShots,
+  b.CmPer360,
+  b.Score,
+  l.StatsId,
+  l.Timestamp,
+  l.NumHits,
+  l.NumShots,
+  l.CmPer360,
+  l.Score
+FROM ScenarioAggregates a
+JOIN Stats b ON b.StatsId = a.BestStatsId
+JOIN Stats l ON l.StatsId = a.LastStatsId
+WHERE a.ScenarioId = ?;
+)AIMS";
+
+// Recency is by timestamp with the id as a tie break since imported runs get ids above every local
+// run.
 const char* kGetRecentStatsSql = R"AIMS(
-SELECT 
+SELECT
+  StatsId,
+  Timestamp,
+  NumHits,
+  NumShots,
+  CmPer360,
+  Score
+FROM (
+  SELECT
+    StatsId,
+    Timestamp,
+    TimestampMicros,
+    NumHits,
+    NumShots,
+    CmPer360,
+    Score
+  FROM Stats
+  WHERE ScenarioId = ?
+  ORDER BY TimestampMicros DESC, StatsId DESC LIMIT 5000)
+ORDER BY TimestampMicros ASC, StatsId ASC;
+)AIMS";
+
+const char* kGetStatsRowSql = R"AIMS(
+SELECT
   StatsId,
   Timestamp,
   NumHits,
@@ -46,52 +239,479 @@ SELECT
   CmPer360,
   Score
 FROM Stats
-WHERE ScenarioId = ?
-ORDER BY StatsId ASC LIMIT 5000;
+WHERE ScenarioId = ? AND StatsId = ?;
+)AIMS";
+
+const char* kGetHighScoreBeforeSql = R"AIMS(
+SELECT
+  StatsId,
+  Timestamp,
+  NumHits,
+  NumShots,
+  CmPer360,
+  Score
+FROM Stats
+WHERE ScenarioId = ? AND StatsId < ?
+ORDER BY Score DESC, StatsId DESC LIMIT 1;
+)AIMS";
+
+// Size and first run of the score history window, which holds the most recent runs by timestamp.
+// A negative LIMIT means no limit.
+const char* kGetScoreHistoryWindowSql = R"AIMS(
+WITH Runs AS MATERIALIZED (
+  SELECT StatsId, TimestampMicros FROM Stats
+  WHERE ScenarioId = ?1
+    AND StatsId BETWEEN ?2 AND ?3
+    AND IFNULL(TimestampMicros, 0) BETWEEN ?4 AND ?5
+  ORDER BY TimestampMicros DESC, StatsId DESC LIMIT ?6)
+SELECT
+  COUNT(*),
+  MIN(TimestampMicros),
+  (SELECT MIN(StatsId) FROM Runs
+    WHERE TimestampMicros = (SELECT MIN(TimestampMicros) FROM Runs)),
+  (SELECT COUNT(*) FROM Stats
+    WHERE ScenarioId = ?1
+      AND StatsId BETWEEN ?2 AND ?3
+      AND IFNULL(TimestampMicros, 0) BETWEEN ?4 AND ?5)
+FROM Runs;
+)AIMS";
+
+// Every run from the first run of the window on, in the same order.
+const char* kGetScoreHistorySql = R"AIMS(
+SELECT StatsId, IFNULL(TimestampMicros, 0), Score FROM Stats
+WHERE ScenarioId = ?1
+  AND StatsId BETWEEN ?2 AND ?3
+  AND IFNULL(TimestampMicros, 0) BETWEEN ?4 AND ?5
+  AND (TimestampMicros, StatsId) >= (?6, ?7)
+ORDER BY TimestampMicros ASC, StatsId ASC;
 )AIMS";
 
 const char* kGetMostRecentRunIdSql = R"AIMS(
 SELECT StatsId
 FROM Stats
 WHERE ScenarioId = ?
-ORDER BY StatsId DESC LIMIT 1;
+ORDER BY TimestampMicros DESC, StatsId DESC LIMIT 1;
 )AIMS";
 
 const char* kDeleteAllStatsForScenarioSql = R"AIMS(
 DELETE FROM Stats WHERE ScenarioId = ?;
 )AIMS";
 
+const char* kDeleteStatsSql = R"AIMS(
+DELETE FROM Stats WHERE ScenarioId = ? AND StatsId = ?;
+)AIMS";
+
+const char* kDeleteRunAnalysisSql = R"AIMS(
+DELETE FROM RunAnalysis WHERE StatsId = ?;
+)AIMS";
+
+const char* kDeleteRunMetricsSql = R"AIMS(
+DELETE FROM RunMetrics WHERE StatsId = ?;
+)AIMS";
+
+const char* kGetScoresSql = R"AIMS(
+SELECT StatsId, Score FROM Stats WHERE ScenarioId = ?;
+)AIMS";
+
+const char* kCopyAllStatsSql = R"AIMS(
+INSERT INTO Stats (
+    ScenarioId,
+    Timestamp,
+    TimestampMicros,
+    NumHits,
+    NumShots,
+    CmPer360,
+    Score,
+    ExtraInfo)
+  SELECT ?, Timestamp, TimestampMicros, NumHits, NumShots, CmPer360, Score, ExtraInfo
+  FROM Stats
+  WHERE ScenarioId = ?
+  ORDER BY StatsId ASC;
+)AIMS";
+
+const char* kGetAllStatsSql = R"AIMS(
+SELECT
+  ScenarioId,
+  StatsId,
+  Timestamp,
+  NumHits,
+  NumShots,
+  CmPer360,
+  Score
+FROM Stats
+ORDER BY StatsId ASC;
+)AIMS";
+
 const char* kRenameScenarioSql = R"AIMS(
 UPDATE Stats SET ScenarioId = ? WHERE ScenarioId = ?;
 )AIMS";
 
-}  // namespace
+const char* kInsertRunAnalysisSql = R"AIMS(
+INSERT OR REPLACE INTO RunAnalysis (
+    StatsId,
+    ScenarioId,
+    NumShots,
+    NumKills,
+    NumEngagements,
+    MeanReactionSeconds,
+    MeanTimeToTargetSeconds,
+    MeanOvershootDegrees,
+    MeanUndershootDegrees,
+    TrackingErrorRmsDegrees,
+    Smoothness,
+    Failed)
+  VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);
+)AIMS";
+
+const char* kGetRunAnalysesSql = R"AIMS(
+SELECT
+  StatsId,
+  ScenarioId,
+  NumShots,
+  NumKills,
+  NumEngagements,
+  MeanReactionSeconds,
+  MeanTimeToTargetSeconds,
+  MeanOvershootDegrees,
+  MeanUndershootDegrees,
+  TrackingErrorRmsDegrees,
+  Smoothness
+FROM RunAnalysis
+WHERE ScenarioId = ? AND Failed = 0
+ORDER BY StatsId ASC;
+)AIMS";
+
+// Includes failed runs so they are not tried again.
+const char* kGetAnalyzedRunIdsSql = R"AIMS(
+SELECT StatsId FROM RunAnalysis;
+)AIMS";
+
+const char* kDeleteAllRunAnalysesForScenarioSql = R"AIMS(
+DELETE FROM RunAnalysis WHERE ScenarioId = ?;
+)AIMS";
+
+const char* kRenameRunAnalysesSql = R"AIMS(
+UPDATE RunAnalysis SET ScenarioId = ? WHERE ScenarioId = ?;
+)AIMS";
+
+// Typed summary columns are computed on insert so trends can be queried without decoding the
+// per run samples, which are stored as packed float arrays.
+const char* kCreateRunMetricsTable = R"AIMS(
+CREATE TABLE IF NOT EXISTS RunMetrics (
+    StatsId INTEGER PRIMARY KEY,
+    ScenarioId TEXT,
+    NumKills INTEGER,
+    MeanKillIntervalSeconds REAL,
+    MeanReactionSeconds REAL,
+    MedianReactionSeconds REAL,
+    MeanAccuracy REAL,
+    AccuracyIntervalSeconds REAL,
+    FrameTimeP50Micros INTEGER,
+    FrameTimeP90Micros INTEGER,
+    FrameTimeP99Micros INTEGER,
+    FrameTimeMaxMicros INTEGER,
+    KillIntervals BLOB,
+    ReactionTimes BLOB,
+    AccuracyOverTime BLOB
+);
+CREATE INDEX IF NOT EXISTS RunMetricsByScenario ON RunMetrics (ScenarioId, StatsId);
+)AIMS";
+
+const char* kInsertRunMetricsSql = R"AIMS(
+INSERT OR REPLACE INTO RunMetrics (
+    StatsId,
+    ScenarioId,
+    NumKills,
+    MeanKillIntervalSeconds,
+    MeanReactionSeconds,
+    MedianReactionSeconds,
+    MeanAccuracy,
+    AccuracyIntervalSeconds,
+    FrameTimeP50Micros,
+    FrameTimeP90Micros,
+    FrameTimeP99Micros,
+    FrameTimeMaxMicros,
+    KillIntervals,
+    ReactionTimes,
+    AccuracyOverTime)
+  VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);
+)AIMS";
+
+const char* kGetRunMetricsSql = R"AIMS(
+SELECT
+  StatsId,
+  ScenarioId,
+  AccuracyIntervalSeconds,
+  FrameTimeP50Micros,
+  FrameTimeP90Micros,
+  FrameTimeP99Micros,
+  FrameTimeMaxMicros,
+  KillIntervals,
+  ReactionTimes,
+  AccuracyOverTime
+FROM RunMetrics
+WHERE StatsId = ?;
+)AIMS";
+
+const char* kGetRunMetricsTrendSql = R"AIMS(
+SELECT
+  StatsId,
+  NumKills,
+  MeanKillIntervalSeconds,
+  MeanReactionSeconds,
+  MedianReactionSeconds,
+  MeanAccuracy,
+  FrameTimeP99Micros
+FROM RunMetrics
+WHERE ScenarioId = ?
+ORDER BY StatsId DESC
+LIMIT ?;
+)AIMS";
+
+const char* kGetRunMetricsAveragesSql = R"AIMS(
+SELECT
+  MAX(StatsId),
+  COUNT(*),
+  AVG(NumKills),
+  AVG(MeanKillIntervalSeconds),
+  AVG(MeanReactionSeconds),
+  AVG(MedianReactionSeconds),
+  AVG(MeanAccuracy),
+  AVG(FrameTimeP99Micros)
+FROM (
+  SELECT * FROM RunMetrics
+  WHERE ScenarioId = ?
+  ORDER BY StatsId DESC
+  LIMIT ? OFFSET ?);
+)AIMS";
+
+const char* kDeleteAllRunMetricsForScenarioSql = R"AIMS(
+DELETE FROM RunMetrics WHERE ScenarioId = ?;
+)AIMS";
+
+const char* kRenameRunMetricsSql = R"AIMS(
+UPDATE RunMetrics SET ScenarioId = ? WHERE ScenarioId = ?;
+)AIMS";
+
+// Largest-triangle-three-buckets over a stream of points in index order. The points between the
+// first and last are split into max_points - 2 buckets and the point from each bucket which forms
+// the largest triangle with the previously kept point and the average of the next bucket is kept.
+class ScoreHistoryDownsampler {
+ public:
+  ScoreHistoryDownsampler(i64 num_points, int max_points, std::vector<ScoreHistoryPoint>* out)
+      : num_points_(num_points), num_buckets_(max_points - 2), out_(out) {
+    out_->reserve(std::min<i64>(num_points, max_points));
+  }
+
+  void Add(const ScoreHistoryPoint& point) {
+    if (num_buckets_ < 1 || num_points_ <= num_buckets_ + 2) {
+      out_->push_back(point);
+      return;
+    }
+    if (point.index == 0) {
+      Keep(point);
+      return;
+    }
+    if (point.index == num_points_ - 1) {
+      last_ = point;
+      return;
+    }
+    i64 bucket = (point.index - 1) * num_buckets_ / (num_points_ - 2);
+    if (bucket == current_bucket_) {
+      current_.push_back(point);
+    } else if (bucket == current_bucket_ + 1) {
+      next_.push_back(point);
+    } else {
+      KeepFromBucket(current_, GetAverage(next_));
+      std::swap(current_, next_);
+      next_.clear();
+      next_.push_back(point);
+      ++current_bucket_;
+    }
+  }
+
+  void Finish() {
+    if (!last_) {
+      return;
+    }
+    if (next_.size() > 0) {
+      KeepFromBucket(current_, GetAverage(next_));
+      KeepFromBucket(next_, *last_);
+    } else {
+      KeepFromBucket(current_, *last_);
+    }
+    Keep(*last_);
+  }
 
-StatsDb::StatsDb(const std::filesystem::path& db_path) {
-  char* err_msg = 0;
-  std::string db_path_str = db_path.string();
-  int rc = sqlite3_open(db_path_str.c_str(), &db_);
+ private:
+  static ScoreHistoryPoint GetAverage(const std::vector<ScoreHistoryPoint>& points) {
+    ScoreHistoryPoint average;
+    double index_sum = 0;
+    for (const ScoreHistoryPoint& point : points) {
+      index_sum += point.index;
+      average.score += point.score / points.size();
+    }
+    average.index = index_sum / points.size();
+    return average;
+  }
+
+  void KeepFromBucket(const std::vector<ScoreHistoryPoint>& bucket,
+                      const ScoreHistoryPoint& next) {
+    const ScoreHistoryPoint* best = nullptr;
+    double best_area = -1;
+    for (const ScoreHistoryPoint& point : bucket) {
+      // Twice the triangle area, which is enough for comparison.
+      double area = std::abs((previous_.index - next.index) * (point.score - previous_.score) -
+                             (previous_.index - point.index) * (next.score - previous_.score));
+      if (area > best_area) {
+        best_area = area;
+        best = &point;
+      }
+    }
+    if (best != nullptr) {
+      Keep(*best);
+    }
+  }
 
-  if (rc != SQLITE_OK) {
-    Logger::get()->warn("Cannot open stats db: {}", sqlite3_errmsg(db_));
-    sqlite3_close(db_);
-    db_ = nullptr;
+  void Keep(const ScoreHistoryPoint& point) {
+    out_->push_back(point);
+    previous_ = point;
   }
 
-  ExecuteSqliteQuery(db_, kCreateStatsTable);
+  i64 num_points_;
+  i64 num_buckets_;
+  std::vector<ScoreHistoryPoint>* out_;
+
+  ScoreHistoryPoint previous_;
+  i64 current_bucket_ = 0;
+  std::vector<ScoreHistoryPoint> current_;
+  std::vector<ScoreHistoryPoint> next_;
+  std::optional<ScoreHistoryPoint> last_;
+};
+
+StatsRow ReadStatsRow(sqlite3_stmt* stmt, int first_column) {
+  StatsRow stats;
+  stats.stats_id = sqlite3_column_int64(stmt, first_column);
+  stats.timestamp = reinterpret_cast<const char*>(sqlite3_column_text(stmt, first_column + 1));
+  stats.num_hits = sqlite3_column_double(stmt, first_column + 2);
+  stats.num_shots = sqlite3_column_double(stmt, first_column + 3);
+  stats.cm_per_360 = sqlite3_column_double(stmt, first_column + 4);
+  stats.score = sqlite3_column_double(stmt, first_column + 5);
+  return stats;
 }
 
-StatsDb::~StatsDb() {
-  if (db_ != nullptr) {
-    sqlite3_close(db_);
+void BindFloats(sqlite3_stmt* stmt, int index, const std::vector<float>& values) {
+  sqlite3_bind_blob(stmt, index, values.data(), values.size() * sizeof(float), SQLITE_TRANSIENT);
+}
+
+std::vector<float> ReadFloats(sqlite3_stmt* stmt, int column) {
+  const void* data = sqlite3_column_blob(stmt, column);
+  int num_bytes = sqlite3_column_bytes(stmt, column);
+  std::vector<float> values(num_bytes / sizeof(float));
+  if (data != nullptr && values.size() > 0) {
+    memcpy(values.data(), data, values.size() * sizeof(float));
   }
+  return values;
 }
 
-std::vector<StatsRow> StatsDb::GetStats(const std::string& scenario_id) {
-  sqlite3_stmt* stmt;
+double GetMean(const std::vector<float>& values) {
+  if (values.size() == 0) {
+    return 0;
+  }
+  double sum = 0;
+  for (float value : values) {
+    sum += value;
+  }
+  return sum / values.size();
+}
+
+double GetMedian(std::vector<float> values) {
+  if (values.size() == 0) {
+    return 0;
+  }
+  auto middle = values.begin() + values.size() / 2;
+  std::nth_element(values.begin(), middle, values.end());
+  return *middle;
+}
+
+// Mean over the intervals which had shots.
+double GetMeanAccuracy(const std::vector<float>& accuracy_over_time) {
+  double sum = 0;
+  int count = 0;
+  for (float accuracy : accuracy_over_time) {
+    if (accuracy >= 0) {
+      sum += accuracy;
+      ++count;
+    }
+  }
+  return count > 0 ? sum / count : 0;
+}
+
+RunMetricsSummary ReadRunMetricsSummary(sqlite3_stmt* stmt) {
+  RunMetricsSummary summary;
+  summary.stats_id = sqlite3_column_int64(stmt, 0);
+  summary.num_runs = 1;
+  summary.num_kills = sqlite3_column_int(stmt, 1);
+  summary.mean_kill_interval_seconds = sqlite3_column_double(stmt, 2);
+  summary.mean_reaction_seconds = sqlite3_column_double(stmt, 3);
+  summary.median_reaction_seconds = sqlite3_column_double(stmt, 4);
+  summary.mean_accuracy = sqlite3_column_double(stmt, 5);
+  summary.frame_time_p99_micros = sqlite3_column_double(stmt, 6);
+  return summary;
+}
 
-  int rc = sqlite3_prepare_v2(db_, kGetRecentStatsSql, -1, &stmt, nullptr);
-  if (rc != SQLITE_OK) {
+bool BackfillTimestampMicros(sqlite3* db) {
+  sqlite3_stmt* select_stmt;
+  if (sqlite3_prepare_v2(db, kGetStatsMissingTimestampMicrosSql, -1, &select_stmt, nullptr) !=
+      SQLITE_OK) {
+    return false;
+  }
+  sqlite3_stmt* update_stmt;
+  if (sqlite3_prepare_v2(db, kSetTimestampMicrosSql, -1, &update_stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(select_stmt);
+    return false;
+  }
+
+  bool ok = true;
+  while (ok && sqlite3_step(select_stmt) == SQLITE_ROW) {
+    i64 stats_id = sqlite3_column_int64(select_stmt, 0);
+    const unsigned char* timestamp = sqlite3_column_text(select_stmt, 1);
+    std::optional<i64> micros;
+    if (timestamp != nullptr) {
+      micros = ParseTimestampStringAsMicros(reinterpret_cast<const char*>(timestamp));
+    }
+    if (!micros) {
+      continue;
+    }
+    sqlite3_bind_int64(update_stmt, 1, *micros);
+    sqlite3_bind_int64(update_stmt, 2, stats_id);
+    ok = sqlite3_step(update_stmt) == SQLITE_DONE;
+    sqlite3_reset(update_stmt);
+  }
+
+  sqlite3_finalize(select_stmt);
+  sqlite3_finalize(update_stmt);
+  return ok;
+}
+
+}  // namespace
+
+std::vector<SqliteMigration> GetStatsMigrations() {
+  return {
+      {1, kCreateStatsTable},
+      {2, kCreateRunAnalysisTable},
+      {3, kAddStatsIndexAndTimestampMicros, BackfillTimestampMicros},
+      {4, kCreateScenarioAggregatesTable},
+      {5, kCreateRunMetricsTable},
+  };
+}
+
+StatsDb::StatsDb(Database* database)
+    : db_(database->db()), statements_(database->statements()) {}
+
+std::vector<StatsRow> StatsDb::GetStats(const std::string& scenario_id) {
+  SqliteStatement stmt = statements_->Get(kGetRecentStatsSql);
+  if (!stmt) {
     Logger::get()->warn("Failed to fetch data: {}", sqlite3_errmsg(db_));
     return {};
   }
@@ -99,26 +719,62 @@ std::vector<StatsRow> StatsDb::GetStats(const std::string& scenario_id) {
 
   std::vector<StatsRow> all_stats;
   while (sqlite3_step(stmt) == SQLITE_ROW) {
-    StatsRow stats;
-    stats.stats_id = sqlite3_column_int64(stmt, 0);
-    stats.timestamp = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-    stats.num_hits = sqlite3_column_double(stmt, 2);
-    stats.num_shots = sqlite3_column_double(stmt, 3);
-    stats.cm_per_360 = sqlite3_column_double(stmt, 4);
-    stats.score = sqlite3_column_double(stmt, 5);
+    all_stats.push_back(ReadStatsRow(stmt, 0));
+  }
+  return all_stats;
+}
+
+std::vector<double> StatsDb::GetScores(const std::string& scenario_id, i64* max_stats_id) {
+  *max_stats_id = 0;
+  SqliteStatement stmt = statements_->Get(kGetScoresSql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to fetch data: {}", sqlite3_errmsg(db_));
+    return {};
+  }
+  BindString(stmt, 1, scenario_id);
+
+  std::vector<double> scores;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    *max_stats_id = std::max<i64>(*max_stats_id, sqlite3_column_int64(stmt, 0));
+    scores.push_back(sqlite3_column_double(stmt, 1));
+  }
+  return scores;
+}
 
-    all_stats.push_back(stats);
+ScenarioAggregateRow StatsDb::GetAggregateStats(const std::string& scenario_id) {
+  SqliteStatement stmt = statements_->Get(kGetScenarioAggregatesSql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to fetch data: {}", sqlite3_errmsg(db_));
+    return {};
   }
+  BindString(stmt, 1, scenario_id);
 
-  sqlite3_finalize(stmt);
-  return all_stats;
+  ScenarioAggregateRow aggregate;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    aggregate.num_runs = sqlite3_column_int64(stmt, 0);
+    aggregate.score_sum = sqlite3_column_double(stmt, 1);
+    aggregate.score_sum_squares = sqlite3_column_double(stmt, 2);
+    aggregate.best_stats = ReadStatsRow(stmt, 3);
+    aggregate.last_stats = ReadStatsRow(stmt, 9);
+  }
+  return aggregate;
 }
 
-i64 StatsDb::GetLatestRunId(const std::string& scenario_id) {
-  sqlite3_stmt* stmt;
+std::vector<ScenarioAggregateRow> StatsDb::GetAggregateStats(
+    const std::vector<std::string>& scenario_ids) {
+  std::vector<ScenarioAggregateRow> aggregates;
+  aggregates.reserve(scenario_ids.size());
+  SqliteTransaction transaction(db_, /*immediate=*/false);
+  for (const std::string& scenario_id : scenario_ids) {
+    aggregates.push_back(GetAggregateStats(scenario_id));
+  }
+  transaction.Commit();
+  return aggregates;
+}
 
-  int rc = sqlite3_prepare_v2(db_, kGetMostRecentRunIdSql, -1, &stmt, nullptr);
-  if (rc != SQLITE_OK) {
+i64 StatsDb::GetLatestRunId(const std::string& scenario_id) {
+  SqliteStatement stmt = statements_->Get(kGetMostRecentRunIdSql);
+  if (!stmt) {
     Logger::get()->warn("Failed to fetch data: {}", sqlite3_errmsg(db_));
     return {};
   }
@@ -128,74 +784,516 @@ i64 StatsDb::GetLatestRunId(const std::string& scenario_id) {
   while (sqlite3_step(stmt) == SQLITE_ROW) {
     run_id = sqlite3_column_int64(stmt, 0);
   }
-
-  sqlite3_finalize(stmt);
   return run_id;
 }
 
-void StatsDb::AddStats(const std::string& scenario_id, StatsRow* row) {
+std::optional<StatsRow> StatsDb::GetStatsRow(const std::string& scenario_id, i64 stats_id) {
+  SqliteStatement stmt = statements_->Get(kGetStatsRowSql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to fetch data: {}", sqlite3_errmsg(db_));
+    return {};
+  }
+  BindString(stmt, 1, scenario_id);
+  sqlite3_bind_int64(stmt, 2, stats_id);
+  if (sqlite3_step(stmt) != SQLITE_ROW) {
+    return {};
+  }
+  return ReadStatsRow(stmt, 0);
+}
+
+std::optional<StatsRow> StatsDb::GetHighScoreBefore(const std::string& scenario_id,
+                                                    i64 stats_id) {
+  SqliteStatement stmt = statements_->Get(kGetHighScoreBeforeSql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to fetch data: {}", sqlite3_errmsg(db_));
+    return {};
+  }
+  BindString(stmt, 1, scenario_id);
+  sqlite3_bind_int64(stmt, 2, stats_id);
+  if (sqlite3_step(stmt) != SQLITE_ROW) {
+    return {};
+  }
+  return ReadStatsRow(stmt, 0);
+}
+
+ScoreHistory StatsDb::GetScoreHistory(const ScoreHistoryQuery& query, int max_points) {
+  // Both queries need to see the same rows while the writer may be committing.
+  SqliteTransaction transaction(db_, /*immediate=*/false);
+  ScoreHistory history = GetScoreHistoryInTransaction(query, max_points);
+  transaction.Commit();
+  return history;
+}
+
+ScoreHistory StatsDb::GetScoreHistoryInTransaction(const ScoreHistoryQuery& query,
+                                                   int max_points) {
+  ScoreHistory history;
+  i64 first_timestamp_micros = 0;
+  i64 first_stats_id = 0;
+  {
+    SqliteStatement stmt = statements_->Get(kGetScoreHistoryWindowSql);
+    if (!stmt) {
+      Logger::get()->warn("Failed to fetch data: {}", sqlite3_errmsg(db_));
+      return history;
+    }
+    BindString(stmt, 1, query.scenario_id);
+    sqlite3_bind_int64(stmt, 2, query.min_stats_id);
+    sqlite3_bind_int64(stmt, 3, query.max_stats_id);
+    sqlite3_bind_int64(stmt, 4, query.min_timestamp_micros);
+    sqlite3_bind_int64(stmt, 5, query.max_timestamp_micros);
+    sqlite3_bind_int(stmt, 6, query.max_runs > 0 ? query.max_runs : -1);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+      history.num_runs = sqlite3_column_int64(stmt, 0);
+      first_timestamp_micros = sqlite3_column_int64(stmt, 1);
+      first_stats_id = sqlite3_column_int64(stmt, 2);
+      history.num_runs_in_bounds = sqlite3_column_int64(stmt, 3);
+    }
+  }
+  if (history.num_runs == 0) {
+    return history;
+  }
+
+  SqliteStatement stmt = statements_->Get(kGetScoreHistorySql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to fetch data: {}", sqlite3_errmsg(db_));
+    return history;
+  }
+  BindString(stmt, 1, query.scenario_id);
+  sqlite3_bind_int64(stmt, 2, query.min_stats_id);
+  sqlite3_bind_int64(stmt, 3, query.max_stats_id);
+  sqlite3_bind_int64(stmt, 4, query.min_timestamp_micros);
+  sqlite3_bind_int64(stmt, 5, query.max_timestamp_micros);
+  sqlite3_bind_int64(stmt, 6, first_timestamp_micros);
+  sqlite3_bind_int64(stmt, 7, first_stats_id);
+
+  ScoreHistoryDownsampler downsampler(history.num_runs, max_points, &history.points);
+  i64 index = 0;
+  while (index < history.num_runs && sqlite3_step(stmt) == SQLITE_ROW) {
+    ScoreHistoryPoint point;
+    point.stats_id = sqlite3_column_int64(stmt, 0);
+    point.timestamp_micros = sqlite3_column_int64(stmt, 1);
+    point.score = sqlite3_column_double(stmt, 2);
+    point.index = index++;
+    downsampler.Add(point);
+  }
+  downsampler.Finish();
+  return history;
+}
+
+i64 StatsDb::InsertStats(const std::string& scenario_id, const StatsRow& row) {
+  SqliteStatement stmt = statements_->Get(kInsertSql);
+  SqliteStatement aggregate_stmt = statements_->Get(kAddToScenarioAggregatesSql);
+  if (!stmt || !aggregate_stmt) {
+    Logger::get()->warn("Failed to prepare statement: {}", sqlite3_errmsg(db_));
+    return 0;
+  }
+
+  if (row.stats_id > 0) {
+    sqlite3_bind_int64(stmt, 1, row.stats_id);
+  } else {
+    sqlite3_bind_null(stmt, 1);
+  }
+  BindString(stmt, 2, scenario_id);
+  BindString(stmt, 3, row.timestamp);
+  i64 timestamp_micros = ParseTimestampStringAsMicros(row.timestamp).value_or(GetNowMicros());
+  sqlite3_bind_int64(stmt, 4, timestamp_micros);
+  sqlite3_bind_double(stmt, 5, row.num_hits);
+  sqlite3_bind_double(stmt, 6, row.num_shots);
+  sqlite3_bind_double(stmt, 7, row.cm_per_360);
+  sqlite3_bind_double(stmt, 8, row.score);
+  int rc = sqlite3_step(stmt);
+  if (rc != SQLITE_DONE) {
+    Logger::get()->warn("Failed to add stats for {}: {}", scenario_id, sqlite3_errmsg(db_));
+    return 0;
+  }
+  i64 stats_id = sqlite3_last_insert_rowid(db_);
+
+  BindString(aggregate_stmt, 1, scenario_id);
+  sqlite3_bind_int64(aggregate_stmt, 2, stats_id);
+  sqlite3_bind_double(aggregate_stmt, 3, row.score);
+  sqlite3_bind_int64(aggregate_stmt, 4, timestamp_micros);
+  rc = sqlite3_step(aggregate_stmt);
+  if (rc != SQLITE_DONE) {
+    Logger::get()->warn(
+        "Failed to update aggregates for {}: {}", scenario_id, sqlite3_errmsg(db_));
+    return 0;
+  }
+  return stats_id;
+}
+
+bool StatsDb::AddStats(const std::string& scenario_id,
+                       StatsRow* row,
+                       const RunMetricsRow* metrics) {
   if (row->timestamp.size() == 0) {
     row->timestamp = GetNowString();
   }
 
-  sqlite3_stmt* stmt;
-  int rc = sqlite3_prepare_v2(db_, kInsertSql, -1, &stmt, nullptr);
-  if (rc != SQLITE_OK) {
-    Logger::get()->warn("Failed to prepare statement: {}", sqlite3_errmsg(db_));
-    return;
+  SqliteTransaction transaction(db_);
+  i64 stats_id = InsertStats(scenario_id, *row);
+  if (stats_id == 0) {
+    return false;
+  }
+  if (metrics != nullptr) {
+    RunMetricsRow metrics_row = *metrics;
+    metrics_row.stats_id = stats_id;
+    metrics_row.scenario_id = scenario_id;
+    if (!InsertRunMetrics(metrics_row)) {
+      return false;
+    }
   }
+  if (!transaction.Commit()) {
+    Logger::get()->warn("Failed to commit stats for {}: {}", scenario_id, sqlite3_errmsg(db_));
+    return false;
+  }
+  row->stats_id = stats_id;
+  return true;
+}
 
-  BindString(stmt, 1, scenario_id);
-  BindString(stmt, 2, row->timestamp);
-  sqlite3_bind_double(stmt, 3, row->num_hits);
-  sqlite3_bind_double(stmt, 4, row->num_shots);
-  sqlite3_bind_double(stmt, 5, row->cm_per_360);
-  sqlite3_bind_double(stmt, 6, row->score);
+i64 StatsDb::AddStatsBatch(const std::vector<ScenarioStatsRow>& rows) {
+  if (rows.size() == 0) {
+    return 0;
+  }
+  std::string now = GetNowString();
+  SqliteTransaction transaction(db_);
+  i64 num_added = 0;
+  for (const ScenarioStatsRow& stats : rows) {
+    StatsRow row = stats.row;
+    if (row.timestamp.size() == 0) {
+      row.timestamp = now;
+    }
+    if (InsertStats(stats.scenario_id, row) > 0) {
+      ++num_added;
+    }
+  }
+  if (!transaction.Commit()) {
+    Logger::get()->warn("Failed to commit stats batch: {}", sqlite3_errmsg(db_));
+    return 0;
+  }
+  return num_added;
+}
 
-  rc = sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
-  // return rc == SQLITE_DONE;
+void StatsDb::ForEachStats(const std::function<void(const ScenarioStatsRow&)>& fn) {
+  SqliteTransaction transaction(db_, /*immediate=*/false);
+  {
+    SqliteStatement stmt = statements_->Get(kGetAllStatsSql);
+    if (!stmt) {
+      Logger::get()->warn("Failed to fetch data: {}", sqlite3_errmsg(db_));
+      return;
+    }
+    ScenarioStatsRow stats;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      stats.scenario_id = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+      stats.row = ReadStatsRow(stmt, 1);
+      fn(stats);
+    }
+  }
+  transaction.Commit();
+}
 
-  row->stats_id = sqlite3_last_insert_rowid(db_);
-  return;
+i64 StatsDb::GetMaxStatsId() {
+  SqliteStatement stmt = statements_->Get(kGetMaxStatsIdSql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to fetch data: {}", sqlite3_errmsg(db_));
+    return 0;
+  }
+  i64 max_id = 0;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    max_id = sqlite3_column_int64(stmt, 0);
+  }
+  return max_id;
+}
+
+bool StatsDb::StepForScenario(const char* sql,
+                              const std::string& scenario_id,
+                              const std::string& new_scenario_id) {
+  SqliteStatement stmt = statements_->Get(sql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to prepare statement: {}", sqlite3_errmsg(db_));
+    return false;
+  }
+  int index = 1;
+  if (new_scenario_id.size() > 0) {
+    BindString(stmt, index++, new_scenario_id);
+  }
+  BindString(stmt, index, scenario_id);
+  int rc = sqlite3_step(stmt);
+  if (rc != SQLITE_DONE) {
+    Logger::get()->warn("Failed to update stats for {}: {}", scenario_id, sqlite3_errmsg(db_));
+    return false;
+  }
+  return true;
 }
 
 void StatsDb::DeleteAllStats(const std::string& scenario_id) {
-  sqlite3_stmt* stmt;
-  int rc = sqlite3_prepare_v2(db_, kDeleteAllStatsForScenarioSql, -1, &stmt, nullptr);
-  if (rc != SQLITE_OK) {
-    Logger::get()->warn("Failed to fetch data: {}", sqlite3_errmsg(db_));
+  SqliteTransaction transaction(db_);
+  bool ok = StepForScenario(kDeleteAllStatsForScenarioSql, scenario_id) &&
+            StepForScenario(kDeleteAllRunAnalysesForScenarioSql, scenario_id) &&
+            StepForScenario(kDeleteAllRunMetricsForScenarioSql, scenario_id) &&
+            StepForScenario(kDeleteScenarioAggregatesSql, scenario_id);
+  if (!ok || !transaction.Commit()) {
+    Logger::get()->warn("Failed to delete stats for {}", scenario_id);
+  }
+}
+
+bool StatsDb::RenameScenario(const std::string& old_scenario_id,
+                             const std::string& new_scenario_id) {
+  // The new id may already have runs, so rebuild its aggregate from the merged rows.
+  SqliteTransaction transaction(db_);
+  bool ok = StepForScenario(kRenameScenarioSql, old_scenario_id, new_scenario_id) &&
+            StepForScenario(kRenameRunAnalysesSql, old_scenario_id, new_scenario_id) &&
+            StepForScenario(kRenameRunMetricsSql, old_scenario_id, new_scenario_id) &&
+            StepForScenario(kDeleteScenarioAggregatesSql, old_scenario_id) &&
+            StepForScenario(kDeleteScenarioAggregatesSql, new_scenario_id) &&
+            StepForScenario(kRebuildScenarioAggregatesSql, new_scenario_id);
+  if (!ok || !transaction.Commit()) {
+    Logger::get()->warn("Failed to rename scenario id {}", old_scenario_id);
+    return false;
+  }
+  return true;
+}
+
+bool StatsDb::CopyAllStats(const std::string& from_scenario_id, const std::string& to_scenario_id) {
+  if (from_scenario_id == to_scenario_id) {
+    return false;
+  }
+  SqliteTransaction transaction(db_);
+  bool ok = StepForScenario(kCopyAllStatsSql, from_scenario_id, to_scenario_id) &&
+            StepForScenario(kDeleteScenarioAggregatesSql, to_scenario_id) &&
+            StepForScenario(kRebuildScenarioAggregatesSql, to_scenario_id);
+  if (!ok || !transaction.Commit()) {
+    Logger::get()->warn("Failed to copy stats from {} to {}", from_scenario_id, to_scenario_id);
+    return false;
+  }
+  return true;
+}
+
+bool StatsDb::StepForRun(const char* sql, i64 run_id) {
+  SqliteStatement stmt = statements_->Get(sql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to prepare statement: {}", sqlite3_errmsg(db_));
+    return false;
+  }
+  sqlite3_bind_int64(stmt, 1, run_id);
+  int rc = sqlite3_step(stmt);
+  if (rc != SQLITE_DONE) {
+    Logger::get()->warn("Failed to update run {}: {}", run_id, sqlite3_errmsg(db_));
+    return false;
+  }
+  return true;
+}
+
+bool StatsDb::DeleteStats(const std::string& scenario_id, i64 run_id) {
+  SqliteTransaction transaction(db_);
+  {
+    SqliteStatement stmt = statements_->Get(kDeleteStatsSql);
+    if (!stmt) {
+      Logger::get()->warn("Failed to prepare statement: {}", sqlite3_errmsg(db_));
+      return false;
+    }
+    BindString(stmt, 1, scenario_id);
+    sqlite3_bind_int64(stmt, 2, run_id);
+    if (sqlite3_step(stmt) != SQLITE_DONE || sqlite3_changes(db_) == 0) {
+      return false;
+    }
+  }
+  // The deleted run may have been the best or last one, so rebuild the aggregate.
+  bool ok = StepForRun(kDeleteRunAnalysisSql, run_id) &&
+            StepForRun(kDeleteRunMetricsSql, run_id) &&
+            StepForScenario(kDeleteScenarioAggregatesSql, scenario_id) &&
+            StepForScenario(kRebuildScenarioAggregatesSql, scenario_id);
+  if (!ok || !transaction.Commit()) {
+    Logger::get()->warn("Failed to delete run {} of {}", run_id, scenario_id);
+    return false;
+  }
+  return true;
+}
+
+void StatsDb::AddRunAnalyses(const std::vector<RunAnalysisRow>& rows) {
+  if (rows.size() == 0) {
+    return;
+  }
+  SqliteStatement stmt = statements_->Get(kInsertRunAnalysisSql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to prepare statement: {}", sqlite3_errmsg(db_));
     return;
   }
+
+  SqliteTransaction transaction(db_);
+  for (const RunAnalysisRow& row : rows) {
+    sqlite3_bind_int64(stmt, 1, row.stats_id);
+    BindString(stmt, 2, row.scenario_id);
+    sqlite3_bind_int(stmt, 3, row.num_shots);
+    sqlite3_bind_int(stmt, 4, row.num_kills);
+    sqlite3_bind_int(stmt, 5, row.num_engagements);
+    sqlite3_bind_double(stmt, 6, row.mean_reaction_seconds);
+    sqlite3_bind_double(stmt, 7, row.mean_time_to_target_seconds);
+    sqlite3_bind_double(stmt, 8, row.mean_overshoot_degrees);
+    sqlite3_bind_double(stmt, 9, row.mean_undershoot_degrees);
+    sqlite3_bind_double(stmt, 10, row.tracking_error_rms_degrees);
+    sqlite3_bind_double(stmt, 11, row.smoothness);
+    sqlite3_bind_int(stmt, 12, row.failed ? 1 : 0);
+
+    int rc = sqlite3_step(stmt);
+    if (rc != SQLITE_DONE) {
+      Logger::get()->warn(
+          "Failed to add run analysis for {}: {}", row.stats_id, sqlite3_errmsg(db_));
+    }
+    sqlite3_reset(stmt);
+  }
+  if (!transaction.Commit()) {
+    Logger::get()->warn("Failed to commit run analyses: {}", sqlite3_errmsg(db_));
+  }
+}
+
+std::vector<RunAnalysisRow> StatsDb::GetRunAnalyses(const std::string& scenario_id) {
+  SqliteStatement stmt = statements_->Get(kGetRunAnalysesSql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to fetch data: {}", sqlite3_errmsg(db_));
+    return {};
+  }
   BindString(stmt, 1, scenario_id);
-  rc = sqlite3_step(stmt);
-  if (rc != SQLITE_DONE) {
-    Logger::get()->warn("Failed to delete stats for {}: {}", scenario_id, sqlite3_errmsg(db_));
+
+  std::vector<RunAnalysisRow> rows;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    RunAnalysisRow row;
+    row.stats_id = sqlite3_column_int64(stmt, 0);
+    row.scenario_id = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+    row.num_shots = sqlite3_column_int(stmt, 2);
+    row.num_kills = sqlite3_column_int(stmt, 3);
+    row.num_engagements = sqlite3_column_int(stmt, 4);
+    row.mean_reaction_seconds = sqlite3_column_double(stmt, 5);
+    row.mean_time_to_target_seconds = sqlite3_column_double(stmt, 6);
+    row.mean_overshoot_degrees = sqlite3_column_double(stmt, 7);
+    row.mean_undershoot_degrees = sqlite3_column_double(stmt, 8);
+    row.tracking_error_rms_degrees = sqlite3_column_double(stmt, 9);
+    row.smoothness = sqlite3_column_double(stmt, 10);
+    rows.push_back(row);
   }
-  sqlite3_finalize(stmt);
+  return rows;
 }
 
-void StatsDb::RenameScenario(const std::string& old_scenario_id,
-                             const std::string& new_scenario_id) {
-  sqlite3_stmt* stmt;
-  int rc = sqlite3_prepare_v2(db_, kRenameScenarioSql, -1, &stmt, nullptr);
-  if (rc != SQLITE_OK) {
+std::vector<i64> StatsDb::GetAnalyzedRunIds() {
+  SqliteStatement stmt = statements_->Get(kGetAnalyzedRunIdsSql);
+  if (!stmt) {
     Logger::get()->warn("Failed to fetch data: {}", sqlite3_errmsg(db_));
-    return;
+    return {};
+  }
+
+  std::vector<i64> run_ids;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    run_ids.push_back(sqlite3_column_int64(stmt, 0));
   }
-  BindString(stmt, 1, new_scenario_id);
-  BindString(stmt, 2, old_scenario_id);
-  rc = sqlite3_step(stmt);
+  return run_ids;
+}
+
+bool StatsDb::InsertRunMetrics(const RunMetricsRow& row) {
+  SqliteStatement stmt = statements_->Get(kInsertRunMetricsSql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to prepare statement: {}", sqlite3_errmsg(db_));
+    return false;
+  }
+  sqlite3_bind_int64(stmt, 1, row.stats_id);
+  BindString(stmt, 2, row.scenario_id);
+  sqlite3_bind_int(stmt, 3, row.kill_intervals_seconds.size());
+  sqlite3_bind_double(stmt, 4, GetMean(row.kill_intervals_seconds));
+  sqlite3_bind_double(stmt, 5, GetMean(row.reaction_seconds));
+  sqlite3_bind_double(stmt, 6, GetMedian(row.reaction_seconds));
+  sqlite3_bind_double(stmt, 7, GetMeanAccuracy(row.accuracy_over_time));
+  sqlite3_bind_double(stmt, 8, row.accuracy_interval_seconds);
+  sqlite3_bind_int64(stmt, 9, row.frame_time_p50_micros);
+  sqlite3_bind_int64(stmt, 10, row.frame_time_p90_micros);
+  sqlite3_bind_int64(stmt, 11, row.frame_time_p99_micros);
+  sqlite3_bind_int64(stmt, 12, row.frame_time_max_micros);
+  BindFloats(stmt, 13, row.kill_intervals_seconds);
+  BindFloats(stmt, 14, row.reaction_seconds);
+  BindFloats(stmt, 15, row.accuracy_over_time);
+
+  int rc = sqlite3_step(stmt);
   if (rc != SQLITE_DONE) {
-    Logger::get()->warn(
-        "Failed to rename scenario id {}: {}", old_scenario_id, sqlite3_errmsg(db_));
+    Logger::get()->warn("Failed to add run metrics for {}: {}", row.stats_id, sqlite3_errmsg(db_));
+    return false;
+  }
+  return true;
+}
+
+void StatsDb::AddRunMetrics(const std::vector<RunMetricsRow>& rows) {
+  if (rows.size() == 0) {
+    return;
+  }
+  SqliteTransaction transaction(db_);
+  for (const RunMetricsRow& row : rows) {
+    InsertRunMetrics(row);
+  }
+  if (!transaction.Commit()) {
+    Logger::get()->warn("Failed to commit run metrics: {}", sqlite3_errmsg(db_));
+  }
+}
+
+std::optional<RunMetricsRow> StatsDb::GetRunMetrics(i64 stats_id) {
+  SqliteStatement stmt = statements_->Get(kGetRunMetricsSql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to fetch data: {}", sqlite3_errmsg(db_));
+    return {};
+  }
+  sqlite3_bind_int64(stmt, 1, stats_id);
+  if (sqlite3_step(stmt) != SQLITE_ROW) {
+    return {};
   }
-  sqlite3_finalize(stmt);
+  RunMetricsRow row;
+  row.stats_id = sqlite3_column_int64(stmt, 0);
+  row.scenario_id = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+  row.accuracy_interval_seconds = sqlite3_column_double(stmt, 2);
+  row.frame_time_p50_micros = sqlite3_column_int64(stmt, 3);
+  row.frame_time_p90_micros = sqlite3_column_int64(stmt, 4);
+  row.frame_time_p99_micros = sqlite3_column_int64(stmt, 5);
+  row.frame_time_max_micros = sqlite3_column_int64(stmt, 6);
+  row.kill_intervals_seconds = ReadFloats(stmt, 7);
+  row.reaction_seconds = ReadFloats(stmt, 8);
+  row.accuracy_over_time = ReadFloats(stmt, 9);
+  return row;
 }
 
-void StatsDb::CopyAllStats(const std::string& from_scenario_id, const std::string& to_scenario_id) {
+std::vector<RunMetricsSummary> StatsDb::GetRunMetricsTrend(const std::string& scenario_id,
+                                                           int max_runs) {
+  SqliteStatement stmt = statements_->Get(kGetRunMetricsTrendSql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to fetch data: {}", sqlite3_errmsg(db_));
+    return {};
+  }
+  BindString(stmt, 1, scenario_id);
+  sqlite3_bind_int(stmt, 2, max_runs);
+
+  std::vector<RunMetricsSummary> trend;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    trend.push_back(ReadRunMetricsSummary(stmt));
+  }
+  std::reverse(trend.begin(), trend.end());
+  return trend;
 }
 
-void StatsDb::DeleteStats(const std::string& scenario_id, i64 run_id) {}
+std::optional<RunMetricsSummary> StatsDb::GetRunMetricsAverages(const std::string& scenario_id,
+                                                                int num_runs,
+                                                                int skip_runs) {
+  SqliteStatement stmt = statements_->Get(kGetRunMetricsAveragesSql);
+  if (!stmt) {
+    Logger::get()->warn("Failed to fetch data: {}", sqlite3_errmsg(db_));
+    return {};
+  }
+  BindString(stmt, 1, scenario_id);
+  sqlite3_bind_int(stmt, 2, num_runs);
+  sqlite3_bind_int(stmt, 3, skip_runs);
+  if (sqlite3_step(stmt) != SQLITE_ROW || sqlite3_column_int(stmt, 1) == 0) {
+    return {};
+  }
+  RunMetricsSummary summary;
+  summary.stats_id = sqlite3_column_int64(stmt, 0);
+  summary.num_runs = sqlite3_column_int(stmt, 1);
+  summary.num_kills = std::round(sqlite3_column_double(stmt, 2));
+  summary.mean_kill_interval_seconds = sqlite3_column_double(stmt, 3);
+  summary.mean_reaction_seconds = sqlite3_column_double(stmt, 4);
+  summary.median_reaction_seconds = sqlite3_column_double(stmt, 5);
+  summary.mean_accuracy = sqlite3_column_double(stmt, 6);
+  summary.frame_time_p99_micros = sqlite3_column_double(stmt, 7);
+  return summary;
+}
 
 }  // namespace aim
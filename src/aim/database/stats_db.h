@@ -3,6 +3,10 @@
 #include <sqlite3.h>
 
 #include <filesystem>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -10,6 +14,12 @@
 
 namespace aim {
 
+class Database;
+class SqliteStatementCache;
+struct SqliteMigration;
+
+std::vector<SqliteMigration> GetStatsMigrations();
+
 struct StatsRow {
   i64 stats_id = 0;
   std::string timestamp;
@@ -19,28 +29,192 @@ struct StatsRow {
   double cm_per_360 = 0.0;
 };
 
+// Aim metrics for a run which are derived offline from its replay.
+struct RunAnalysisRow {
+  i64 stats_id = 0;
+  std::string scenario_id;
+  int num_shots = 0;
+  int num_kills = 0;
+  int num_engagements = 0;
+  double mean_reaction_seconds = 0;
+  double mean_time_to_target_seconds = 0;
+  double mean_overshoot_degrees = 0;
+  double mean_undershoot_degrees = 0;
+  double tracking_error_rms_degrees = 0;
+  double smoothness = 0;
+  // The replay could not be loaded or analyzed. Kept so it is not tried again, but never returned
+  // by GetRunAnalyses.
+  bool failed = false;
+};
+
+// A run along with the scenario it belongs to, as read or written by bulk import and export.
+struct ScenarioStatsRow {
+  std::string scenario_id;
+  StatsRow row;
+};
+
+// Metrics recorded live during a run beyond what goes into the score.
+struct RunMetricsRow {
+  i64 stats_id = 0;
+  std::string scenario_id;
+  // Seconds between consecutive kills. The first is measured from the start of the run.
+  std::vector<float> kill_intervals_seconds;
+  // Seconds from a target appearing until it was killed.
+  std::vector<float> reaction_seconds;
+  // Hit ratio within each consecutive interval of accuracy_interval_seconds. -1 for intervals
+  // without any shots.
+  float accuracy_interval_seconds = 0;
+  std::vector<float> accuracy_over_time;
+  i64 frame_time_p50_micros = 0;
+  i64 frame_time_p90_micros = 0;
+  i64 frame_time_p99_micros = 0;
+  i64 frame_time_max_micros = 0;
+};
+
+// The per run summary columns of RunMetrics used for trends. When averaged over several runs
+// num_runs is the number of runs included.
+struct RunMetricsSummary {
+  i64 stats_id = 0;
+  int num_runs = 0;
+  int num_kills = 0;
+  double mean_kill_interval_seconds = 0;
+  double mean_reaction_seconds = 0;
+  double median_reaction_seconds = 0;
+  double mean_accuracy = 0;
+  double frame_time_p99_micros = 0;
+};
+
+// Summary of every run of a scenario which is kept up to date as runs are added and removed.
+struct ScenarioAggregateRow {
+  i64 num_runs = 0;
+  StatsRow best_stats;
+  StatsRow last_stats;
+  double score_sum = 0;
+  double score_sum_squares = 0;
+};
+
+struct ScoreHistoryPoint {
+  i64 stats_id = 0;
+  i64 timestamp_micros = 0;
+  double score = 0;
+  // Position of the run within the queried window, starting at 0.
+  i64 index = 0;
+};
+
+// Window of runs to chart. Bounds are inclusive.
+struct ScoreHistoryQuery {
+  std::string scenario_id;
+  i64 min_stats_id = 0;
+  i64 max_stats_id = std::numeric_limits<i64>::max();
+  i64 min_timestamp_micros = 0;
+  i64 max_timestamp_micros = std::numeric_limits<i64>::max();
+  // Only the most recent runs within the bounds. 0 for no limit.
+  int max_runs = 0;
+};
+
+struct ScoreHistory {
+  // Number of runs in the window before downsampling.
+  i64 num_runs = 0;
+  // Number of runs within the query bounds, ignoring max_runs. The window is the last num_runs
+  // of these.
+  i64 num_runs_in_bounds = 0;
+  std::vector<ScoreHistoryPoint> points;
+};
+
 class StatsDb {
  public:
-  explicit StatsDb(const std::filesystem::path& db_path);
-  ~StatsDb();
+  // Uses the connection owned by database, which must outlive this.
+  explicit StatsDb(Database* database);
   AIM_NO_COPY(StatsDb);
 
-  void AddStats(const std::string& scenario_id, StatsRow* row);
+  // Uses row->stats_id when it is set, otherwise fills it in with the new row id. metrics, if set,
+  // is written for the new row in the same transaction. Returns false if nothing was committed.
+  bool AddStats(const std::string& scenario_id,
+                StatsRow* row,
+                const RunMetricsRow* metrics = nullptr);
+
+  // Adds every row in a single transaction, updating aggregates as it goes. Rows without a stats id
+  // get a new one. Returns the number of rows added.
+  i64 AddStatsBatch(const std::vector<ScenarioStatsRow>& rows);
+
+  // Streams every run of every scenario in id order from one read transaction.
+  void ForEachStats(const std::function<void(const ScenarioStatsRow&)>& fn);
 
   std::vector<StatsRow> GetStats(const std::string& scenario_id);
 
   i64 GetLatestRunId(const std::string& scenario_id);
 
-  void RenameScenario(const std::string& old_scenario_id, const std::string& new_scenario_id);
+  std::optional<StatsRow> GetStatsRow(const std::string& scenario_id, i64 stats_id);
+
+  // Best run with an id lower than stats_id. Ties go to the most recent run.
+  std::optional<StatsRow> GetHighScoreBefore(const std::string& scenario_id, i64 stats_id);
+
+  // Streams the runs in the window in id order and downsamples them to at most max_points with
+  // largest-triangle-three-buckets. The first and last runs are always kept. Only two buckets of
+  // rows are held in memory at a time.
+  ScoreHistory GetScoreHistory(const ScoreHistoryQuery& query, int max_points);
+
+  // Every score for the scenario in no particular order. max_stats_id is set to the highest id
+  // read so rows written later can be told apart.
+  std::vector<double> GetScores(const std::string& scenario_id, i64* max_stats_id);
+
+  // num_runs is 0 if the scenario has no runs.
+  ScenarioAggregateRow GetAggregateStats(const std::string& scenario_id);
+
+  // Looks up each scenario in a single read transaction. Results are in the same order as
+  // scenario_ids.
+  std::vector<ScenarioAggregateRow> GetAggregateStats(const std::vector<std::string>& scenario_ids);
+
+  // Highest stats id ever assigned, including deleted rows.
+  i64 GetMaxStatsId();
+
+  bool RenameScenario(const std::string& old_scenario_id, const std::string& new_scenario_id);
 
   void DeleteAllStats(const std::string& scenario_id);
 
-  void CopyAllStats(const std::string& from_scenario_id, const std::string& to_scenario_id);
+  // Copies every run to to_scenario_id with new ids in a single statement.
+  bool CopyAllStats(const std::string& from_scenario_id, const std::string& to_scenario_id);
 
-  void DeleteStats(const std::string& scenario_id, i64 run_id);
+  // Also removes the run's analysis and metrics. Returns false if nothing was deleted.
+  bool DeleteStats(const std::string& scenario_id, i64 run_id);
+
+  // Writes all of the rows in a single transaction.
+  void AddRunAnalyses(const std::vector<RunAnalysisRow>& rows);
+
+  std::vector<RunAnalysisRow> GetRunAnalyses(const std::string& scenario_id);
+
+  std::vector<i64> GetAnalyzedRunIds();
+
+  // Writes all of the rows in a single transaction.
+  void AddRunMetrics(const std::vector<RunMetricsRow>& rows);
+
+  std::optional<RunMetricsRow> GetRunMetrics(i64 stats_id);
+
+  // Summaries of the most recent max_runs runs with metrics, oldest first.
+  std::vector<RunMetricsSummary> GetRunMetricsTrend(const std::string& scenario_id, int max_runs);
+
+  // Averages the summaries of num_runs runs after skipping the skip_runs most recent ones. E.g.
+  // (10, 0) and (10, 10) compare the last ten runs against the ten before.
+  std::optional<RunMetricsSummary> GetRunMetricsAverages(const std::string& scenario_id,
+                                                         int num_runs,
+                                                         int skip_runs);
 
  private:
+  // Inserts the row and adds it to the scenario aggregate. Returns the new stats id or 0.
+  i64 InsertStats(const std::string& scenario_id, const StatsRow& row);
+  bool InsertRunMetrics(const RunMetricsRow& row);
+  bool StepForRun(const char* sql, i64 run_id);
+
+  ScoreHistory GetScoreHistoryInTransaction(const ScoreHistoryQuery& query, int max_points);
+
+  // Runs a statement bound to (new_scenario_id, scenario_id), or just scenario_id when
+  // new_scenario_id is empty.
+  bool StepForScenario(const char* sql,
+                       const std::string& scenario_id,
+                       const std::string& new_scenario_id = "");
+
   sqlite3* db_ = nullptr;
+  SqliteStatementCache* statements_;
 };
 
 }  // namespace aim
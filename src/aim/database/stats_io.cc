@@ -0,0 +1,312 @@
+#include "stats_io.h"
+
+#include <nlohmann/json.h>
+
+#include <cstdlib>
+#include <format>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "aim/common/log.h"
+
+namespace aim {
+namespace {
+
+// Rows per transaction. Large enough that commit cost is negligible, small enough that memory
+// stays flat for any file size.
+constexpr size_t kImportBatchSize = 10000;
+
+constexpr const char* kScenarioIdKey = "scenario_id";
+constexpr const char* kStatsIdKey = "stats_id";
+constexpr const char* kTimestampKey = "timestamp";
+constexpr const char* kScoreKey = "score";
+constexpr const char* kNumHitsKey = "num_hits";
+constexpr const char* kNumShotsKey = "num_shots";
+constexpr const char* kCmPer360Key = "cm_per_360";
+
+std::string QuoteCsvField(const std::string& value) {
+  if (value.find_first_of(",\"\r\n") == std::string::npos) {
+    return value;
+  }
+  std::string quoted = "\"";
+  for (char c : value) {
+    if (c == '"') {
+      quoted += '"';
+    }
+    quoted += c;
+  }
+  quoted += '"';
+  return quoted;
+}
+
+// Reads one record, which may span several lines when a quoted field contains a newline. Returns
+// false at the end of the input.
+bool ReadCsvRecord(std::istream* in, std::vector<std::string>* fields) {
+  fields->clear();
+  std::string line;
+  if (!std::getline(*in, line)) {
+    return false;
+  }
+  std::string field;
+  bool in_quotes = false;
+  while (true) {
+    for (size_t i = 0; i < line.size(); ++i) {
+      char c = line[i];
+      if (in_quotes) {
+        if (c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+          field += '"';
+          ++i;
+        } else if (c == '"') {
+          in_quotes = false;
+        } else {
+          field += c;
+        }
+      } else if (c == '"') {
+        in_quotes = true;
+      } else if (c == ',') {
+        fields->push_back(std::move(field));
+        field.clear();
+      } else if (c != '\r') {
+        field += c;
+      }
+    }
+    if (!in_quotes || !std::getline(*in, line)) {
+      break;
+    }
+    field += '\n';
+  }
+  fields->push_back(std::move(field));
+  return true;
+}
+
+std::optional<double> ParseDouble(const std::string& value) {
+  if (value.size() == 0) {
+    return {};
+  }
+  char* end = nullptr;
+  double result = std::strtod(value.c_str(), &end);
+  if (end != value.c_str() + value.size()) {
+    return {};
+  }
+  return result;
+}
+
+std::optional<double> GetJsonDouble(const nlohmann::json& json, const char* key) {
+  auto it = json.find(key);
+  if (it == json.end() || !it->is_number()) {
+    return {};
+  }
+  return it->get<double>();
+}
+
+std::string GetJsonString(const nlohmann::json& json, const char* key) {
+  auto it = json.find(key);
+  if (it == json.end() || !it->is_string()) {
+    return "";
+  }
+  return it->get<std::string>();
+}
+
+void WriteCsvRow(const ScenarioStatsRow& stats, std::ostream* out) {
+  const StatsRow& row = stats.row;
+  *out << std::format("{},{},{},{},{},{},{}\n",
+                      QuoteCsvField(stats.scenario_id),
+                      row.stats_id,
+                      QuoteCsvField(row.timestamp),
+                      row.score,
+                      row.num_hits,
+                      row.num_shots,
+                      row.cm_per_360);
+}
+
+void WriteJsonRow(const ScenarioStatsRow& stats, std::ostream* out) {
+  const StatsRow& row = stats.row;
+  nlohmann::json json = {
+      {kScenarioIdKey, stats.scenario_id},
+      {kStatsIdKey, row.stats_id},
+      {kTimestampKey, row.timestamp},
+      {kScoreKey, row.score},
+      {kNumHitsKey, row.num_hits},
+      {kNumShotsKey, row.num_shots},
+      {kCmPer360Key, row.cm_per_360},
+  };
+  *out << json.dump() << '\n';
+}
+
+// Accumulates rows and writes them to the db one batch at a time.
+class ImportBatcher {
+ public:
+  ImportBatcher(StatsDb* db, const std::function<i64()>& next_stats_id)
+      : db_(db), next_stats_id_(next_stats_id) {
+    batch_.reserve(kImportBatchSize);
+  }
+
+  void Add(std::optional<ScenarioStatsRow> stats) {
+    if (!stats || stats->scenario_id.size() == 0) {
+      ++result_.num_skipped;
+      return;
+    }
+    stats->row.stats_id = next_stats_id_();
+    batch_.push_back(std::move(*stats));
+    if (batch_.size() >= kImportBatchSize) {
+      Flush();
+    }
+  }
+
+  StatsImportResult Finish() {
+    Flush();
+    return result_;
+  }
+
+ private:
+  void Flush() {
+    i64 num_added = db_->AddStatsBatch(batch_);
+    result_.num_imported += num_added;
+    result_.num_skipped += batch_.size() - num_added;
+    batch_.clear();
+  }
+
+  StatsDb* db_;
+  const std::function<i64()>& next_stats_id_;
+  std::vector<ScenarioStatsRow> batch_;
+  StatsImportResult result_;
+};
+
+std::optional<StatsImportResult> ImportCsv(StatsDb* db,
+                                           std::istream* in,
+                                           const std::function<i64()>& next_stats_id) {
+  std::vector<std::string> fields;
+  if (!ReadCsvRecord(in, &fields)) {
+    return StatsImportResult{};
+  }
+  // Spreadsheet programs often start the file with a UTF-8 byte order mark.
+  if (fields[0].starts_with("\xEF\xBB\xBF")) {
+    fields[0].erase(0, 3);
+  }
+  std::unordered_map<std::string, int> columns;
+  for (int i = 0; i < fields.size(); ++i) {
+    columns[fields[i]] = i;
+  }
+  if (!columns.contains(kScenarioIdKey) || !columns.contains(kScoreKey)) {
+    Logger::get()->warn(
+        "Stats CSV needs a header with {} and {} columns", kScenarioIdKey, kScoreKey);
+    return {};
+  }
+  auto get_column = [&](const char* key) -> int {
+    auto it = columns.find(key);
+    return it != columns.end() ? it->second : -1;
+  };
+  int scenario_id_column = get_column(kScenarioIdKey);
+  int timestamp_column = get_column(kTimestampKey);
+  int score_column = get_column(kScoreKey);
+  int num_hits_column = get_column(kNumHitsKey);
+  int num_shots_column = get_column(kNumShotsKey);
+  int cm_per_360_column = get_column(kCmPer360Key);
+
+  auto get_field = [&](int column) -> const std::string& {
+    static const std::string kEmpty;
+    return column >= 0 && column < fields.size() ? fields[column] : kEmpty;
+  };
+  auto parse_row = [&]() -> std::optional<ScenarioStatsRow> {
+    std::optional<double> score = ParseDouble(get_field(score_column));
+    if (!score) {
+      return {};
+    }
+    ScenarioStatsRow stats;
+    stats.scenario_id = get_field(scenario_id_column);
+    stats.row.timestamp = get_field(timestamp_column);
+    stats.row.score = *score;
+    stats.row.num_hits = ParseDouble(get_field(num_hits_column)).value_or(0);
+    stats.row.num_shots = ParseDouble(get_field(num_shots_column)).value_or(0);
+    stats.row.cm_per_360 = ParseDouble(get_field(cm_per_360_column)).value_or(0);
+    return stats;
+  };
+
+  ImportBatcher batcher(db, next_stats_id);
+  while (ReadCsvRecord(in, &fields)) {
+    if (fields.size() == 1 && fields[0].size() == 0) {
+      continue;
+    }
+    batcher.Add(parse_row());
+  }
+  return batcher.Finish();
+}
+
+StatsImportResult ImportJsonLines(StatsDb* db,
+                                  std::istream* in,
+                                  const std::function<i64()>& next_stats_id) {
+  ImportBatcher batcher(db, next_stats_id);
+  std::string line;
+  while (std::getline(*in, line)) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos) {
+      continue;
+    }
+    nlohmann::json json = nlohmann::json::parse(line, nullptr, /*allow_exceptions=*/false);
+    std::optional<double> score;
+    if (json.is_object()) {
+      score = GetJsonDouble(json, kScoreKey);
+    }
+    if (!score) {
+      batcher.Add({});
+      continue;
+    }
+    ScenarioStatsRow stats;
+    stats.scenario_id = GetJsonString(json, kScenarioIdKey);
+    stats.row.timestamp = GetJsonString(json, kTimestampKey);
+    stats.row.score = *score;
+    stats.row.num_hits = GetJsonDouble(json, kNumHitsKey).value_or(0);
+    stats.row.num_shots = GetJsonDouble(json, kNumShotsKey).value_or(0);
+    stats.row.cm_per_360 = GetJsonDouble(json, kCmPer360Key).value_or(0);
+    batcher.Add(std::move(stats));
+  }
+  return batcher.Finish();
+}
+
+}  // namespace
+
+std::optional<StatsFileFormat> GetStatsFileFormat(const std::filesystem::path& path) {
+  std::string extension = path.extension().string();
+  if (extension == ".csv") {
+    return StatsFileFormat::CSV;
+  }
+  if (extension == ".jsonl") {
+    return StatsFileFormat::JSON_LINES;
+  }
+  return {};
+}
+
+i64 ExportStats(StatsDb* db, StatsFileFormat format, std::ostream* out) {
+  if (format == StatsFileFormat::CSV) {
+    *out << std::format("{},{},{},{},{},{},{}\n",
+                        kScenarioIdKey,
+                        kStatsIdKey,
+                        kTimestampKey,
+                        kScoreKey,
+                        kNumHitsKey,
+                        kNumShotsKey,
+                        kCmPer360Key);
+  }
+  i64 num_written = 0;
+  db->ForEachStats([&](const ScenarioStatsRow& stats) {
+    if (format == StatsFileFormat::CSV) {
+      WriteCsvRow(stats, out);
+    } else {
+      WriteJsonRow(stats, out);
+    }
+    ++num_written;
+  });
+  return num_written;
+}
+
+std::optional<StatsImportResult> ImportStats(StatsDb* db,
+                                             StatsFileFormat format,
+                                             std::istream* in,
+                                             const std::function<i64()>& next_stats_id) {
+  if (format == StatsFileFormat::CSV) {
+    return ImportCsv(db, in, next_stats_id);
+  }
+  return ImportJsonLines(db, in, next_stats_id);
+}
+
+}  // namespace aim
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <istream>
+#include <optional>
+#include <ostream>
+
+#include "aim/common/simple_types.h"
+#include "aim/database/stats_db.h"
+
+namespace aim {
+
+// Both formats use the columns/keys scenario_id, stats_id, timestamp, score, num_hits, num_shots
+// and cm_per_360. CSV files start with a header row naming the columns, which may be in any order.
+enum class StatsFileFormat {
+  CSV,
+  JSON_LINES,
+};
+
+// Picks the format from the extension, .csv or .jsonl.
+std::optional<StatsFileFormat> GetStatsFileFormat(const std::filesystem::path& path);
+
+struct StatsImportResult {
+  i64 num_imported = 0;
+  // Rows without a scenario id or score, or which could not be parsed.
+  i64 num_skipped = 0;
+};
+
+// Streams every run to out. Returns the number of runs written.
+i64 ExportStats(StatsDb* db, StatsFileFormat format, std::ostream* out);
+
+// Reads runs from in and adds them with ids from next_stats_id, committing every few thousand rows
+// so large histories import in one pass without holding everything in memory. stats_id is ignored.
+// Returns nothing if the input has no usable CSV header.
+std::optional<StatsImportResult> ImportStats(StatsDb* db,
+                                             StatsFileFormat format,
+                                             std::istream* in,
+                                             const std::function<i64()>& next_stats_id);
+
+}  // namespace aim
@@ -0,0 +1,31 @@
+#include "stats_writer.h"
+
+#include <utility>
+
+namespace aim {
+
+StatsWriter::StatsWriter(const std::filesystem::path& db_path) {
+  queue_.Submit([this, db_path] {
+    database_ = std::make_unique<Database>();
+    database_->Attach({{"stats", db_path, GetStatsMigrations()}});
+    db_ = std::make_unique<StatsDb>(database_.get());
+  });
+}
+
+StatsWriter::~StatsWriter() {
+  // Runs after every pending task, before the queue joins its thread.
+  queue_.Submit([this] {
+    db_.reset();
+    database_.reset();
+  });
+}
+
+void StatsWriter::Submit(std::function<void(StatsDb*)> task) {
+  queue_.Submit([this, task = std::move(task)] { task(db_.get()); });
+}
+
+void StatsWriter::Flush() {
+  queue_.WaitForIdle();
+}
+
+}  // namespace aim
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+
+#include "aim/common/simple_types.h"
+#include "aim/common/task_queue.h"
+#include "aim/database/database.h"
+#include "aim/database/stats_db.h"
+
+namespace aim {
+
+// Runs stats db tasks on a single background thread with its own connection so the caller never
+// waits on disk. Tasks run in the order they were submitted. StatsManager keeps one for writes and
+// a second for prefetching reads so reads never queue behind writes.
+class StatsWriter {
+ public:
+  explicit StatsWriter(const std::filesystem::path& db_path);
+  // Finishes all submitted tasks before returning.
+  ~StatsWriter();
+  AIM_NO_COPY(StatsWriter);
+
+  void Submit(std::function<void(StatsDb*)> task);
+
+  // Blocks until every task submitted so far has finished.
+  void Flush();
+
+ private:
+  // Opened, used and closed only on the queue's thread.
+  std::unique_ptr<Database> database_;
+  std::unique_ptr<StatsDb> db_;
+  TaskQueue queue_;
+};
+
+}  // namespace aim
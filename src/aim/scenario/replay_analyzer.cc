@@ -0,0 +1,388 @@
+#include "replay_analyzer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/trigonometric.hpp>
+#include <glm/vec2.hpp>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "aim/common/log.h"
+#include "aim/common/parallel.h"
+#include "aim/common/times.h"
+#include "aim/common/util.h"
+#include "aim/core/camera.h"
+#include "aim/core/target.h"
+
+namespace aim {
+namespace {
+
+// The crosshair must move faster than this for the movement towards a new target to count as a
+// flick.
+constexpr float kFlickStartDegreesPerSecond = 60.0f;
+// The first frame slower than this after a flick started is where the flick landed.
+constexpr float kFlickStopDegreesPerSecond = 20.0f;
+// Targets which are still alive after this long no longer contribute to flick metrics.
+constexpr float kMaxEngagementSeconds = 3.0f;
+
+bool CompareEventsByTime(const ReplayEvent& lhs, const ReplayEvent& rhs) {
+  return lhs.time_seconds() < rhs.time_seconds();
+}
+
+// Offset between two orientations in degrees as (yaw, pitch). Flicks are short enough that
+// treating pitch/yaw as a flat plane is accurate enough.
+glm::vec2 GetOffsetDegrees(const PitchYaw& from, const PitchYaw& to) {
+  float yaw = std::remainder(to.yaw - from.yaw, glm::two_pi<float>());
+  return glm::degrees(glm::vec2(yaw, to.pitch - from.pitch));
+}
+
+float GetAngleDegrees(const glm::vec3& a, const glm::vec3& b) {
+  float cos_angle = glm::dot(glm::normalize(a), glm::normalize(b));
+  return glm::degrees(std::acos(glm::clamp(cos_angle, -1.0f, 1.0f)));
+}
+
+// A target from the time it appears until it is killed or removed.
+struct Engagement {
+  float start_time_seconds = 0;
+  PitchYaw start;
+  // Offset from the starting orientation to the target center.
+  glm::vec2 to_target{};
+  float distance_degrees = 0;
+
+  // False when the crosshair was already on the target when it appeared.
+  bool needs_flick = false;
+  bool flick_started = false;
+  bool reacted = false;
+  float max_progress_degrees = 0;
+  std::optional<float> landed_progress_degrees;
+  bool reached_target = false;
+};
+
+// Only touches its arguments so it is safe to call from any thread.
+std::vector<ReplayRow> GetUnanalyzedReplays(std::vector<ReplayRow> replays,
+                                            const std::vector<i64>& analyzed_run_ids) {
+  std::unordered_set<i64> analyzed(analyzed_run_ids.begin(), analyzed_run_ids.end());
+  std::vector<ReplayRow> pending;
+  for (ReplayRow& info : replays) {
+    if (!analyzed.contains(info.stats_id)) {
+      pending.push_back(std::move(info));
+    }
+  }
+  return pending;
+}
+
+// Only reads replay files so it is safe to call from any thread. Replays which cannot be loaded
+// or analyzed get a failed row. Replays which have not been started when cancelled is set are
+// skipped.
+std::vector<RunAnalysisRow> AnalyzeReplays(const ReplayManager& replay_manager,
+                                           const std::vector<ReplayRow>& pending,
+                                           int num_threads,
+                                           const std::atomic<bool>* cancelled) {
+  if (pending.size() == 0) {
+    return {};
+  }
+  Stopwatch stopwatch;
+  stopwatch.Start();
+
+  // Each worker claims the next replay, decodes it and analyzes it before claiming another so at
+  // most one decoded replay per thread is alive at a time.
+  std::vector<std::optional<RunAnalysisRow>> results(pending.size());
+  num_threads = ParallelFor(
+      (int)pending.size(),
+      [&](int i) {
+        if (cancelled != nullptr && *cancelled) {
+          return;
+        }
+        const ReplayRow& info = pending[i];
+        std::unique_ptr<Replay> replay = replay_manager.LoadReplay(info);
+        std::optional<RunAnalysisRow> row;
+        if (replay) {
+          row = AnalyzeReplay(*replay);
+        }
+        if (!row) {
+          row = RunAnalysisRow();
+          row->failed = true;
+        }
+        row->stats_id = info.stats_id;
+        row->scenario_id = info.scenario_id;
+        results[i] = std::move(row);
+      },
+      num_threads);
+
+  std::vector<RunAnalysisRow> rows;
+  rows.reserve(results.size());
+  int num_failed = 0;
+  for (auto& result : results) {
+    if (result) {
+      num_failed += result->failed ? 1 : 0;
+      rows.push_back(std::move(*result));
+    }
+  }
+  Logger::get()->info("Analyzed {} replays ({} failed) on {} threads in {}ms",
+                      rows.size(),
+                      num_failed,
+                      num_threads,
+                      stopwatch.GetElapsedMicros() / 1000);
+  return rows;
+}
+
+}  // namespace
+
+std::optional<RunAnalysisRow> AnalyzeReplay(const Replay& replay) {
+  int num_frames = replay.pitch_yaws_size() / 2;
+  if (replay.replay_fps() <= 0 || num_frames < 2) {
+    return {};
+  }
+  float frame_seconds = 1.0f / replay.replay_fps();
+
+  std::vector<ReplayEvent> events(replay.events().begin(), replay.events().end());
+  std::sort(events.begin(), events.end(), CompareEventsByTime);
+  int processed_events_up_to_index = 0;
+
+  TargetManager target_manager(replay.room());
+  Camera camera(CameraParams(replay.room()));
+
+  std::unordered_map<u16, Engagement> engagements;
+
+  RunAnalysisRow row;
+  double reaction_sum = 0;
+  int reaction_count = 0;
+  double time_to_target_sum = 0;
+  int time_to_target_count = 0;
+  double overshoot_sum = 0;
+  double undershoot_sum = 0;
+  int flick_count = 0;
+  double tracking_error_squared_sum = 0;
+  int tracking_count = 0;
+  double speed_sum = 0;
+  double speed_change_sum = 0;
+
+  auto finish_engagement = [&](u16 target_id) {
+    auto it = engagements.find(target_id);
+    if (it == engagements.end()) {
+      return;
+    }
+    const Engagement& engagement = it->second;
+    if (engagement.flick_started) {
+      float landed = engagement.landed_progress_degrees.value_or(engagement.max_progress_degrees);
+      overshoot_sum += ClampPositive(engagement.max_progress_degrees - engagement.distance_degrees);
+      undershoot_sum += ClampPositive(engagement.distance_degrees - landed);
+      ++flick_count;
+    }
+    ++row.num_engagements;
+    engagements.erase(it);
+  };
+
+  PitchYaw previous;
+  float previous_speed = 0;
+  for (int frame = 0; frame < num_frames; ++frame) {
+    float now_seconds = frame * frame_seconds;
+    camera.UpdatePitch(replay.pitch_yaws(frame * 2));
+    camera.UpdateYaw(replay.pitch_yaws(frame * 2 + 1));
+    PitchYaw current{camera.GetPitch(), camera.GetYaw()};
+
+    for (int i = processed_events_up_to_index; i < (int)events.size(); ++i) {
+      const ReplayEvent& event = events[i];
+      if (event.time_seconds() > now_seconds) {
+        break;
+      }
+      if (event.has_kill_target()) {
+        u16 target_id = event.kill_target().target_id();
+        ++row.num_kills;
+        finish_engagement(target_id);
+        target_manager.RemoveTarget(target_id);
+      }
+      if (event.has_remove_target()) {
+        u16 target_id = event.remove_target().target_id();
+        finish_engagement(target_id);
+        target_manager.RemoveTarget(target_id);
+      }
+      if (event.has_shot_fired()) {
+        ++row.num_shots;
+      }
+      if (event.has_add_target()) {
+        Target t;
+        t.id = event.add_target().target_id();
+        t.radius = event.add_target().radius();
+        t.position = ToVec3(event.add_target().position());
+        t.last_update_time_seconds = event.time_seconds();
+        target_manager.AddTarget(t);
+
+        Camera probe = camera;
+        probe.SetPitchYawLookingAtPoint(t.position);
+        Engagement engagement;
+        engagement.start_time_seconds = event.time_seconds();
+        engagement.start = current;
+        engagement.to_target = GetOffsetDegrees(current, {probe.GetPitch(), probe.GetYaw()});
+        engagement.distance_degrees = glm::length(engagement.to_target);
+        float target_distance = glm::length(t.position - camera.GetPosition());
+        float target_radius_degrees =
+            target_distance > 0 ? glm::degrees(std::atan(t.radius / target_distance)) : 0;
+        engagement.needs_flick = engagement.distance_degrees > target_radius_degrees;
+        finish_engagement(t.id);
+        engagements[t.id] = engagement;
+      }
+      if (event.has_move_linear_target()) {
+        const MoveLinearTargetEvent& move = event.move_linear_target();
+        Target* t = target_manager.GetMutableTarget(move.target_id());
+        if (t != nullptr) {
+          t->position = ToVec3(move.starting_position());
+          t->direction = glm::normalize(ToVec3(move.direction()));
+          t->speed = move.distance_per_second();
+          t->last_update_time_seconds = event.time_seconds();
+        }
+      }
+      processed_events_up_to_index = i + 1;
+    }
+    target_manager.UpdateTargetPositions(now_seconds);
+
+    LookAtInfo look_at = camera.GetLookAt();
+    auto hit_target_id = target_manager.GetNearestHitTarget(camera, look_at.front);
+    if (hit_target_id) {
+      auto it = engagements.find(*hit_target_id);
+      if (it != engagements.end() && !it->second.reached_target) {
+        it->second.reached_target = true;
+        time_to_target_sum += now_seconds - it->second.start_time_seconds;
+        ++time_to_target_count;
+      }
+    }
+
+    std::optional<float> nearest_target_degrees;
+    for (const Target& target : target_manager.GetTargets()) {
+      if (!target.CanHit()) {
+        continue;
+      }
+      float degrees = GetAngleDegrees(look_at.front, target.position - camera.GetPosition());
+      if (!nearest_target_degrees || degrees < *nearest_target_degrees) {
+        nearest_target_degrees = degrees;
+      }
+    }
+    if (nearest_target_degrees) {
+      tracking_error_squared_sum += *nearest_target_degrees * *nearest_target_degrees;
+      ++tracking_count;
+    }
+
+    float speed = 0;
+    if (frame > 0) {
+      speed = glm::length(GetOffsetDegrees(previous, current)) / frame_seconds;
+      speed_sum += speed;
+      if (frame > 1) {
+        speed_change_sum += std::abs(speed - previous_speed);
+      }
+    }
+
+    for (auto& [target_id, engagement] : engagements) {
+      if (!engagement.needs_flick || engagement.landed_progress_degrees.has_value() ||
+          now_seconds - engagement.start_time_seconds > kMaxEngagementSeconds) {
+        continue;
+      }
+      glm::vec2 moved = GetOffsetDegrees(engagement.start, current);
+      float progress = glm::dot(moved, engagement.to_target) / engagement.distance_degrees;
+      engagement.max_progress_degrees = std::max(engagement.max_progress_degrees, progress);
+      if (speed >= kFlickStartDegreesPerSecond) {
+        // Reaction time runs from the target appearing until the crosshair first moves quickly
+        // towards it.
+        glm::vec2 frame_moved = GetOffsetDegrees(previous, current);
+        if (!engagement.reacted && glm::dot(frame_moved, engagement.to_target) > 0) {
+          engagement.reacted = true;
+          reaction_sum += now_seconds - engagement.start_time_seconds;
+          ++reaction_count;
+        }
+        engagement.flick_started = true;
+      } else if (engagement.flick_started && speed < kFlickStopDegreesPerSecond) {
+        engagement.landed_progress_degrees = progress;
+      }
+    }
+
+    previous = current;
+    previous_speed = speed;
+  }
+
+  std::vector<u16> remaining_target_ids;
+  for (auto& [target_id, engagement] : engagements) {
+    remaining_target_ids.push_back(target_id);
+  }
+  for (u16 target_id : remaining_target_ids) {
+    finish_engagement(target_id);
+  }
+
+  if (reaction_count > 0) {
+    row.mean_reaction_seconds = reaction_sum / reaction_count;
+  }
+  if (time_to_target_count > 0) {
+    row.mean_time_to_target_seconds = time_to_target_sum / time_to_target_count;
+  }
+  if (flick_count > 0) {
+    row.mean_overshoot_degrees = overshoot_sum / flick_count;
+    row.mean_undershoot_degrees = undershoot_sum / flick_count;
+  }
+  if (tracking_count > 0) {
+    row.tracking_error_rms_degrees = std::sqrt(tracking_error_squared_sum / tracking_count);
+  }
+  // Mean change in angular speed relative to the mean angular speed. Lower is smoother.
+  if (speed_sum > 0) {
+    row.smoothness = speed_change_sum / speed_sum;
+  }
+  return row;
+}
+
+BackgroundReplayAnalysis::BackgroundReplayAnalysis(ReplayManager* replay_manager,
+                                                   StatsManager* stats_manager)
+    : stats_manager_(stats_manager),
+      thread_([this,
+               replay_manager,
+               replays = replay_manager->GetAllReplayInfos(),
+               analyzed_run_ids = stats_manager->LoadAnalyzedRunIds()]() mutable {
+        // The workers read the replay files directly.
+        replay_manager->WaitForPendingWrites();
+        std::vector<ReplayRow> pending =
+            GetUnanalyzedReplays(std::move(replays), analyzed_run_ids.get());
+        std::vector<RunAnalysisRow> rows =
+            AnalyzeReplays(*replay_manager, pending, 0, &cancelled_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        results_ = std::move(rows);
+      }) {}
+
+BackgroundReplayAnalysis::~BackgroundReplayAnalysis() {
+  cancelled_ = true;
+  thread_.join();
+}
+
+bool BackgroundReplayAnalysis::Poll() {
+  if (is_done_) {
+    return true;
+  }
+  std::optional<std::vector<RunAnalysisRow>> results;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    results.swap(results_);
+  }
+  if (!results) {
+    return false;
+  }
+  if (results->size() > 0) {
+    stats_manager_->AddRunAnalyses(*results);
+  }
+  is_done_ = true;
+  return true;
+}
+
+int AnalyzeStoredReplays(ReplayManager* replay_manager,
+                         StatsManager* stats_manager,
+                         int num_threads) {
+  replay_manager->WaitForPendingWrites();
+  std::vector<ReplayRow> pending = GetUnanalyzedReplays(replay_manager->GetAllReplayInfos(),
+                                                        stats_manager->GetAnalyzedRunIds());
+  std::vector<RunAnalysisRow> rows = AnalyzeReplays(*replay_manager, pending, num_threads, nullptr);
+  if (rows.size() > 0) {
+    stats_manager->AddRunAnalyses(rows);
+  }
+  return (int)std::count_if(
+      rows.begin(), rows.end(), [](const RunAnalysisRow& row) { return !row.failed; });
+}
+
+}  // namespace aim
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "aim/common/simple_types.h"
+#include "aim/core/replay_manager.h"
+#include "aim/core/stats_manager.h"
+#include "aim/database/stats_db.h"
+#include "aim/proto/replay.pb.h"
+
+namespace aim {
+
+// Steps through the replay without rendering and computes aim metrics for the run. The stats id
+// and scenario id of the returned row are not set. Safe to call from any thread.
+std::optional<RunAnalysisRow> AnalyzeReplay(const Replay& replay);
+
+// Analyzes every stored replay which does not have results yet. Each worker thread decodes and
+// analyzes one replay at a time. Results are written to the stats db in one transaction once all
+// workers finish. Replays which cannot be analyzed are stored as failed so they are not tried
+// again. Returns the number of runs analyzed.
+int AnalyzeStoredReplays(ReplayManager* replay_manager,
+                         StatsManager* stats_manager,
+                         int num_threads = 0);
+
+// Runs AnalyzeStoredReplays on a background thread so the caller keeps drawing. The thread waits
+// for pending replay writes, reads which runs are analyzed on the stats prefetch loader and then
+// analyzes the rest. The results are written by Poll(), so the managers' db connections are only
+// used from the thread which owns them.
+class BackgroundReplayAnalysis {
+ public:
+  BackgroundReplayAnalysis(ReplayManager* replay_manager, StatsManager* stats_manager);
+  // Skips any replays which have not been started yet.
+  ~BackgroundReplayAnalysis();
+  AIM_NO_COPY(BackgroundReplayAnalysis);
+
+  // Writes the results once the analysis finished. Returns true from then on.
+  bool Poll();
+
+ private:
+  StatsManager* stats_manager_;
+  std::atomic<bool> cancelled_ = false;
+  std::mutex mutex_;
+  std::optional<std::vector<RunAnalysisRow>> results_;
+  bool is_done_ = false;
+  // Declared last so the thread stops before the state it writes to is destroyed.
+  std::thread thread_;
+};
+
+}  // namespace aim
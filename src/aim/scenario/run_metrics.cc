@@ -0,0 +1,126 @@
+#include "run_metrics.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace aim {
+namespace {
+
+constexpr float kAccuracyIntervalSeconds = 5;
+// Matches the replay event estimate of ~10 kills per second.
+constexpr float kEstimatedKillsPerSecond = 10;
+constexpr int kMaxLiveTargets = 64;
+
+// Frame times are counted in fixed buckets so percentiles do not need every sample. Anything
+// slower than the last bucket only contributes to the max.
+constexpr i64 kFrameTimeBucketMicros = 10;
+constexpr i64 kNumFrameTimeBuckets = 2000;
+
+}  // namespace
+
+void RunMetricsRecorder::Reset(float duration_seconds) {
+  size_t num_kills = std::ceil(std::max(duration_seconds, 1.0f) * kEstimatedKillsPerSecond);
+  size_t num_intervals = std::ceil(duration_seconds / kAccuracyIntervalSeconds) + 1;
+
+  kill_intervals_seconds_.clear();
+  kill_intervals_seconds_.reserve(num_kills);
+  reaction_seconds_.clear();
+  reaction_seconds_.reserve(num_kills);
+  accuracy_over_time_.clear();
+  accuracy_over_time_.reserve(num_intervals);
+  target_start_times_.clear();
+  target_start_times_.reserve(kMaxLiveTargets);
+  last_kill_seconds_ = 0;
+
+  next_interval_end_seconds_ = kAccuracyIntervalSeconds;
+  interval_start_hits_ = 0;
+  interval_start_shots_ = 0;
+
+  frame_time_buckets_.assign(kNumFrameTimeBuckets, 0);
+  num_frames_ = 0;
+  max_frame_time_micros_ = 0;
+}
+
+void RunMetricsRecorder::OnTargetAdded(u16 target_id, float now_seconds) {
+  OnTargetRemoved(target_id);
+  target_start_times_.push_back({target_id, now_seconds});
+}
+
+void RunMetricsRecorder::OnTargetRemoved(u16 target_id) {
+  std::erase_if(target_start_times_,
+                [&](const std::pair<u16, float>& entry) { return entry.first == target_id; });
+}
+
+void RunMetricsRecorder::OnTargetKilled(u16 target_id, float now_seconds) {
+  kill_intervals_seconds_.push_back(now_seconds - last_kill_seconds_);
+  last_kill_seconds_ = now_seconds;
+  for (auto& [id, start_seconds] : target_start_times_) {
+    if (id == target_id) {
+      reaction_seconds_.push_back(now_seconds - start_seconds);
+      break;
+    }
+  }
+  OnTargetRemoved(target_id);
+}
+
+void RunMetricsRecorder::SampleAccuracy(float now_seconds, double num_hits, double num_shots) {
+  while (now_seconds >= next_interval_end_seconds_) {
+    AddAccuracyInterval(num_hits, num_shots);
+    next_interval_end_seconds_ += kAccuracyIntervalSeconds;
+  }
+}
+
+void RunMetricsRecorder::AddAccuracyInterval(double num_hits, double num_shots) {
+  double shots = num_shots - interval_start_shots_;
+  double hits = num_hits - interval_start_hits_;
+  accuracy_over_time_.push_back(shots > 0 ? std::clamp<float>(hits / shots, 0, 1) : -1);
+  interval_start_hits_ = num_hits;
+  interval_start_shots_ = num_shots;
+}
+
+void RunMetricsRecorder::AddFrameTime(i64 micros) {
+  if (micros < 0 || frame_time_buckets_.size() == 0) {
+    return;
+  }
+  ++num_frames_;
+  max_frame_time_micros_ = std::max(max_frame_time_micros_, micros);
+  i64 bucket = micros / kFrameTimeBucketMicros;
+  if (bucket < kNumFrameTimeBuckets) {
+    ++frame_time_buckets_[bucket];
+  }
+}
+
+i64 RunMetricsRecorder::GetFrameTimePercentile(float percentile) const {
+  if (num_frames_ == 0) {
+    return 0;
+  }
+  i64 target_count = std::ceil(num_frames_ * percentile);
+  i64 count = 0;
+  for (i64 bucket = 0; bucket < frame_time_buckets_.size(); ++bucket) {
+    count += frame_time_buckets_[bucket];
+    if (count >= target_count) {
+      return std::min((bucket + 1) * kFrameTimeBucketMicros, max_frame_time_micros_);
+    }
+  }
+  return max_frame_time_micros_;
+}
+
+RunMetricsRow RunMetricsRecorder::Finish(float now_seconds, double num_hits, double num_shots) {
+  SampleAccuracy(now_seconds, num_hits, num_shots);
+  if (num_shots > interval_start_shots_) {
+    AddAccuracyInterval(num_hits, num_shots);
+  }
+
+  RunMetricsRow row;
+  row.kill_intervals_seconds = kill_intervals_seconds_;
+  row.reaction_seconds = reaction_seconds_;
+  row.accuracy_interval_seconds = kAccuracyIntervalSeconds;
+  row.accuracy_over_time = accuracy_over_time_;
+  row.frame_time_p50_micros = GetFrameTimePercentile(0.5);
+  row.frame_time_p90_micros = GetFrameTimePercentile(0.9);
+  row.frame_time_p99_micros = GetFrameTimePercentile(0.99);
+  row.frame_time_max_micros = max_frame_time_micros_;
+  return row;
+}
+
+}  // namespace aim
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "aim/common/simple_types.h"
+#include "aim/database/stats_db.h"
+
+namespace aim {
+
+// Collects the per run metrics stored in the RunMetrics table while a scenario is running. Buffers
+// are sized in Reset so recording does not allocate mid-run in the common case. Times are seconds
+// since the start of the run.
+class RunMetricsRecorder {
+ public:
+  RunMetricsRecorder() {}
+  AIM_NO_COPY(RunMetricsRecorder);
+
+  void Reset(float duration_seconds);
+
+  void OnTargetAdded(u16 target_id, float now_seconds);
+  void OnTargetRemoved(u16 target_id);
+  void OnTargetKilled(u16 target_id, float now_seconds);
+
+  // Called once per update with the running hit and shot totals. Closes out every accuracy
+  // interval which ended before now_seconds.
+  void SampleAccuracy(float now_seconds, double num_hits, double num_shots);
+
+  // Time for one pass through the run loop.
+  void AddFrameTime(i64 micros);
+
+  // Closes the final partial accuracy interval. The stats id and scenario id are not set.
+  RunMetricsRow Finish(float now_seconds, double num_hits, double num_shots);
+
+ private:
+  void AddAccuracyInterval(double num_hits, double num_shots);
+  i64 GetFrameTimePercentile(float percentile) const;
+
+  std::vector<float> kill_intervals_seconds_;
+  std::vector<float> reaction_seconds_;
+  std::vector<float> accuracy_over_time_;
+  // Spawn time of each live target. There are only ever a handful so a flat list beats a map.
+  std::vector<std::pair<u16, float>> target_start_times_;
+  float last_kill_seconds_ = 0;
+
+  float next_interval_end_seconds_ = 0;
+  double interval_start_hits_ = 0;
+  double interval_start_shots_ = 0;
+
+  std::vector<i32> frame_time_buckets_;
+  i64 num_frames_ = 0;
+  i64 max_frame_time_micros_ = 0;
+};
+
+}  // namespace aim
@@ -6,6 +6,7 @@
 #include <imgui.h>
 
 #include <algorithm>
+#include <cmath>
 #include <format>
 #include <fstream>
 #include <glm/mat4x4.hpp>
@@ -14,6 +15,7 @@
 #include <memory>
 
 #include "aim/common/imgui_ext.h"
+#include "aim/common/log.h"
 #include "aim/common/scope_guard.h"
 #include "aim/common/times.h"
 #include "aim/common/util.h"
@@ -38,6 +40,48 @@ namespace {
 constexpr const i16 kReplayFps = 240;
 constexpr const int kDefaultTargetRenderFps = 600;
 constexpr const i64 kClickDebounceMicros = 3 * 1000;
+// Enough for 8kHz mice. The trace buffer is sized from this up front.
+constexpr const int kExpectedInputPollingRateHz = 8000;
+
+// Replay capacity is estimated up front so recording rarely grows buffers mid-run. Events are
+// mostly shot/kill/add triples so this allows for ~10 kills per second. This is not an upper
+// bound, so fast scenarios may still grow the arena.
+constexpr const float kEstimatedReplayEventsPerSecond = 30;
+constexpr const float kReplayCapacitySlackSeconds = 1;
+// Capacity is only reserved for this much of a run. Longer runs grow the arena in blocks of the
+// same size instead of asking for one huge block up front.
+constexpr const float kMaxReplayCapacitySeconds = 10 * 60;
+// Rough arena footprint of a ReplayEvent along with its sub messages.
+constexpr const size_t kEstimatedReplayEventBytes = 256;
+// Room definition and other fixed overhead.
+constexpr const size_t kReplayArenaBaseBytes = 64 * 1024;
+
+struct ReplayCapacity {
+  int num_pitch_yaws = 0;
+  int num_events = 0;
+};
+
+ReplayCapacity GetReplayCapacity(const ScenarioDef& def) {
+  float duration_seconds =
+      std::min(def.duration_seconds(), kMaxReplayCapacitySeconds) + kReplayCapacitySlackSeconds;
+  ReplayCapacity capacity;
+  capacity.num_pitch_yaws = 2 * (int)std::ceil(duration_seconds * kReplayFps);
+  capacity.num_events = def.target_def().num_targets() +
+                        (int)std::ceil(duration_seconds * kEstimatedReplayEventsPerSecond);
+  return capacity;
+}
+
+google::protobuf::ArenaOptions GetReplayArenaOptions(const ScenarioDef& def) {
+  ReplayCapacity capacity = GetReplayCapacity(def);
+  size_t num_bytes = kReplayArenaBaseBytes + capacity.num_pitch_yaws * sizeof(float) +
+                     capacity.num_events * (sizeof(void*) + kEstimatedReplayEventBytes);
+  // Blocks are only allocated once something is created on the arena, so scenarios which do not
+  // record replays do not pay for this.
+  google::protobuf::ArenaOptions options;
+  options.start_block_size = num_bytes;
+  options.max_block_size = num_bytes;
+  return options;
+}
 
 }  // namespace
 
@@ -48,14 +92,31 @@ Scenario::Scenario(const CreateScenarioParams& params, Application* app)
       timer_(kReplayFps),
       camera_(Camera(CameraParams(params.def.room()))),
       target_manager_(params.def.room()),
+      replay_arena_(GetReplayArenaOptions(params.def)),
       force_start_immediately_(params.force_start_immediately),
       from_scenario_editor_(params.from_scenario_editor) {
   theme_ = app->settings_manager().GetCurrentTheme();
+  // The stats screen shown after the run needs these.
+  app->stats_manager().PrefetchAggregateStats({id_});
+}
 
-  if (ShouldRecordReplay()) {
+void Scenario::InitializeRecording() {
+  // Editor previews are never saved and run with a huge duration.
+  if (!from_scenario_editor_ && ShouldRecordReplay()) {
     replay_ = google::protobuf::Arena::Create<Replay>(&replay_arena_);
     *replay_->mutable_room() = def_.room();
     replay_->set_replay_fps(timer_.GetReplayFps());
+
+    ReplayCapacity capacity = GetReplayCapacity(def_);
+    replay_->mutable_pitch_yaws()->Reserve(capacity.num_pitch_yaws);
+    replay_->mutable_events()->Reserve(capacity.num_events);
+    replay_arena_bytes_after_initialize_ = replay_arena_.SpaceAllocated();
+  }
+  run_metrics_.Reset(def_.duration_seconds());
+  if (replay_ != nullptr && ShouldRecordInputTrace()) {
+    input_trace_ = std::make_unique<InputTrace>();
+    input_trace_->Reserve(def_.duration_seconds(), kExpectedInputPollingRateHz);
+    input_trace_->SetStartTimestamp(SDL_GetTicksNS());
   }
 }
 
@@ -105,6 +166,14 @@ void Scenario::OnEvent(const SDL_Event& event, bool user_is_typing) {
   if (event.type == SDL_EVENT_MOUSE_MOTION && is_running()) {
     camera_.Update(event.motion.xrel, event.motion.yrel, radians_per_dot_);
   }
+  if (input_trace_ && is_running()) {
+    if (event.type == SDL_EVENT_MOUSE_MOTION) {
+      input_trace_->AddMotion(event.motion.timestamp, event.motion.xrel, event.motion.yrel);
+    }
+    if (event.type == SDL_EVENT_MOUSE_BUTTON_DOWN || event.type == SDL_EVENT_MOUSE_BUTTON_UP) {
+      input_trace_->AddButton(event.button.timestamp, event.button.button, event.button.down);
+    }
+  }
 
   if (is_adjusting_crosshair_) {
     if (event.type == SDL_EVENT_MOUSE_WHEEL) {
@@ -184,6 +253,8 @@ void Scenario::OnEvent(const SDL_Event& event, bool user_is_typing) {
 
 void Scenario::OnAttach() {
   app_.DisableVsync();
+  // Rescanning resource dirs and reloading them would cost frames mid run.
+  app_.SetFileWatchingPaused(true);
   SDL_SetWindowRelativeMouseMode(app_.sdl_window(), true);
   RefreshState();
   timer_.StartLoop();
@@ -194,6 +265,7 @@ void Scenario::OnAttach() {
 }
 
 void Scenario::OnDetach() {
+  app_.SetFileWatchingPaused(false);
   timer_.PauseRun();
   OnPause();
 }
@@ -230,6 +302,7 @@ void Scenario::OnTickStart() {
 
   if (is_running()) {
     if (!initialized_) {
+      InitializeRecording();
       Initialize();
       initialized_ = true;
     }
@@ -331,6 +404,9 @@ void Scenario::OnRunningTick() {
     if (replay_) {
       replay_->add_pitch_yaws(camera_.GetPitch());
       replay_->add_pitch_yaws(camera_.GetYaw());
+#ifndef NDEBUG
+      CountReplayAllocations();
+#endif
     }
   }
 
@@ -350,6 +426,7 @@ void Scenario::OnRunningTick() {
     }
   }
   UpdateState(&update_data_);
+  SampleAccuracy();
   num_state_updates_++;
   current_times_.update_end = timer_.GetElapsedMicros();
 
@@ -379,6 +456,9 @@ void Scenario::OnRunningTick() {
   if (settings_.metronome_bpm() > 0) {
     ImGui::Text("metronome bpm: %.0f", settings_.metronome_bpm());
   }
+  if (input_trace_ && input_trace_->num_dropped() > 0) {
+    ImGui::Text("input trace is full, later mouse events are not recorded");
+  }
 
   ImGui::End();
 
@@ -437,9 +517,25 @@ void Scenario::HandleScenarioDone() {
   stats_row.num_hits = stats_.num_hits;
   stats_row.num_shots = stats_.num_shots;
   stats_row.score = score;
-  app_.stats_manager().AddStats(id_, &stats_row);
+  app_.stats_manager().AddStats(
+      id_,
+      &stats_row,
+      run_metrics_.Finish(timer_.GetElapsedSeconds(), stats_.num_hits, stats_.num_shots));
 
   stats_id_ = stats_row.stats_id;
+  if (replay_ != nullptr) {
+#ifndef NDEBUG
+    CountReplayAllocations();
+    if (num_replay_allocations_after_initialize_ > 0) {
+      Logger::get()->warn("Replay arena grew {} times during the run",
+                          num_replay_allocations_after_initialize_);
+    }
+#endif
+    if (input_trace_ && input_trace_->num_dropped() > 0) {
+      Logger::get()->warn("Input trace dropped {} events", input_trace_->num_dropped());
+    }
+    app_.replay_manager().SaveReplay(id_, stats_row, *replay_, std::move(input_trace_));
+  }
 
   PlaylistRun* playlist_run = app_.playlist_manager().GetCurrentRun();
   if (playlist_run != nullptr && playlist_run->IsCurrentIndexValid()) {
@@ -459,6 +555,14 @@ void Scenario::HandleScenarioDone() {
   PushNextScreen(CreateStatsScreen(id_, stats_id_, &app_));
 }
 
+void Scenario::CountReplayAllocations() {
+  u64 num_bytes = replay_arena_.SpaceAllocated();
+  if (num_bytes > replay_arena_bytes_after_initialize_) {
+    ++num_replay_allocations_after_initialize_;
+    replay_arena_bytes_after_initialize_ = num_bytes;
+  }
+}
+
 ShotType::TypeCase Scenario::GetShotType() {
   ShotType::TypeCase shot_type = def_.shot_type().type_case();
   if (shot_type == ShotType::TYPE_NOT_SET) {
@@ -470,6 +574,7 @@ ShotType::TypeCase Scenario::GetShotType() {
 void Scenario::UpdatePerfStats() {
   current_times_.end = timer_.GetElapsedMicros();
   current_times_.total = current_times_.end - current_times_.start;
+  run_metrics_.AddFrameTime(current_times_.total);
 
   perf_stats_.total_time_histogram.Increment(current_times_.total);
   perf_stats_.render_time_histogram.Increment(current_times_.render_end -
@@ -479,6 +584,16 @@ void Scenario::UpdatePerfStats() {
   }
 }
 
+void Scenario::SampleAccuracy() {
+  if (GetShotType() == ShotType::kTrackingInvincible) {
+    run_metrics_.SampleAccuracy(timer_.GetElapsedSeconds(),
+                                stats_.hit_stopwatch.GetElapsedSeconds(),
+                                stats_.shot_stopwatch.GetElapsedSeconds());
+  } else {
+    run_metrics_.SampleAccuracy(timer_.GetElapsedSeconds(), stats_.num_hits, stats_.num_shots);
+  }
+}
+
 void Scenario::DoneAdjustingCrosshairSize() {
   Settings* current_settings = app_.settings_manager().GetMutableCurrentSettings();
   if (current_settings != nullptr) {
@@ -492,6 +607,7 @@ void Scenario::DoneAdjustingCrosshairSize() {
 }
 
 void Scenario::AddNewTargetEvent(const Target& target) {
+  run_metrics_.OnTargetAdded(target.id, timer_.GetElapsedSeconds());
   if (replay_ != nullptr) {
     auto event = replay_->add_events();
     event->set_time_seconds(timer_.GetElapsedSeconds());
@@ -503,6 +619,7 @@ void Scenario::AddNewTargetEvent(const Target& target) {
 }
 
 void Scenario::AddKillTargetEvent(u16 target_id) {
+  run_metrics_.OnTargetKilled(target_id, timer_.GetElapsedSeconds());
   if (!replay_) {
     return;
   }
@@ -512,6 +629,7 @@ void Scenario::AddKillTargetEvent(u16 target_id) {
 }
 
 void Scenario::AddRemoveTargetEvent(u16 target_id) {
+  run_metrics_.OnTargetRemoved(target_id);
   if (!replay_) {
     return;
   }
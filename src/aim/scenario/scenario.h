@@ -5,16 +5,19 @@
 #include <functional>
 #include <glm/mat4x4.hpp>
 #include <glm/vec3.hpp>
+#include <memory>
 #include <optional>
 
 #include "aim/core/application.h"
 #include "aim/core/camera.h"
+#include "aim/core/input_trace.h"
 #include "aim/core/metronome.h"
 #include "aim/core/perf.h"
 #include "aim/core/screen.h"
 #include "aim/core/target.h"
 #include "aim/proto/replay.pb.h"
 #include "aim/proto/scenario.pb.h"
+#include "aim/scenario/run_metrics.h"
 #include "aim/scenario/scenario_timer.h"
 
 namespace aim {
@@ -92,6 +95,12 @@ class Scenario : public Screen {
     return false;
   }
 
+  // Records every raw mouse event alongside the sampled replay. The trace reserves a large buffer
+  // up front, so it is only kept when turned on for the session.
+  virtual bool ShouldRecordInputTrace() {
+    return ShouldRecordReplay() && state_.record_input_traces;
+  }
+
   virtual ShotType::TypeCase GetDefaultShotType() {
     return ShotType::kClickSingle;
   }
@@ -131,6 +140,10 @@ class Scenario : public Screen {
 
   google::protobuf::Arena replay_arena_;
   Replay* replay_ = nullptr;
+  // Null unless the input trace is being recorded.
+  std::unique_ptr<InputTrace> input_trace_;
+  u64 replay_arena_bytes_after_initialize_ = 0;
+  int num_replay_allocations_after_initialize_ = 0;
   Theme theme_;
   bool has_started_ = false;
   ScenarioRunState run_state_ = ScenarioRunState::NOT_STARTED;
@@ -140,12 +153,19 @@ class Scenario : public Screen {
   void OnRunningTick();
   void OnWaitingForClickTick();
 
+  // Called right before Initialize so targets added there are recorded.
+  void InitializeRecording();
+  // Debug count of how often the replay outgrew the buffers reserved in InitializeRecording.
+  void CountReplayAllocations();
+
   void RefreshState();
   bool ShouldAutoHold();
 
   void DoneAdjustingCrosshairSize();
 
   void UpdatePerfStats();
+  // Feeds the running hit/shot totals to run_metrics_ in the same units HandleScenarioDone scores.
+  void SampleAccuracy();
   void HandleScenarioDone();
 
   i64 num_state_updates_ = 0;
@@ -164,6 +184,7 @@ class Scenario : public Screen {
 
   FrameTimes current_times_;
   RunPerformanceStats perf_stats_;
+  RunMetricsRecorder run_metrics_;
   bool force_start_immediately_ = false;
   bool is_adjusting_crosshair_ = false;
   bool save_crosshair_ = false;
@@ -68,14 +68,14 @@ class HomeScreen : public UiScreen {
   }
 
   void RunCurrentScenario() {
-    if (!GetCurrentScenario().has_value()) {
+    auto current_scenario = GetCurrentScenario();
+    if (!current_scenario) {
       return;
     }
-    ScenarioItem current_scenario = *GetCurrentScenario();
-    app_.history_manager().UpdateRecentView(RecentViewType::SCENARIO, current_scenario.id());
+    app_.history_manager().UpdateRecentView(RecentViewType::SCENARIO, current_scenario->id());
     CreateScenarioParams params;
-    params.id = current_scenario.id();
-    params.def = current_scenario.def;
+    params.id = current_scenario->id();
+    params.def = current_scenario->def;
     std::shared_ptr<Screen> running_scenario = CreateScenario(params, &app_);
     if (!running_scenario) {
       // TODO: Error dialog for invalid scenarios.
@@ -199,13 +199,13 @@ class HomeScreen : public UiScreen {
   }
 
  private:
-  std::optional<ScenarioItem> GetCurrentScenario() {
+  std::shared_ptr<const ScenarioItem> GetCurrentScenario() {
     return app_.scenario_manager().GetCurrentScenario();
   }
 
   std::string GetCurrentScenarioId() {
     auto scenario = app_.scenario_manager().GetCurrentScenario();
-    if (scenario.has_value()) {
+    if (scenario) {
       return scenario->id();
     }
     return "";
@@ -314,8 +314,7 @@ class HomeScreen : public UiScreen {
         PushNextScreen(CreateScenarioEditorScreen(opts, &app_));
       }
       if (result.reload_scenarios) {
-        app_.scenario_manager().LoadScenariosFromDisk();
-        app_.playlist_manager().LoadPlaylistsFromDisk();
+        app_.ReloadResourcesFromDisk();
       }
 
       ImGui::TableNextColumn();
@@ -366,8 +365,7 @@ class HomeScreen : public UiScreen {
           app_.playlist_manager().SetCurrentPlaylist(playlist.name.full_name());
         }
         if (result.reload_playlists) {
-          app_.playlist_manager().LoadPlaylistsFromDisk();
-          app_.scenario_manager().LoadScenariosFromDisk();
+          app_.ReloadResourcesFromDisk();
         }
       }
       ImGui::EndChild();
@@ -226,21 +226,20 @@ class PlaylistEditorComponent {
     if (scenario_search_text_.size() > 0) {
       auto search_words = GetSearchWords(scenario_search_text_);
       ImGui::Indent();
-      for (int i = 0; i < app_.scenario_manager().scenarios().size(); ++i) {
+      const auto& scenarios = app_.scenario_manager().scenarios();
+      for (int i : app_.scenario_manager().search_index().Search(search_words)) {
         ImGui::IdGuard id("ScenarioSearch", i);
-        const auto& scenario = app_.scenario_manager().scenarios()[i];
-        if (StringMatchesSearch(scenario.id(), search_words, /*empty_matches=*/false)) {
-          bool already_in_playlist =
-              std::any_of(scenario_items_.begin(), scenario_items_.end(), [=](const auto& item) {
-                return item.scenario() == scenario.id();
-              });
-          if (!already_in_playlist) {
-            if (ImGui::Button(scenario.id().c_str())) {
-              PlaylistItem item;
-              item.set_scenario(scenario.id());
-              item.set_num_plays(1);
-              scenario_items_.push_back(item);
-            }
+        const ScenarioInfo& scenario = *scenarios[i];
+        bool already_in_playlist =
+            std::any_of(scenario_items_.begin(), scenario_items_.end(), [&](const auto& item) {
+              return item.scenario() == scenario.id();
+            });
+        if (!already_in_playlist) {
+          if (ImGui::Button(scenario.id().c_str())) {
+            PlaylistItem item;
+            item.set_scenario(scenario.id());
+            item.set_num_plays(1);
+            scenario_items_.push_back(item);
           }
         }
       }
@@ -337,7 +336,7 @@ class PlaylistComponentImpl : public PlaylistComponent {
         editor_component_ = {};
         showing_editor_ = false;
         if (editor_result.playlist_updated) {
-          app_.playlist_manager().LoadPlaylistsFromDisk();
+          app_.playlist_manager().UpdatePlaylistsFromDisk({});
         }
       }
       return false;
@@ -417,11 +416,13 @@ class PlaylistListComponentImpl : public PlaylistListComponent {
         }
       }
     } else {
-      for (const auto& playlist : app_.playlist_manager().playlists()) {
+      SearchIndex& search_index = app_.playlist_manager().search_index();
+      search_index.Search(search_words);
+      const auto& playlists = app_.playlist_manager().playlists();
+      for (int i = 0; i < playlists.size(); ++i) {
         auto id_guard = loop_id.Get();
-        std::string name = playlist.name.full_name();
-        if (StringMatchesSearch(name, search_words)) {
-          DrawPlaylistItem(name, result);
+        if (search_index.IsMatch(i)) {
+          DrawPlaylistItem(playlists[i].name.full_name(), result);
         }
       }
     }
@@ -523,18 +524,22 @@ void PlaylistRunComponent(const std::string& id, PlaylistRun* run, Screen& scree
   ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthStretch);
   ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthFixed, progress_width);
 
-  std::vector<float> score_levels;
-  bool has_score_level = false;
+  // Levels are empty until the stats for the scenario have been loaded in the background.
+  std::vector<std::optional<float>> score_levels;
+  std::vector<std::string> scenario_ids;
   for (const auto& item : playlist.items()) {
-    auto stats = screen.app().stats_manager().GetAggregateStats(item.scenario());
-    float level = 0;
-    if (stats.total_runs > 0) {
-      auto scenario = screen.app().scenario_manager().GetScenario(item.scenario());
-      if (scenario) {
-        level = GetScenarioScoreLevel(stats.high_score_stats.score, scenario->def);
-        if (level > 0) {
-          has_score_level = true;
-        }
+    scenario_ids.push_back(item.scenario());
+  }
+  screen.app().stats_manager().PrefetchAggregateStats(scenario_ids);
+  for (const auto& item : playlist.items()) {
+    std::optional<float> level = 0;
+    auto scenario = screen.app().scenario_manager().GetScenario(item.scenario());
+    if (scenario && HasScenarioScoreLevels(scenario->def)) {
+      auto stats = screen.app().stats_manager().GetCachedAggregateStats(item.scenario());
+      if (!stats) {
+        level = {};
+      } else if (stats->total_runs > 0) {
+        level = GetScenarioScoreLevel(stats->high_score_stats.score, scenario->def);
       }
     }
     score_levels.push_back(level);
@@ -549,8 +554,10 @@ void PlaylistRunComponent(const std::string& id, PlaylistRun* run, Screen& scree
 
     ImGui::TableNextColumn();
     std::string label = item.scenario();
-    if (score_levels[i] > 0) {
-      label = std::format("{} -- {}", label, MaybeIntToString(score_levels[i], 1));
+    if (!score_levels[i].has_value()) {
+      label = std::format("{} -- ...", label);
+    } else if (*score_levels[i] > 0) {
+      label = std::format("{} -- {}", label, MaybeIntToString(*score_levels[i], 1));
     }
     if (ImGui::Selectable(label.c_str(), is_selected)) {
       run->current_index = i;
@@ -124,7 +124,7 @@ class ScenarioEditorScreen : public UiScreen {
     bundle_names_ = app_.file_system()->GetBundleNames();
 
     auto initial_scenario = app_.scenario_manager().GetScenario(opts.scenario_id);
-    if (initial_scenario.has_value()) {
+    if (initial_scenario) {
       def_ = initial_scenario->unevaluated_def;
       name_ = initial_scenario->name;
       if (opts.is_new_copy) {
@@ -191,8 +191,8 @@ class ScenarioEditorScreen : public UiScreen {
 
       if (ImGui::Button("Save", ImVec2(char_x_ * 14, 0))) {
         if (SaveScenario()) {
-          app_.scenario_manager().LoadScenariosFromDisk();
-          app_.playlist_manager().LoadPlaylistsFromDisk();
+          app_.scenario_manager().UpdateScenariosFromDisk({});
+          app_.playlist_manager().UpdatePlaylistsFromDisk({});
           PopSelf();
         }
       }
@@ -254,8 +254,8 @@ class ScenarioEditorScreen : public UiScreen {
     bool is_new_file =
         !original_name_.has_value() || original_name_->full_name() != name_.full_name();
     if (is_new_file) {
-      auto existing_scenario_with_name = mgr.GetScenario(name_.full_name());
-      if (existing_scenario_with_name.has_value()) {
+      auto existing_scenario_with_name = mgr.GetScenarioInfo(name_.full_name());
+      if (existing_scenario_with_name) {
         SetErrorMessage(std::format("Scenario \"{}\" already exists", name_.full_name()));
         return false;
       }
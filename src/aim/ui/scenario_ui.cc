@@ -19,8 +19,8 @@ class ScenarioBrowserComponentImpl : public UiComponent, public ScenarioBrowserC
     auto cid = GetComponentIdGuard();
 
     delete_confirmation_dialog_.Draw("Delete", [=](const std::string& scenario_id) {
-      auto maybe_scenario = app_->scenario_manager().GetScenario(scenario_id);
-      if (maybe_scenario.has_value()) {
+      auto maybe_scenario = app_->scenario_manager().GetScenarioInfo(scenario_id);
+      if (maybe_scenario) {
         app_->scenario_manager().DeleteScenario(maybe_scenario->name);
         result->reload_scenarios = true;
       }
@@ -51,16 +51,20 @@ class ScenarioBrowserComponentImpl : public UiComponent, public ScenarioBrowserC
       }
       if (type == ScenarioBrowserType::RECENT) {
         PlaylistRun* current_playlist_run = app_->playlist_manager().GetCurrentRun();
+        app_->stats_manager().PrefetchAggregateStats(app_->history_manager().recent_scenario_ids());
         ImGui::LoopId loop_id;
         for (const std::string& scenario_id : app_->history_manager().recent_scenario_ids()) {
           auto lid = loop_id.Get();
-          auto scenario = app_->scenario_manager().GetScenario(scenario_id);
-          if (scenario.has_value()) {
-            DrawScenarioListItem(*scenario, search_words, current_playlist_run, result);
+          auto scenario = app_->scenario_manager().GetScenarioInfo(scenario_id);
+          if (scenario && StringMatchesSearch(scenario->id(), search_words)) {
+            DrawScenarioListItem(*scenario, current_playlist_run, result);
           }
         }
       } else {
-        DrawScenarioNodes(app_->scenario_manager().scenario_nodes(), search_words, result);
+        // The full list is filtered through the prebuilt index since it is drawn every frame.
+        SearchIndex& search_index = app_->scenario_manager().search_index();
+        search_index.Search(search_words);
+        DrawScenarioNodes(app_->scenario_manager().scenario_nodes(), search_index, result);
       }
     }
     ImGui::EndChild();
@@ -73,23 +77,29 @@ class ScenarioBrowserComponentImpl : public UiComponent, public ScenarioBrowserC
   }
 
  private:
-  void CopyScenario(const ScenarioItem& item) {
+  void CopyScenario(const std::string& scenario_id) {
+    auto item = app_->scenario_manager().GetScenario(scenario_id);
+    if (!item) {
+      return;
+    }
     std::vector<std::string> taken_names =
-        app_->scenario_manager().GetAllRelativeNamesInBundle(item.name.bundle_name());
-    std::string final_name = MakeUniqueName(item.name.relative_name() + " Copy", taken_names);
-    app_->scenario_manager().SaveScenario(ResourceName(item.name.bundle_name(), final_name),
-                                          item.def);
+        app_->scenario_manager().GetAllRelativeNamesInBundle(item->name.bundle_name());
+    std::string final_name = MakeUniqueName(item->name.relative_name() + " Copy", taken_names);
+    app_->scenario_manager().SaveScenario(ResourceName(item->name.bundle_name(), final_name),
+                                          item->def);
   }
 
   void DrawScenarioNodes(const std::vector<std::unique_ptr<ScenarioNode>>& nodes,
-                         const std::vector<std::string>& search_words,
+                         const SearchIndex& search_index,
                          ScenarioBrowserResult* result) {
     PlaylistRun* current_playlist_run = app_->playlist_manager().GetCurrentRun();
     ImGui::LoopId loop_id;
     for (auto& node : nodes) {
       auto id = loop_id.Get("ScenarioNodeItem");
-      if (node->scenario.has_value()) {
-        DrawScenarioListItem(*node->scenario, search_words, current_playlist_run, result);
+      if (node->scenario) {
+        if (search_index.IsMatch(node->scenario_index)) {
+          DrawScenarioListItem(*node->scenario, current_playlist_run, result);
+        }
       } else {
         if (expand_all_ > 0) {
           ImGui::SetNextItemOpen(true);
@@ -111,25 +121,25 @@ class ScenarioBrowserComponentImpl : public UiComponent, public ScenarioBrowserC
         }
         ImGui::OpenPopupOnItemClick(popup_id, ImGuiPopupFlags_MouseButtonRight);
         if (node_opened) {
-          DrawScenarioNodes(node->child_nodes, search_words, result);
+          DrawScenarioNodes(node->child_nodes, search_index, result);
           ImGui::TreePop();
         }
       }
     }
   }
 
-  void DrawScenarioListItem(const ScenarioItem& scenario,
-                            const std::vector<std::string>& search_words,
+  void DrawScenarioListItem(const ScenarioInfo& scenario,
                             PlaylistRun* current_playlist_run,
                             ScenarioBrowserResult* result) {
-    if (!StringMatchesSearch(scenario.id(), search_words)) {
-      return;
+    const std::string& current_scenario_id = app_->scenario_manager().current_scenario_id();
+    bool clicked = ImGui::Selectable(scenario.id().c_str(),
+                                     current_scenario_id == scenario.id(),
+                                     ImGuiSelectableFlags_AllowDoubleClick);
+    if (ImGui::IsItemHovered()) {
+      // Likely to be started or viewed next.
+      app_->stats_manager().PrefetchAggregateStats({scenario.id()});
     }
-    auto current_scenario = app_->scenario_manager().GetCurrentScenario();
-    std::string current_scenario_id = current_scenario ? current_scenario->id() : "";
-    if (ImGui::Selectable(scenario.id().c_str(),
-                          current_scenario_id == scenario.id(),
-                          ImGuiSelectableFlags_AllowDoubleClick)) {
+    if (clicked) {
       if (ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left)) {
         result->scenario_to_start = scenario.id();
       } else {
@@ -170,7 +180,7 @@ class ScenarioBrowserComponentImpl : public UiComponent, public ScenarioBrowserC
         result->scenario_to_edit_copy = scenario.id();
       }
       if (ImGui::Selectable("Quick copy")) {
-        CopyScenario(scenario);
+        CopyScenario(scenario.id());
         result->reload_scenarios = true;
       }
       if (ImGui::Selectable("View latest run")) {
@@ -178,9 +188,12 @@ class ScenarioBrowserComponentImpl : public UiComponent, public ScenarioBrowserC
         result->run_id = app_->stats_manager().GetLatestRunId(scenario.id());
       }
       if (ImGui::Selectable("Generate levels")) {
-        app_->scenario_manager().GenerateScenarioLevels(
-            scenario.id(), scenario.unevaluated_def.overrides(), 5);
-        result->reload_scenarios = true;
+        auto item = app_->scenario_manager().GetScenario(scenario.id());
+        if (item) {
+          app_->scenario_manager().GenerateScenarioLevels(
+              scenario.id(), item->unevaluated_def.overrides(), 5);
+          result->reload_scenarios = true;
+        }
       }
       if (ImGui::Selectable("Delete")) {
         delete_confirmation_dialog_.NotifyOpen(std::format("Delete \"{}\"?", scenario.id()),
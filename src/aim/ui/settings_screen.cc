@@ -43,6 +43,7 @@ class SettingsScreen : public UiScreen {
     app.settings_manager().MarkDirty();
 
     Settings settings = app_.settings_manager().GetCurrentSettings();
+    stats_file_path_ = app.file_system()->GetUserDataPath("stats_export.csv").string();
 
     keybind_items_ = {
         {"Fire", "", updater_.settings.mutable_keybinds()->mutable_fire()},
@@ -195,6 +196,61 @@ class SettingsScreen : public UiScreen {
     ImGui::Indent();
     DrawSounds();
     ImGui::Unindent();
+
+    ImGui::Spacing();
+    ImGui::Spacing();
+
+    ImGui::Text("Stats");
+    ImGui::Indent();
+    DrawStatsTransfer();
+    ImGui::AlignTextToFramePadding();
+    ImGui::Text("Record input traces");
+    ImGui::SameLine();
+    ImGui::Checkbox("##RecordInputTraces", &state_.record_input_traces);
+    ImGui::SameLine();
+    ImGui::HelpMarker(
+        "Saves every raw mouse event next to the replay of each run. Traces are large, so this "
+        "stays on only until AimForge is closed.");
+    ImGui::Unindent();
+  }
+
+  void DrawStatsTransfer() {
+    ImGui::AlignTextToFramePadding();
+    ImGui::Text("File");
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(char_x_ * 40);
+    ImGui::InputText("##StatsFilePath", &stats_file_path_);
+    ImGui::SameLine();
+    ImGui::HelpMarker("Runs are read and written as .csv or .jsonl based on the file extension.");
+
+    StatsManager& stats_manager = app_.stats_manager();
+    auto result = stats_manager.TakeStatsTransferResult();
+    if (result && result->is_import) {
+      auto& imported = result->import_result;
+      stats_transfer_status_ = imported ? std::format("Imported {} runs, skipped {}",
+                                                      imported->num_imported,
+                                                      imported->num_skipped)
+                                        : "Import failed";
+    } else if (result) {
+      stats_transfer_status_ = result->num_exported
+                                   ? std::format("Exported {} runs", *result->num_exported)
+                                   : "Export failed";
+    }
+
+    // The transfer runs in the background, so only the status is shown until it finishes.
+    if (!stats_manager.is_transferring_stats()) {
+      if (ImGui::Button("Export") && stats_manager.StartExportStats(stats_file_path_)) {
+        stats_transfer_status_ = "Exporting...";
+      }
+      ImGui::SameLine();
+      if (ImGui::Button("Import") && stats_manager.StartImportStats(stats_file_path_)) {
+        stats_transfer_status_ = "Importing...";
+      }
+    }
+    if (stats_transfer_status_.size() > 0) {
+      ImGui::SameLine();
+      ImGui::Text(stats_transfer_status_);
+    }
   }
 
   void DrawKeybinds() {
@@ -573,6 +629,9 @@ class SettingsScreen : public UiScreen {
   float char_x_ = 0;
 
   int edit_crosshair_index_ = 0;
+
+  std::string stats_file_path_;
+  std::string stats_transfer_status_;
 };
 }  // namespace
 
@@ -3,7 +3,9 @@
 #include <imgui.h>
 #include <implot.h>
 
+#include <algorithm>
 #include <fstream>
+#include <memory>
 #include <optional>
 
 #include "aim/common/imgui_ext.h"
@@ -11,12 +13,19 @@
 #include "aim/common/util.h"
 #include "aim/core/perf.h"
 #include "aim/core/stats_manager.h"
+#include "aim/scenario/replay_analyzer.h"
+#include "aim/scenario/replay_viewer.h"
 #include "aim/ui/playlist_ui.h"
 #include "aim/ui/quick_settings_screen.h"
 
 namespace aim {
 namespace {
 
+// The history chart shows at most this many of the most recent runs, downsampled to at most
+// kMaxHistoryPoints.
+constexpr int kMaxHistoryRuns = 5000;
+constexpr int kMaxHistoryPoints = 300;
+
 std::string GetHitPercentageString(const StatsRow& stats) {
   if (stats.num_shots > 0) {
     float hit_percent = stats.num_hits / stats.num_shots;
@@ -29,11 +38,14 @@ std::string GetHitPercentageString(const StatsRow& stats) {
 }
 
 struct StatsInfo {
-  std::vector<StatsRow> all_stats;
   StatsRow stats;
-  StatsRow previous_high_score_stats;
+  std::optional<StatsRow> previous_high_score_stats;
+  int total_runs = 0;
+  ScoreRank rank;
+  std::vector<double> run_numbers;
   std::vector<double> scores;
   float min_score = 0;
+  float max_score = 0;
 };
 
 class StatsScreen : public UiScreen {
@@ -41,13 +53,40 @@ class StatsScreen : public UiScreen {
   StatsScreen(std::string scenario_id, i64 run_id, Application* app)
       : UiScreen(*app), scenario_id_(scenario_id), run_id_(run_id) {
     scenario_ = app->scenario_manager().GetScenario(scenario_id);
+    scenario_generation_ = app->scenario_manager().generation();
     if (GetStatsInfo(&info_)) {
       is_valid_ = true;
     }
     performance_stats_ = state_.GetPerformanceStats(scenario_id, run_id);
+    has_replay_ = app->replay_manager().HasReplay(run_id);
+    run_analyses_ = app->stats_manager().GetRunAnalyses(scenario_id);
   }
 
  protected:
+  void OnTickStart() override {
+    UiScreen::OnTickStart();
+    ScenarioManager& scenario_manager = app_.scenario_manager();
+    if (scenario_generation_ != scenario_manager.generation()) {
+      // The scenario was reloaded from disk, e.g. after being edited, so the score levels may have
+      // changed.
+      scenario_ = scenario_manager.GetScenario(scenario_id_);
+      scenario_generation_ = scenario_manager.generation();
+    }
+    if (analysis_ && analysis_->Poll()) {
+      analysis_.reset();
+      run_analyses_ = app_.stats_manager().GetRunAnalyses(scenario_id_);
+    }
+    if (play_replay_) {
+      play_replay_ = false;
+      // The payload is only read from disk once the user asks to watch it.
+      auto replay = app_.replay_manager().LoadReplay(run_id_);
+      if (replay) {
+        ReplayViewer viewer;
+        viewer.PlayReplay(*replay, &app_);
+      }
+    }
+  }
+
   void DrawScreen() override {
     ImGui::IdGuard cid("StatsScreen");
 
@@ -69,10 +108,11 @@ class StatsScreen : public UiScreen {
     if (ImGui::Begin("Stats")) {
       delete_history_confirmation_dialog_.Draw("Delete", [=](const std::string& scenario_id) {
         app_.stats_manager().DeleteAllStats(scenario_id);
+        app_.replay_manager().DeleteAllReplays(scenario_id);
         PopSelf();
       });
 
-      if (info_.all_stats.size() > 1) {
+      if (info_.total_runs > 1) {
         if (ImGui::BeginTabBar("StatsTabBar")) {
           if (ImGui::BeginTabItem("Current run")) {
             DrawStats();
@@ -86,6 +126,10 @@ class StatsScreen : public UiScreen {
             DrawHistory();
             ImGui::EndTabItem();
           }
+          if (ImGui::BeginTabItem("Analysis")) {
+            DrawAnalysis();
+            ImGui::EndTabItem();
+          }
           if (performance_stats_) {
             if (ImGui::BeginTabItem("Perf")) {
               DrawPerformanceStats();
@@ -149,9 +193,9 @@ class StatsScreen : public UiScreen {
 
   void DrawStats() {
     StatsRow stats = info_.stats;
-    const auto& all_stats = info_.all_stats;
-    float previous_high_score = info_.previous_high_score_stats.score;
-    bool has_previous_high_score = all_stats.size() > 0 && previous_high_score > 0;
+    StatsRow previous_high_score_stats = info_.previous_high_score_stats.value_or(StatsRow{});
+    float previous_high_score = previous_high_score_stats.score;
+    bool has_previous_high_score = info_.previous_high_score_stats && previous_high_score > 0;
 
     float diff = 0;
     float percent_diff = 0;
@@ -202,27 +246,31 @@ class StatsScreen : public UiScreen {
 
     if (has_previous_high_score) {
       std::string time_ago;
-      auto maybe_time = ParseTimestampStringAsMicros(info_.previous_high_score_stats.timestamp);
+      auto maybe_time = ParseTimestampStringAsMicros(previous_high_score_stats.timestamp);
       if (maybe_time) {
         time_ago = std::format("({})", GetHowLongAgoString(*maybe_time, GetNowMicros()));
         ImGui::Spacing();
         ImGui::Spacing();
         ImGui::Spacing();
         ImGui::Text("Previous High Score %s", time_ago.c_str());
-        ImGui::Text(MaybeIntToString(info_.previous_high_score_stats.score, 2));
-        hit_percent = GetHitPercentageString(info_.previous_high_score_stats);
+        ImGui::Text(MaybeIntToString(previous_high_score_stats.score, 2));
+        hit_percent = GetHitPercentageString(previous_high_score_stats);
         if (hit_percent.size() > 0) {
           ImGui::SameLine();
           ImGui::TextFmt("- {}", hit_percent);
         }
-        ImGui::TextFmt("cm/360: {}", MaybeIntToString(info_.previous_high_score_stats.cm_per_360));
+        ImGui::TextFmt("cm/360: {}", MaybeIntToString(previous_high_score_stats.cm_per_360));
       }
     }
-    if (all_stats.size() > 1) {
+    if (info_.total_runs > 1) {
       ImGui::Spacing();
       ImGui::Spacing();
       ImGui::Spacing();
-      ImGui::Text("Total runs: %d", all_stats.size());
+      ImGui::Text("Total runs: %d", info_.total_runs);
+      ImGui::TextFmt("Rank {} of {} (top {}%)",
+                     info_.rank.rank,
+                     info_.rank.num_runs,
+                     MaybeIntToString(std::max(info_.rank.top_percent, 0.1), 1));
     }
     DrawHistory();
     ImGui::SetCursorAtBottom();
@@ -236,13 +284,19 @@ class StatsScreen : public UiScreen {
       state_.scenario_run_option = ScenarioRunOption::PLAYLIST_NEXT;
       ReturnHome();
     }
+    if (has_replay_) {
+      ImGui::SameLine();
+      if (ImGui::Button("Watch replay")) {
+        play_replay_ = true;
+      }
+    }
   }
 
   void DrawHistory() {
     if (ImPlot::BeginPlot(std::format("##Scores_{}", scenario_id_).c_str())) {
       // ImPlot::SetupAxisLimits(ImAxis_X1,0,1.0);
       // ImPlot::SetupAxisLimits(ImAxis_Y1,0,1.6);
-      float max_score = info_.previous_high_score_stats.score;
+      float max_score = info_.max_score;
       float score_range = max_score - info_.min_score;
       bool has_score_range = score_range > 0;
       ImPlotAxisFlags autofit_flags = ImPlotAxisFlags_AutoFit | ImPlotAxisFlags_RangeFit;
@@ -253,11 +307,54 @@ class StatsScreen : public UiScreen {
             ImAxis_Y1, ClampPositive(info_.min_score - padding), max_score + padding);
       }
       ImPlot::SetNextMarkerStyle(ImPlotMarker_Circle);
-      ImPlot::PlotStems("##Scores", &info_.scores[0], info_.scores.size());
+      ImPlot::PlotStems(
+          "##Scores", info_.run_numbers.data(), info_.scores.data(), info_.scores.size());
       ImPlot::EndPlot();
     }
   }
 
+  void DrawAnalysis() {
+    if (analysis_) {
+      ImGui::Text("Analyzing replays...");
+    } else if (ImGui::Button("Analyze replays")) {
+      analysis_ = std::make_unique<BackgroundReplayAnalysis>(&app_.replay_manager(),
+                                                             &app_.stats_manager());
+    }
+    if (run_analyses_.size() == 0) {
+      ImGui::Text("No analyzed replays");
+      return;
+    }
+
+    RunAnalysisRow average;
+    for (const RunAnalysisRow& row : run_analyses_) {
+      if (row.stats_id == run_id_) {
+        ImGui::Text("Current run");
+        DrawRunAnalysis(row);
+        ImGui::Spacing();
+      }
+      average.mean_reaction_seconds += row.mean_reaction_seconds / run_analyses_.size();
+      average.mean_time_to_target_seconds +=
+          row.mean_time_to_target_seconds / run_analyses_.size();
+      average.mean_overshoot_degrees += row.mean_overshoot_degrees / run_analyses_.size();
+      average.mean_undershoot_degrees += row.mean_undershoot_degrees / run_analyses_.size();
+      average.tracking_error_rms_degrees += row.tracking_error_rms_degrees / run_analyses_.size();
+      average.smoothness += row.smoothness / run_analyses_.size();
+    }
+    ImGui::TextFmt("Average of {} runs", run_analyses_.size());
+    DrawRunAnalysis(average);
+  }
+
+  void DrawRunAnalysis(const RunAnalysisRow& row) {
+    ImGui::Indent();
+    ImGui::TextFmt("Reaction time: {:.0f}ms", row.mean_reaction_seconds * 1000);
+    ImGui::TextFmt("Time to target: {:.0f}ms", row.mean_time_to_target_seconds * 1000);
+    ImGui::TextFmt("Overshoot: {:.2f} deg", row.mean_overshoot_degrees);
+    ImGui::TextFmt("Undershoot: {:.2f} deg", row.mean_undershoot_degrees);
+    ImGui::TextFmt("Tracking error: {:.2f} deg", row.tracking_error_rms_degrees);
+    ImGui::TextFmt("Smoothness: {:.3f}", row.smoothness);
+    ImGui::Unindent();
+  }
+
   void OnEvent(const SDL_Event& event, bool user_is_typing) override {
     if (IsEscapeKeyDown(event)) {
       PopSelf();
@@ -267,46 +364,40 @@ class StatsScreen : public UiScreen {
 
  private:
   bool GetStatsInfo(StatsInfo* info) {
-    auto all_stats = app_.stats_manager().GetStats(scenario_id_);
-    info->all_stats.reserve(all_stats.size());
-    info->scores.reserve(all_stats.size());
-
-    if (all_stats.size() == 0) {
+    StatsManager& stats_manager = app_.stats_manager();
+    auto stats = stats_manager.GetStatsRow(scenario_id_, run_id_);
+    if (!stats) {
       return false;
     }
-
-    int found_max_index = -1;
-    float max_score = -100000;
-    bool found_stats = false;
-    info->min_score = 1000000;
-    for (int i = 0; i < all_stats.size(); ++i) {
-      StatsRow& stats = all_stats[i];
-      info->all_stats.push_back(stats);
-      info->scores.push_back(stats.score);
-
-      if (stats.stats_id == run_id_) {
-        info->stats = stats;
-        found_stats = true;
-        break;
-      }
-
-      if (stats.score >= max_score) {
-        found_max_index = i;
-        max_score = stats.score;
-      }
-      if (stats.score < info->min_score) {
-        info->min_score = stats.score;
-      }
-    }
-
-    if (!found_stats) {
-      return false;
+    info->stats = *stats;
+    info->previous_high_score_stats = stats_manager.GetHighScoreBefore(scenario_id_, run_id_);
+    AggregateScenarioStats aggregate = stats_manager.GetAggregateStats(scenario_id_);
+    info->total_runs = aggregate.total_runs;
+    info->rank = stats_manager.GetScoreRank(scenario_id_, stats->score);
+
+    ScoreHistoryQuery query;
+    query.scenario_id = scenario_id_;
+    query.max_runs = kMaxHistoryRuns;
+    // The chart ends at the viewed run, which may be an older one opened from history.
+    query.max_stats_id = run_id_;
+    auto run_timestamp_micros = ParseTimestampStringAsMicros(stats->timestamp);
+    if (run_timestamp_micros) {
+      query.max_timestamp_micros = *run_timestamp_micros;
     }
-
-    if (found_max_index >= 0) {
-      info->previous_high_score_stats = all_stats[found_max_index];
+    ScoreHistory history = stats_manager.GetScoreHistory(query, kMaxHistoryPoints);
+    // Number the runs from the first ever run so the chart lines up as history grows.
+    i64 first_run_number = std::max<i64>(1, history.num_runs_in_bounds - history.num_runs + 1);
+    info->run_numbers.reserve(history.points.size());
+    info->scores.reserve(history.points.size());
+    info->min_score = 1000000;
+    // Downsampling may drop the best run so take the max from the aggregate.
+    info->max_score = aggregate.high_score_stats.score;
+    for (const ScoreHistoryPoint& point : history.points) {
+      info->run_numbers.push_back(first_run_number + point.index);
+      info->scores.push_back(point.score);
+      info->min_score = std::min<float>(info->min_score, point.score);
+      info->max_score = std::max<float>(info->max_score, point.score);
     }
-
     return true;
   }
 
@@ -315,11 +406,16 @@ class StatsScreen : public UiScreen {
   StatsInfo info_;
   bool is_valid_ = false;
 
-  std::optional<ScenarioItem> scenario_;
+  std::shared_ptr<const ScenarioItem> scenario_;
+  u64 scenario_generation_ = 0;
 
   std::optional<QuickSettingsType> show_settings_;
   std::string show_settings_release_key_;
   std::optional<RunPerformanceStats> performance_stats_;
+  bool has_replay_ = false;
+  bool play_replay_ = false;
+  std::vector<RunAnalysisRow> run_analyses_;
+  std::unique_ptr<BackgroundReplayAnalysis> analysis_;
   ImGui::ConfirmationDialog<std::string> delete_history_confirmation_dialog_{
       "DeleteHistoryConfirmationDialog"};
 };
@@ -0,0 +1,67 @@
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+#include "aim/core/packed_bundle.h"
+
+namespace {
+
+void PrintUsage() {
+  std::printf(
+      "Usage:\n"
+      "  bundle_tool pack <bundle dir> [<output file>]\n"
+      "  bundle_tool unpack <packed bundle> [<output dir>]\n"
+      "\n"
+      "Packing writes <bundle dir>%s by default and unpacking writes a bundle dir named after the\n"
+      "packed bundle next to it. Copy either into the AimForge bundles dir to install it.\n",
+      aim::kPackedBundleExtension);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  using namespace aim;
+  if (argc < 3 || argc > 4) {
+    PrintUsage();
+    return 1;
+  }
+  std::string command = argv[1];
+  std::filesystem::path input = argv[2];
+  // Drop any trailing separator so the default output is next to the input.
+  if (!input.has_filename()) {
+    input = input.parent_path();
+  }
+  if (command == "pack") {
+    std::filesystem::path output = input;
+    output += kPackedBundleExtension;
+    if (argc == 4) {
+      output = argv[3];
+    }
+    if (!std::filesystem::is_directory(input)) {
+      std::fprintf(stderr, "%s is not a bundle dir\n", input.string().c_str());
+      return 1;
+    }
+    if (!PackBundle(input, output)) {
+      return 1;
+    }
+    std::printf("Packed %s into %s\n", input.string().c_str(), output.string().c_str());
+    return 0;
+  }
+  if (command == "unpack") {
+    std::filesystem::path output = input;
+    output.replace_extension();
+    if (argc == 4) {
+      output = argv[3];
+    }
+    auto bundle = PackedBundle::Open(input);
+    if (!bundle || !UnpackBundle(*bundle, output)) {
+      return 1;
+    }
+    std::printf("Unpacked %d resources into %s\n",
+                (int)bundle->resources().size(),
+                output.string().c_str());
+    return 0;
+  }
+  PrintUsage();
+  return 1;
+}